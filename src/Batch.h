@@ -0,0 +1,139 @@
+#ifndef BenoitBatch_h
+#define BenoitBatch_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <vector>
+#include <algorithm>
+#include "Graph.h"
+#include "CSR.h"
+
+namespace ben {
+
+	//bulk link operations for either kind of node, used by GraphBatch
+	template<typename I, typename O>
+	size_t remove_links(DirectedNode<I,O>& node, const std::vector<unsigned>& addresses)
+		{ return node.remove_outputs(addresses); }
+	template<typename P>
+	size_t remove_links(UndirectedNode<P>& node, const std::vector<unsigned>& addresses)
+		{ return node.remove(addresses); }
+	template<typename I, typename O>
+	void reserve_links(DirectedNode<I,O>& node, const size_t extra) { node.reserve_outputs(node.outputs.size() + extra); }
+	template<typename P>
+	void reserve_links(UndirectedNode<P>& node, const size_t extra) { node.reserve(node.size() + extra); }
+
+	template<typename N>
+	class GraphBatch {
+	/*
+		Collects link additions and removals and applies them all at once. Changes are
+		sorted by source node, so each source is looked up once, its links are reserved once
+		for all its additions, and all its removals take one pass over its links (see
+		DirectedNode::remove_outputs). The whole batch is applied under one write lock on
+		the Graph. For DirectedNodes the source of a link is the node it is an output of;
+		for UndirectedNodes either end will do.
+
+		Within one batch, removals of a node's links are applied before additions, so a
+		batch that removes and adds the same link ends up with the link, carrying the new
+		value. Path links take the value given to add; Port links ignore it. Changes that
+		refer to nodes not in the Graph, additions of links that exist and removals of
+		links that don't are skipped. A batch holds a plain pointer to its Graph, so it
+		must not outlive it.
+	*/
+	public:
+		typedef N node_type;
+		typedef Graph<N> graph_type;
+		typedef typename N::id_type id_type;
+		typedef typename link_value<typename link_types<N>::output_type>::type value_type;
+
+	private:
+		typedef GraphBatch self_type;
+		struct Change {
+			id_type source, target;
+			value_type value;
+			bool adding;
+		};
+
+		graph_type* graph;
+		std::vector<Change> changes;
+
+		static Change make_change(id_type source, id_type target, const value_type& v, const bool adding) {
+			//an undirected link is always filed under its lower ID, so that both ends sort together
+			if(!link_types<N>::directed and target < source) std::swap(source, target);
+			return Change{source, target, v, adding};
+		}
+
+	public:
+		GraphBatch() = delete;
+		explicit GraphBatch(graph_type& target) : graph(&target) {}
+		GraphBatch(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~GraphBatch() = default;
+
+		void add(const id_type source, const id_type target, const value_type& v=value_type()) 
+			{ changes.push_back( make_change(source, target, v, true) ); }
+		void remove(const id_type source, const id_type target)
+			{ changes.push_back( make_change(source, target, value_type(), false) ); }
+		void reserve(const size_t n) { changes.reserve(n); }
+		void clear() { changes.clear(); }
+		size_t size() const { return changes.size(); }
+		bool empty() const { return changes.empty(); }
+
+		size_t apply();
+	}; //class GraphBatch
+
+	template<typename N>
+	size_t GraphBatch<N>::apply() {
+	//Returns the number of changes that took effect. The batch is empty afterwards.
+		std::stable_sort(changes.begin(), changes.end(), [](const Change& a, const Change& b) {
+			return a.source < b.source or (a.source == b.source and !a.adding and b.adding);
+		});
+
+		size_t applied = 0;
+		std::vector<id_type> removals;
+		ScopedWriteLock lock(*graph);
+		for(auto first=changes.begin(); first!=changes.end(); ) {
+			auto last = first;
+			while(last != changes.end() and last->source == first->source) ++last;
+			auto node_iter = graph->find(first->source);
+			if( node_iter != graph->end() ) {
+				node_type& node = *node_iter;
+				auto adds = first;
+				removals.clear();
+				for(; adds!=last and !adds->adding; ++adds) removals.push_back(adds->target);
+				if( !removals.empty() ) applied += remove_links(node, removals);
+				if(adds != last) {
+					reserve_links(node, last - adds);
+					for(; adds!=last; ++adds) if( add_link(node, adds->target, adds->value) ) ++applied;
+				}
+			}
+			first = last;
+		}
+		changes.clear();
+		return applied;
+	}
+
+	template<typename N>
+	GraphBatch<N> Graph<N>::batch() { return GraphBatch<N>(*this); }
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,197 @@
+#ifndef BenoitCSR_h
+#define BenoitCSR_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include "Graph.h"
+#include "DirectedNode.h"
+#include "UndirectedNode.h"
+
+namespace ben {
+
+	//link types of either kind of node
+	template<typename N> struct link_types;
+	template<typename I, typename O> 
+	struct link_types< DirectedNode<I,O> > { 
+		typedef I input_type; 
+		typedef O output_type; 
+		static const bool directed = true;
+	};
+	template<typename P> 
+	struct link_types< UndirectedNode<P> > { 
+		typedef P input_type; 
+		typedef P output_type; 
+		static const bool directed = false;
+	};
+
+	//uniform access to the links of either kind of node
+	//for UndirectedNodes, every link is both an input and an output
+	template<typename I, typename O, typename F>
+	void for_each_input(const DirectedNode<I,O>& node, F f) { for(auto& x : node.inputs) f(x); }
+	template<typename I, typename O, typename F>
+	void for_each_output(const DirectedNode<I,O>& node, F f) { for(auto& x : node.outputs) f(x); }
+	template<typename P, typename F>
+	void for_each_input(const UndirectedNode<P>& node, F f) { for(auto& x : node) f(x); }
+	template<typename P, typename F>
+	void for_each_output(const UndirectedNode<P>& node, F f) { for(auto& x : node) f(x); }
+
+	//default edge weights: Path values where there are any, 1 otherwise
+	template<typename W, typename V>
+	W link_weight(const Path<V>& link) { return W( link.get_value() ); }
+	template<typename W, typename L>
+	W link_weight(const L&) { return W(1); }
+
+	//the value carried by a link: that of a Path, nothing for anything else
+	template<typename L>
+	struct link_value {
+		typedef char type;
+		static const bool stored = false;
+		static type get(const L&) { return 0; }
+	};
+	template<typename V>
+	struct link_value< Path<V> > {
+		typedef V type;
+		static const bool stored = true;
+		static type get(const Path<V>& link) { return link.get_value(); }
+	};
+
+	//adds an output link, passing v on only if the link type carries a value (see link_value)
+	template<typename I, typename O, typename V>
+	bool add_link(DirectedNode<I,O>& node, const unsigned address, const V& v, std::true_type)
+		{ return node.add_output(address, v); }
+	template<typename I, typename O, typename V>
+	bool add_link(DirectedNode<I,O>& node, const unsigned address, const V&, std::false_type)
+		{ return node.add_output(address); }
+	template<typename P, typename V>
+	bool add_link(UndirectedNode<P>& node, const unsigned address, const V& v, std::true_type)
+		{ return node.add(address, v); }
+	template<typename P, typename V>
+	bool add_link(UndirectedNode<P>& node, const unsigned address, const V&, std::false_type)
+		{ return node.add(address); }
+	template<typename N, typename V>
+	bool add_link(N& node, const unsigned address, const V& v) {
+		typedef link_value<typename link_types<N>::output_type> value_traits;
+		return add_link(node, address, v, std::integral_constant<bool, value_traits::stored>());
+	}
+
+	enum class Direction { outgoing, incoming, both };
+
+	template<typename W=double>
+	class CSR {
+	/*
+		A compressed sparse row snapshot of a Graph's links: nodes are numbered by their
+		position in Graph::ordering(), and the neighbors of node i are targets[offsets[i]]
+		through targets[offsets[i+1]-1], with matching weights. Kernels that sweep the whole
+		graph many times (partitioning, propagation) run far faster on this than on the
+		node objects, at the cost of not seeing later changes. Rebuild it, or compare
+		Graph::get_link_version() against version(), to pick them up.
+
+		UndirectedNode links are listed once per end whatever the Direction; asking for
+		Direction::both on an undirected graph lists every link twice.
+	*/
+	public:
+		typedef unsigned int id_type;
+		typedef uint32_t index_type;
+		typedef W weight_type;
+
+	private:
+		std::vector<id_type> ids;
+		std::vector<size_t> offsets;
+		std::vector<index_type> targets;
+		std::vector<weight_type> weights;
+		unsigned long link_version;
+
+	public:
+		CSR() : offsets(1, 0), link_version(0) {}
+		template<typename N>
+		explicit CSR(const Graph<N>& graph, const Direction direction=Direction::outgoing)
+			: link_version(0) {
+			build(graph, direction, [](const typename link_types<N>::output_type& x) { return link_weight<weight_type>(x); },
+					        [](const typename link_types<N>::input_type& x) { return link_weight<weight_type>(x); });
+		}
+		template<typename N, typename F, typename G>
+		CSR(const Graph<N>& graph, const Direction direction, F output_weight, G input_weight)
+			: link_version(0) { build(graph, direction, output_weight, input_weight); }
+		CSR(const CSR& rhs) = default;
+		CSR(CSR&& rhs) = default;
+		CSR& operator=(const CSR& rhs) = default;
+		CSR& operator=(CSR&& rhs) = default;
+		~CSR() = default;
+
+		template<typename N, typename F, typename G>
+		void build(const Graph<N>& graph, const Direction direction, F output_weight, G input_weight) {
+			link_version = graph.get_link_version();
+			auto& nodes = graph.ordering();
+			ids.resize(nodes.size());
+			offsets.assign(1, 0);
+			offsets.reserve(nodes.size() + 1);
+			targets.clear();
+			weights.clear();
+			for(size_t i=0; i<nodes.size(); ++i) {
+				ids[i] = nodes[i]->ID();
+				if(direction != Direction::incoming) {
+					for_each_output(*nodes[i], [&](const typename link_types<N>::output_type& x) {
+						targets.push_back( graph.position(x.get_address()) );
+						weights.push_back( output_weight(x) );
+					});
+				}
+				if(direction != Direction::outgoing) {
+					for_each_input(*nodes[i], [&](const typename link_types<N>::input_type& x) {
+						targets.push_back( graph.position(x.get_address()) );
+						weights.push_back( input_weight(x) );
+					});
+				}
+				offsets.push_back(targets.size());
+			}
+		}
+
+		size_t size() const { return ids.size(); }
+		size_t edges() const { return targets.size(); }
+		unsigned long version() const { return link_version; }
+
+		id_type id(const index_type i) const { return ids[i]; }
+		index_type position(const id_type address) const {
+			//ids are sorted because Graph::ordering() is; returns size() if absent
+			auto iter = std::lower_bound(ids.begin(), ids.end(), address);
+			if(iter != ids.end() and *iter == address) return iter - ids.begin();
+			else return ids.size();
+		}
+
+		size_t degree(const index_type i) const { return offsets[i+1] - offsets[i]; }
+		const index_type* begin(const index_type i) const { return targets.data() + offsets[i]; }
+		const index_type* end(const index_type i) const { return targets.data() + offsets[i+1]; }
+		const weight_type* weights_of(const index_type i) const { return weights.data() + offsets[i]; }
+
+		//raw arrays, for serialization and kernels
+		const std::vector<id_type>& id_array() const { return ids; }
+		const std::vector<size_t>& offset_array() const { return offsets; }
+		const std::vector<index_type>& target_array() const { return targets; }
+		const std::vector<weight_type>& weight_array() const { return weights; }
+	}; //class CSR
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,252 @@
+#ifndef BenoitCellList_h
+#define BenoitCellList_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "SpatialIndex.h"
+
+namespace ben {
+/* CellList is a SpatialIndex for workloads dominated by radius queries of about one size. Space
+ * is divided into cubic cells of a fixed size, and each occupied cell keeps a list of its points
+ * in a hash map keyed by the cell's integer coordinates. Inserting, removing or moving a point
+ * costs O(1) plus the length of one cell's list, and a move within a cell just updates the
+ * coordinates. A radius query visits only the cells that overlap its bounding box, which for a
+ * radius up to the cell size is the cell holding the center and its neighbors: 3^N cells.
+ *
+ * Pick a cell size near the usual query radius. Much smaller and queries visit many empty cells;
+ * much larger and they scan many points that are too far away. Range queries visit the cells that
+ * overlap the region, or every occupied cell if that's fewer. nearest searches outward in shells
+ * of cells, and falls back to a scan of every point once a shell would hold more cells than are
+ * occupied, so it is fine for points that are close together and slow for isolated ones.
+ */
+	template<typename T, unsigned short N>
+	class CellList : public SpatialIndex<T,N> {
+	private:
+		typedef SpatialIndex<T,N> base_type;
+		typedef CellList self_type;
+
+	public:
+		typedef typename base_type::point_type point_type;
+		typedef typename base_type::id_type id_type;
+		typedef typename base_type::region_type region_type;
+		typedef std::array<int64_t,N> cell_type;
+
+	private:
+		struct Cell {
+			//parallel arrays, so distances can run over the points in one batch
+			std::vector<id_type> ids;
+			std::vector<point_type> points;
+		};
+		struct CellHash {
+			size_t operator()(const cell_type& cell) const {
+				uint64_t hash = 0x9e3779b97f4a7c15ull;
+				for(auto x : cell) hash = (hash ^ uint64_t(x)) * 0x100000001b3ull;
+				return size_t(hash ^ (hash >> 29));
+			}
+		};
+
+		double side;
+		std::unordered_map<cell_type, Cell, CellHash> cells;
+		std::unordered_map<id_type, cell_type> cell_of;
+
+		int64_t coordinate(const double x) const { return int64_t( std::floor(x / side) ); }
+		cell_type cell_for(const point_type& point) const {
+			cell_type cell;
+			for(unsigned short i=0; i<N; ++i) cell[i] = coordinate(point[i]);
+			return cell;
+		}
+		void erase_from(const cell_type& cell, const id_type address) {
+			auto iter = cells.find(cell);
+			Cell& entries = iter->second;
+			size_t i = std::find(entries.ids.begin(), entries.ids.end(), address) - entries.ids.begin();
+			entries.ids[i] = entries.ids.back();
+			entries.points[i] = entries.points.back();
+			entries.ids.pop_back();
+			entries.points.pop_back();
+			if( entries.ids.empty() ) cells.erase(iter);
+		}
+		void append(const cell_type& cell, const id_type address, const point_type& point) {
+			Cell& entries = cells[cell];
+			entries.ids.push_back(address);
+			entries.points.push_back(point);
+		}
+
+		template<typename F>
+		static void for_each_distance(const point_type& center, const Cell& entries, F f) {
+			//calls f(id, squared distance) for every point in the cell
+			static const size_t chunk = 64;
+			double squares[chunk];
+			for(size_t i=0; i<entries.ids.size(); i+=chunk) {
+				size_t n = std::min(chunk, entries.ids.size() - i);
+				distances<SquaredEuclidean>(center, entries.points.data() + i, n, squares);
+				for(size_t j=0; j<n; ++j) f(entries.ids[i+j], squares[j]);
+			}
+		}
+
+		template<typename F>
+		void for_each_cell(const cell_type& low, const cell_type& high, F f) const {
+			//calls f(cell) for every occupied cell in the block from low to high
+			double block = 1.0;
+			for(unsigned short i=0; i<N; ++i) block *= double(high[i] - low[i] + 1);
+			if(block > double(cells.size())) {
+				for(auto& x : cells) {
+					bool inside = true;
+					for(unsigned short i=0; i<N; ++i) if(x.first[i] < low[i] or x.first[i] > high[i]) inside = false;
+					if(inside) f(x.second);
+				}
+				return;
+			}
+			cell_type cell = low;
+			while(true) {
+				auto iter = cells.find(cell);
+				if(iter != cells.end()) f(iter->second);
+				unsigned short i = 0;
+				for(; i<N; ++i) { //odometer
+					if(cell[i] < high[i]) { ++cell[i]; break; }
+					cell[i] = low[i];
+				}
+				if(i == N) return;
+			}
+		}
+
+	public:
+		explicit CellList(const double cell_size=1.0) : side(cell_size > 0.0 ? cell_size : 1.0) {}
+		CellList(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~CellList() = default;
+
+		double cell_size() const { return side; }
+		size_t occupied() const { return cells.size(); } //number of cells with points in them
+
+		void build(const std::vector< std::pair<id_type, point_type> >& points) {
+			clear();
+			cell_of.reserve(points.size());
+			for(auto& x : points) insert(x.first, x.second);
+		}
+		bool insert(const id_type address, const point_type& point) {
+			cell_type cell = cell_for(point);
+			if( !cell_of.insert(std::make_pair(address, cell)).second ) return false;
+			append(cell, address, point);
+			return true;
+		}
+		bool remove(const id_type address) {
+			auto iter = cell_of.find(address);
+			if(iter == cell_of.end()) return false;
+			erase_from(iter->second, address);
+			cell_of.erase(iter);
+			return true;
+		}
+		bool move(const id_type address, const point_type& point) {
+			auto iter = cell_of.find(address);
+			if(iter == cell_of.end()) return false;
+			cell_type cell = cell_for(point);
+			if(cell == iter->second) {
+				Cell& entries = cells[cell];
+				size_t i = std::find(entries.ids.begin(), entries.ids.end(), address) - entries.ids.begin();
+				entries.points[i] = point;
+			} else {
+				erase_from(iter->second, address);
+				append(cell, address, point);
+				iter->second = cell;
+			}
+			return true;
+		}
+		void clear() {
+			cells.clear();
+			cell_of.clear();
+		}
+		size_t size() const { return cell_of.size(); }
+
+		void in_region(const region_type& region, std::vector<id_type>& output) const {
+			cell_type low, high;
+			for(unsigned short i=0; i<N; ++i) {
+				if(region.upper[i] < region.lower[i]) return;
+				low[i] = coordinate(region.lower[i]);
+				high[i] = coordinate(region.upper[i]);
+			}
+			for_each_cell(low, high, [&](const Cell& entries) {
+				for(size_t i=0; i<entries.ids.size(); ++i)
+					if( region.contains(entries.points[i]) ) output.push_back(entries.ids[i]);
+			});
+		}
+		void within(const point_type& center, const double radius, std::vector<id_type>& output) const {
+			if(radius < 0.0) return;
+			cell_type low, high;
+			for(unsigned short i=0; i<N; ++i) {
+				low[i] = coordinate(center[i] - radius);
+				high[i] = coordinate(center[i] + radius);
+			}
+			const double limit = radius*radius;
+			for_each_cell(low, high, [&](const Cell& entries) {
+				for_each_distance(center, entries, [&](const id_type address, const double square) {
+					if(square <= limit) output.push_back(address);
+				});
+			});
+		}
+		size_t nearest(const point_type& center, const size_t k, Neighbor* output) const;
+	}; //class CellList
+
+	template<typename T, unsigned short N>
+	size_t CellList<T,N>::nearest(const point_type& center, const size_t k, Neighbor* output) const {
+		size_t count = 0;
+		if(k == 0 or cells.empty()) return 0;
+		const cell_type home = cell_for(center);
+		auto offer = [&](const id_type address, const double square)
+			{ base_type::offer(output, count, k, address, square); };
+		for(int64_t ring=0; ; ++ring) {
+			double block = 1.0;
+			for(unsigned short i=0; i<N; ++i) block *= double(2*ring + 1);
+			if(block > double(cells.size())) { //cheaper to look at everything
+				count = 0;
+				for(auto& x : cells)
+					for_each_distance(center, x.second, offer);
+				break;
+			}
+			//the cells at Chebyshev distance ring from home
+			cell_type low, high;
+			for(unsigned short i=0; i<N; ++i) {
+				low[i] = home[i] - ring;
+				high[i] = home[i] + ring;
+			}
+			for_each_cell(low, high, [&](const Cell& entries) {
+				cell_type cell = cell_for(entries.points.front());
+				int64_t distance = 0;
+				for(unsigned short i=0; i<N; ++i) distance = std::max(distance, std::abs(cell[i] - home[i]));
+				if(distance == ring) for_each_distance(center, entries, offer);
+			});
+			//anything not seen yet is at least ring cells away
+			const double reach = ring*side;
+			if(count == k and output[0].distance <= reach*reach) break;
+			if(count == size()) break;
+		}
+		return base_type::finish(output, count);
+	}
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,133 @@
+#ifndef BenoitChangeLog_h
+#define BenoitChangeLog_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace ben {
+/* A ChangeLog is a fixed-size ring of the most recent changes to a Graph, so that anything derived
+ * from the Graph (a CSR, an index, a replica) can be brought up to date by applying the changes
+ * since it was built instead of rescanning every node. Logging is off until Graph::enable_log is
+ * called. Once on, Graph and its nodes record
+ *
+ * 	joined, left		a node (source) joined or left the Graph
+ * 	link_added, link_removed	the link from source to target (for UndirectedNodes, between them)
+ * 	links_reset		some or all links of source changed at once: mirror, clear, or
+ * 				a bulk remove; the consumer should rescan source
+ * 	value_changed		the value of the link from source to target was set through the node's
+ * 				set_value; Paths don't know their Graph, so Path::set_value alone
+ * 				records nothing unless Graph::value_changed is called too
+ *
+ * Every change gets a sequence number. A consumer keeps a cursor, the sequence number it has read
+ * up to, and calls read(cursor, f). The ring overwrites its oldest entries, so a consumer that
+ * falls more than capacity() changes behind has lost some; read then returns false, and the
+ * consumer should rebuild from the Graph and carry on from head().
+ *
+ * Recording takes one fetch_add and a CAS on the entry being written, and never blocks on readers.
+ * Readers check the entry's sequence before and after copying it, like a seqlock, and treat an
+ * entry that changed underneath them as lost.
+ */
+	enum class ChangeKind : uint32_t { joined, left, link_added, link_removed, links_reset, value_changed };
+
+	struct ChangeEvent {
+		unsigned long sequence;
+		ChangeKind kind;
+		unsigned int source, target;
+	}; //struct ChangeEvent
+
+	class ChangeLog {
+	private:
+		struct Entry {
+			std::atomic<uint64_t> stamp; //2*sequence+1 while being written, 2*sequence+2 once written
+			std::atomic<uint32_t> kind, source, target;
+			Entry() : stamp(0), kind(0), source(0), target(0) {}
+		};
+
+		std::unique_ptr<Entry[]> entries;
+		uint64_t mask;
+		std::atomic<uint64_t> next;
+
+	public:
+		explicit ChangeLog(const size_t capacity=(1 << 16)) : mask(1), next(0) {
+			//capacity is rounded up to a power of two
+			while(mask < capacity) mask <<= 1;
+			entries.reset(new Entry[mask]);
+			--mask;
+		}
+		ChangeLog(const ChangeLog& rhs) = delete;
+		ChangeLog& operator=(const ChangeLog& rhs) = delete;
+		~ChangeLog() = default;
+
+		size_t capacity() const { return mask + 1; }
+		unsigned long head() const { return next.load(); } //sequence number of the next change
+
+		void record(const ChangeKind kind, const unsigned int source, const unsigned int target=0) {
+			const uint64_t sequence = next.fetch_add(1);
+			Entry& entry = entries[sequence & mask];
+			uint64_t stamp = entry.stamp.load();
+			do { //wait out a writer one lap behind; give up if one a lap ahead got here first
+				if(stamp >= 2*sequence + 1) return;
+				if(stamp & 1) stamp = entry.stamp.load();
+			} while( (stamp & 1) or !entry.stamp.compare_exchange_weak(stamp, 2*sequence + 1) );
+			entry.kind.store(uint32_t(kind), std::memory_order_relaxed);
+			entry.source.store(source, std::memory_order_relaxed);
+			entry.target.store(target, std::memory_order_relaxed);
+			entry.stamp.store(2*sequence + 2, std::memory_order_release);
+		}
+
+		template<typename F>
+		bool read(unsigned long& cursor, F f) const {
+			//Calls f(event) for each change from cursor up to head(), in order, and advances cursor
+			//past them. Stops early at a change that is still being written. Returns false if any
+			//changes were lost, in which case cursor has been moved past them.
+			bool complete = true;
+			const uint64_t last = next.load();
+			if(last > capacity() and cursor < last - capacity()) {
+				cursor = last - capacity();
+				complete = false;
+			}
+			for(; cursor<last; ++cursor) {
+				const Entry& entry = entries[cursor & mask];
+				const uint64_t stamp = entry.stamp.load(std::memory_order_acquire);
+				if(stamp < 2*cursor + 2) break; //not finished yet
+				ChangeEvent event;
+				event.sequence = cursor;
+				event.kind = ChangeKind( entry.kind.load(std::memory_order_relaxed) );
+				event.source = entry.source.load(std::memory_order_relaxed);
+				event.target = entry.target.load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if(stamp != 2*cursor + 2 or entry.stamp.load(std::memory_order_relaxed) != stamp) {
+					complete = false; //overwritten by a later lap
+					continue;
+				}
+				f(event);
+			}
+			return complete;
+		}
+	}; //class ChangeLog
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,168 @@
+#ifndef BenoitClone_h
+#define BenoitClone_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "Graph.h"
+#include "CSR.h"
+#include "ThreadPool.h"
+
+namespace ben {
+
+	struct LinkAccess {
+	/*
+		Builds links one side at a time, for bulk algorithms that first create every link
+		and then every complement, rather than both ends of each link in turn. Whatever uses
+		it is responsible for leaving both sides consistent.
+	*/
+		template<typename I, typename O>
+		static LinkManager<DirectedNode<I,O>, O>& owned(DirectedNode<I,O>& node) { return node.outputs; }
+		template<typename I, typename O>
+		static LinkManager<DirectedNode<I,O>, I>& complements(DirectedNode<I,O>& node) { return node.inputs; }
+		template<typename P>
+		static LinkManager<UndirectedNode<P>, P>& owned(UndirectedNode<P>& node) { return node.links; }
+		template<typename P>
+		static LinkManager<UndirectedNode<P>, P>& complements(UndirectedNode<P>& node) { return node.links; }
+
+		template<typename M>
+		static void reserve(M& manager, const size_t n) { manager.links.reserve(manager.links.size() + n); }
+		template<typename M>
+		static void append(M& manager, typename M::link_type&& link) { manager.links.push_back( std::move(link) ); }
+		template<typename M>
+		static typename M::link_type& at(M& manager, const size_t k) { return manager.links[k]; }
+		template<typename N>
+		static void touch(const N& node) { node.touch(); }
+	}; //struct LinkAccess
+
+	template<typename N, typename M, typename F>
+	void for_each_owned(const N& node, const size_t i, const M& positions, F f) {
+	//calls f(link, position) for each link that node, at position i, owns among the nodes in
+	//positions: its outputs, or for undirected nodes the links to nodes at i or later
+		for_each_output(node, [&](const typename link_types<N>::output_type& x) {
+			auto iter = positions.find( x.get_address() );
+			if( iter != positions.end() and (link_types<N>::directed or i <= iter->second) ) f(x, iter->second);
+		});
+	}
+
+	template<typename N, typename R, typename F>
+	bool clone_nodes(ThreadPool& pool, const std::vector<N*>& originals, const std::shared_ptr< Graph<N> >& target,
+			 R remap, F make_node, const size_t chunk=64) {
+	/*
+		Copies a set of nodes, and the links among them, into target. Links to nodes outside
+		the set are left out. remap(id) gives each copy's ID, and make_node(target, id) must
+		construct a node with that ID and no links in target, in storage the caller owns, and
+		return a reference to it. Path values are copied; Ports get new, empty Buffers.
+
+		mirror builds links one at a time: a hash lookup, a clone and a push_back on both ends
+		for each. Here the nodes are created first, on the calling thread, since Graph
+		membership isn't thread-safe. Then every node's links are counted and reserved once
+		and cloned in parallel, and finally every complement is created in parallel from a
+		transposed list of the new links. Returns false, having created some nodes but no
+		links, if make_node returns a node with the wrong ID or Graph.
+	*/
+		typedef typename std::remove_reference<decltype( LinkAccess::owned(std::declval<N&>()) )>::type owned_type;
+		typedef typename std::remove_reference<decltype( LinkAccess::complements(std::declval<N&>()) )>::type complement_manager;
+		typedef typename owned_type::link_type link_type;
+		typedef typename complement_manager::link_type complement_type;
+		const bool directed = link_types<N>::directed;
+		const size_t n = originals.size();
+
+		std::unordered_map<typename N::id_type, size_t> positions;
+		positions.reserve(n);
+		for(size_t i=0; i<n; ++i) positions[ originals[i]->ID() ] = i;
+		std::vector<N*> copies(n);
+		for(size_t i=0; i<n; ++i) {
+			const typename N::id_type address = remap( originals[i]->ID() );
+			copies[i] = &make_node(target, address);
+			if(copies[i]->ID() != address or copies[i]->get_index() != target) return false;
+		}
+
+		//A link is owned by its source, or for undirected links by the end that comes first in
+		//originals. Owned links are cloned, and the other end gets a complement.
+		std::vector<size_t> offsets(n+1, 0);
+		pool.parallel_for(n, chunk, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) for_each_owned(*originals[i], i, positions, [&](const link_type&, size_t) { ++offsets[i+1]; });
+		});
+		for(size_t i=0; i<n; ++i) offsets[i+1] += offsets[i];
+		std::vector<uint32_t> targets(offsets[n]);
+		std::vector<const link_type*> sources(offsets[n]);
+		pool.parallel_for(n, chunk, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) {
+				size_t e = offsets[i];
+				for_each_owned(*originals[i], i, positions, [&](const link_type& x, const size_t j) { targets[e] = j; sources[e++] = &x; });
+			}
+		});
+
+		//transpose, leaving out undirected links-to-self, which are stored once
+		std::vector<size_t> in_offsets(n+1, 0);
+		for(size_t i=0; i<n; ++i)
+			for(size_t e=offsets[i]; e<offsets[i+1]; ++e) if(directed or targets[e] != i) ++in_offsets[targets[e]+1];
+		for(size_t i=0; i<n; ++i) in_offsets[i+1] += in_offsets[i];
+		std::vector<uint32_t> in_sources(in_offsets[n]), in_slots(in_offsets[n]);
+		std::vector<size_t> fill(in_offsets.begin(), in_offsets.end()-1);
+		for(size_t i=0; i<n; ++i) {
+			for(size_t e=offsets[i]; e<offsets[i+1]; ++e) {
+				if(!directed and targets[e] == i) continue;
+				size_t slot = fill[targets[e]]++;
+				in_sources[slot] = i;
+				in_slots[slot] = e - offsets[i];
+			}
+		}
+
+		pool.parallel_for(n, chunk, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) {
+				owned_type& links = LinkAccess::owned(*copies[i]);
+				const size_t out = offsets[i+1] - offsets[i], in = in_offsets[i+1] - in_offsets[i];
+				if(directed) {
+					LinkAccess::reserve(links, out);
+					LinkAccess::reserve(LinkAccess::complements(*copies[i]), in);
+				} else LinkAccess::reserve(links, out + in); //the same LinkManager
+				for(size_t e=offsets[i]; e<offsets[i+1]; ++e)
+					LinkAccess::append(links, sources[e]->clone( copies[targets[e]]->ID() ));
+			}
+		});
+		//every owned link exists and no vector will grow, so complements can refer to them; the
+		//links are looked up before any complement is appended, because for UndirectedNode the
+		//owned links and the complements share one vector, which can't be read while it grows
+		std::vector<link_type*> in_links(in_offsets[n]);
+		pool.parallel_for(n, chunk, [&](const size_t first, const size_t last) {
+			for(size_t j=first; j<last; ++j)
+				for(size_t s=in_offsets[j]; s<in_offsets[j+1]; ++s)
+					in_links[s] = &LinkAccess::at(LinkAccess::owned(*copies[ in_sources[s] ]), in_slots[s]);
+		});
+		pool.parallel_for(n, chunk, [&](const size_t first, const size_t last) {
+			for(size_t j=first; j<last; ++j) {
+				complement_manager& links = LinkAccess::complements(*copies[j]);
+				for(size_t s=in_offsets[j]; s<in_offsets[j+1]; ++s)
+					LinkAccess::append(links, complement_type(*in_links[s], copies[ in_sources[s] ]->ID()));
+			}
+		});
+		for(auto x : copies) LinkAccess::touch(*x);
+		return true;
+	}
+
+} //namespace ben
+
+#endif
+
@@ -24,8 +24,8 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <iostream>
-#include <boost/thread/shared_mutex.hpp>
+#include <thread>
+#include <memory>
 
 namespace ben {
 
@@ -37,36 +37,132 @@ namespace ben {
 		
 		This type of lock is also called readers-writer or shared-exclusive.
 		
-		This particular version of Commons simply wraps boost:shared_mutex.
+		Readers don't share one counter. Each thread is given a slot the 
+		first time it locks anything, and slots are spread over as many 
+		separate cache lines as there are cores (up to 64), so readers on 
+		different cores don't pass a cache line back and forth. A writer 
+		raises a flag and waits for every slot to empty. A reader adds 
+		itself to its slot and checks the flag; if it's up, the reader 
+		backs out and waits, spinning briefly and then sleeping. Writers 
+		take turns on a mutex. Writing costs a pass over the slots, which 
+		suits data that is read far more than it is written.
+		
+		With writer preference, the default, a waiting writer raises the 
+		flag at once and new readers wait behind it. Without it, the 
+		writer waits until no one is reading before raising the flag, so 
+		readers are never held up by a waiting writer, but a steady 
+		stream of them can hold it off indefinitely. 
 	*/
 	private:
-		boost::shared_mutex rwlock;
+		struct Slot {
+			std::atomic<long> readers;
+			char padding[128 - sizeof(std::atomic<long>)]; //own cache line, even if misaligned
+		};
+		
+		const bool prefer_writers;
+		unsigned mask; //slot count - 1
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<bool> writer; //writing, or about to
+		std::mutex writers; //one writer at a time
+		std::atomic<unsigned> sleepers; //readers waiting on cleared
+		std::mutex gate;
+		std::condition_variable cleared;
+		
+		static unsigned thread_slot() {
+			//round-robin, so threads spread evenly over the slots
+			static std::atomic<unsigned> next(0);
+			thread_local unsigned slot = next.fetch_add(1, std::memory_order_relaxed);
+			return slot;
+		}
+		Slot& mine() { return slots[thread_slot() & mask]; }
+		bool drained() const {
+			for(unsigned i=0; i<=mask; ++i) 
+				if(slots[i].readers.load() != 0) return false;
+			return true;
+		}
+		void lower_flag() {
+			writer.store(false);
+			if(sleepers.load() > 0) {
+				{ std::lock_guard<std::mutex> lock(gate); }
+				cleared.notify_all();
+			}
+		}
+		void wait_for_writer() {
+			for(unsigned i=0; i<64; ++i) {
+				if(!writer.load()) return;
+				std::this_thread::yield();
+			}
+			std::unique_lock<std::mutex> lock(gate);
+			++sleepers;
+			cleared.wait(lock, [this]() { return !writer.load(); });
+			--sleepers;
+		}
+		void wait_for_readers() const {
+			while(!drained()) std::this_thread::yield();
+		}
 		
 	public:
-		Commons() = default;
+		explicit Commons(const bool writer_preference=true) 
+			: prefer_writers(writer_preference), mask(0), slots(), 
+			  writer(false), writers(), sleepers(0), gate(), cleared() {
+			unsigned cores = std::thread::hardware_concurrency();
+			if(cores > 64) cores = 64;
+			while(mask + 1 < cores) mask = 2*mask + 1;
+			slots.reset(new Slot[mask + 1]);
+			for(unsigned i=0; i<=mask; ++i) slots[i].readers.store(0);
+		}
 		Commons(const Commons& rhs) = delete;
 		Commons& operator=(const Commons& rhs) = delete;
 		virtual ~Commons() = default;
 		
-		//observers
-		//bool read_locked() const { return readers.load() > 0; }
-		//bool writer_waiting() const { return waiting_writers.load() > 0; }
-		//bool write_locked() {
-		//	if(rwlock.try_lock()) {
-		//		rwlock.unlock();
-		//		return false;
-		//	} else return true;
-		//}
+		bool writer_preference() const { return prefer_writers; }
 		
 		//read or shared locking
-		void read_lock() { rwlock.lock_shared(); }
-		bool try_read_lock() { rwlock.try_lock_shared(); }
-		void read_unlock() { rwlock.unlock_shared(); }
+		void read_lock() { 
+			Slot& slot = mine();
+			while(true) {
+				slot.readers.fetch_add(1);
+				if(!writer.load()) return;
+				slot.readers.fetch_sub(1);
+				wait_for_writer();
+			}
+		}
+		bool try_read_lock() { 
+			Slot& slot = mine();
+			slot.readers.fetch_add(1);
+			if(!writer.load()) return true;
+			slot.readers.fetch_sub(1);
+			return false;
+		}
+		void read_unlock() { mine().readers.fetch_sub(1, std::memory_order_release); }
 		
 		//write or unique locking
-		void write_lock() { rwlock.lock(); }
-		bool try_write_lock() { rwlock.try_lock(); }
-		void write_unlock() { rwlock.unlock(); }
+		void write_lock() { 
+			writers.lock();
+			if(prefer_writers) {
+				writer.store(true);
+				wait_for_readers();
+				return;
+			}
+			while(true) {
+				wait_for_readers();
+				writer.store(true);
+				if( drained() ) return;
+				lower_flag(); //a reader got in first
+			}
+		}
+		bool try_write_lock() { 
+			if( !writers.try_lock() ) return false;
+			writer.store(true);
+			if( drained() ) return true;
+			lower_flag();
+			writers.unlock();
+			return false;
+		}
+		void write_unlock() { 
+			lower_flag();
+			writers.unlock();
+		}
 		
 	}; //class Commons
 
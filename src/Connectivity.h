@@ -0,0 +1,152 @@
+#ifndef BenoitConnectivity_h
+#define BenoitConnectivity_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "Graph.h"
+#include "CSR.h"
+#include "ChangeLog.h"
+
+namespace ben {
+/* Connectivity answers "are these two nodes connected?" for a Graph in near-constant time, using a
+ * union-find (disjoint set) structure kept up to date from the Graph's ChangeLog, which it enables
+ * if need be. Links of DirectedNodes count in both directions, so components are weakly connected.
+ *
+ * Before each query, the changes logged since the last one are applied. Nodes joining and links
+ * being added are merged in directly, at nearly constant cost each. Union-find can't split a set,
+ * so a removed link, a node leaving, or a bulk change (links_reset) marks the structure stale, and
+ * it is rebuilt from the Graph once all pending changes have been read. A stream of additions is
+ * therefore cheap, and a stream of removals costs one rebuild per query that follows removals,
+ * not one per removal. A consumer that falls behind the log also rebuilds.
+ *
+ * Connectivity is not thread-safe, and its queries are not const, because they apply pending
+ * changes and compress paths. Don't query it while other threads change the Graph unless they
+ * go through GraphBatch, whose write lock a rebuild waits for.
+ */
+	template<typename N>
+	class Connectivity {
+	public:
+		typedef N node_type;
+		typedef Graph<N> graph_type;
+		typedef typename N::id_type id_type;
+
+	private:
+		typedef Connectivity self_type;
+		std::shared_ptr<graph_type> graph;
+		std::shared_ptr<ChangeLog> log;
+		unsigned long cursor;
+		std::unordered_map<id_type, size_t> slots;
+		std::vector<size_t> parent, sizes;
+		size_t count; //number of components
+		unsigned long rebuilds;
+
+		size_t slot_of(const id_type address) {
+			//adds a singleton set for unknown IDs
+			auto iter = slots.find(address);
+			if(iter != slots.end()) return iter->second;
+			size_t slot = parent.size();
+			slots[address] = slot;
+			parent.push_back(slot);
+			sizes.push_back(1);
+			++count;
+			return slot;
+		}
+		size_t root(size_t x) {
+			while(parent[x] != x) { //path halving
+				parent[x] = parent[parent[x]];
+				x = parent[x];
+			}
+			return x;
+		}
+		void unite(const id_type a, const id_type b) {
+			size_t x = root(slot_of(a)), y = root(slot_of(b));
+			if(x == y) return;
+			if(sizes[x] < sizes[y]) std::swap(x, y);
+			parent[y] = x;
+			sizes[x] += sizes[y];
+			--count;
+		}
+
+	public:
+		Connectivity() = delete;
+		explicit Connectivity(const std::shared_ptr<graph_type>& target, const size_t log_capacity=(1 << 16))
+			: graph(target), cursor(0), count(0), rebuilds(0) {
+			graph->enable_log(log_capacity);
+			log = graph->get_log();
+			rebuild();
+		}
+		Connectivity(const self_type& rhs) = delete;
+		self_type& operator=(const self_type& rhs) = delete;
+		~Connectivity() = default;
+
+		void rebuild() {
+			//from scratch, in O(nodes + links)
+			ScopedReadLock lock(*graph);
+			cursor = log->head(); //changes made during the scan are replayed, harmlessly
+			slots.clear();
+			parent.clear();
+			sizes.clear();
+			count = 0;
+			slots.reserve(graph->size());
+			for(auto& x : *graph) {
+				slot_of(x.ID());
+				for_each_output(x, [&](const typename link_types<N>::output_type& link) { unite(x.ID(), link.get_address()); });
+			}
+			++rebuilds;
+		}
+		void refresh() {
+			//applies logged changes, rebuilding if any of them can't be applied incrementally
+			bool stale = false;
+			bool complete = log->read(cursor, [&](const ChangeEvent& event) {
+				if(stale) return;
+				switch(event.kind) {
+					case ChangeKind::joined: slot_of(event.source); break;
+					case ChangeKind::link_added: unite(event.source, event.target); break;
+					case ChangeKind::value_changed: break;
+					default: stale = true; //left, link_removed, links_reset
+				}
+			});
+			if(stale or !complete) rebuild();
+		}
+
+		bool connected(const id_type a, const id_type b) {
+			//false if either node isn't in the Graph
+			refresh();
+			auto x = slots.find(a), y = slots.find(b);
+			if(x == slots.end() or y == slots.end()) return false;
+			return root(x->second) == root(y->second);
+		}
+		size_t component_size(const id_type address) {
+			refresh();
+			auto x = slots.find(address);
+			return x == slots.end() ? 0 : sizes[ root(x->second) ];
+		}
+		size_t components() { refresh(); return count; }
+		unsigned long get_rebuilds() const { return rebuilds; } //including the initial build
+	}; //class Connectivity
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,162 @@
+#ifndef BenoitCoordinateArray_h
+#define BenoitCoordinateArray_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "SpatialIndex.h"
+
+namespace ben {
+/* CoordinateArray stores a set of points as a structure of arrays: one contiguous column per
+ * coordinate, plus a column of IDs, with no gaps. A hash map from ID to position makes every change
+ * O(1); a removal moves the last point into the hole. Space keeps one as a mirror of its Points'
+ * coordinates, and it is also a SpatialIndex in its own right, answering every query with a linear
+ * scan. The scans run over the columns in chunks with the batched distance kernels, so they read
+ * memory in order and never touch the Points. That makes it the fastest index for small sets and a
+ * baseline for the others. column(i) and ids() expose the raw arrays for scans of your own; any
+ * change may reorder them.
+ */
+	template<typename T, unsigned short N>
+	class CoordinateArray : public SpatialIndex<T,N> {
+	private:
+		typedef SpatialIndex<T,N> base_type;
+		typedef CoordinateArray self_type;
+
+	public:
+		typedef typename base_type::point_type point_type;
+		typedef typename base_type::id_type id_type;
+		typedef typename base_type::region_type region_type;
+
+	private:
+		std::array<std::vector<T>,N> columns;
+		std::vector<id_type> addresses;
+		std::unordered_map<id_type, size_t> position;
+
+		std::array<const T*,N> from(const size_t first) const {
+			std::array<const T*,N> starts;
+			for(unsigned short i=0; i<N; ++i) starts[i] = columns[i].data() + first;
+			return starts;
+		}
+		template<typename F>
+		void for_each_distance(const point_type& center, F f) const {
+			//calls f(position, squared distance) for every point
+			static const size_t chunk = 256;
+			double squares[chunk];
+			for(size_t i=0; i<addresses.size(); i+=chunk) {
+				size_t n = std::min(chunk, addresses.size() - i);
+				distances<SquaredEuclidean>(center, from(i), n, squares);
+				for(size_t j=0; j<n; ++j) f(i+j, squares[j]);
+			}
+		}
+
+	public:
+		CoordinateArray() = default;
+		CoordinateArray(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~CoordinateArray() = default;
+
+		const T* column(const unsigned short i) const { return columns[i].data(); }
+		const std::vector<id_type>& ids() const { return addresses; }
+		point_type point(const size_t i) const {
+			point_type x;
+			for(unsigned short j=0; j<N; ++j) x[j] = columns[j][i];
+			return x;
+		}
+		bool contains(const id_type address) const { return position.count(address) == 1; }
+		bool find(const id_type address, point_type& output) const {
+			auto iter = position.find(address);
+			if(iter == position.end()) return false;
+			output = point(iter->second);
+			return true;
+		}
+
+		void build(const std::vector< std::pair<id_type, point_type> >& points) {
+			clear();
+			for(auto& x : columns) x.reserve(points.size());
+			addresses.reserve(points.size());
+			position.reserve(points.size());
+			for(auto& x : points) insert(x.first, x.second);
+		}
+		bool insert(const id_type address, const point_type& point) {
+			if( !position.insert(std::make_pair(address, addresses.size())).second ) return false;
+			addresses.push_back(address);
+			for(unsigned short i=0; i<N; ++i) columns[i].push_back(point[i]);
+			return true;
+		}
+		bool remove(const id_type address) {
+			auto iter = position.find(address);
+			if(iter == position.end()) return false;
+			size_t hole = iter->second, last = addresses.size() - 1;
+			position.erase(iter);
+			if(hole != last) {
+				addresses[hole] = addresses[last];
+				for(auto& x : columns) x[hole] = x[last];
+				position[addresses[hole]] = hole;
+			}
+			addresses.pop_back();
+			for(auto& x : columns) x.pop_back();
+			return true;
+		}
+		bool move(const id_type address, const point_type& point) {
+			auto iter = position.find(address);
+			if(iter == position.end()) return false;
+			for(unsigned short i=0; i<N; ++i) columns[i][iter->second] = point[i];
+			return true;
+		}
+		void clear() {
+			for(auto& x : columns) x.clear();
+			addresses.clear();
+			position.clear();
+		}
+		size_t size() const { return addresses.size(); }
+
+		void in_region(const region_type& region, std::vector<id_type>& output) const {
+			for(size_t i=0; i<addresses.size(); ++i) {
+				bool inside = true;
+				for(unsigned short j=0; j<N; ++j)
+					if(columns[j][i] < region.lower[j] or columns[j][i] > region.upper[j]) inside = false;
+				if(inside) output.push_back(addresses[i]);
+			}
+		}
+		void within(const point_type& center, const double radius, std::vector<id_type>& output) const {
+			if(radius < 0.0) return;
+			const double limit = radius*radius;
+			for_each_distance(center, [&](const size_t i, const double square) {
+				if(square <= limit) output.push_back(addresses[i]);
+			});
+		}
+		size_t nearest(const point_type& center, const size_t k, Neighbor* output) const {
+			size_t count = 0;
+			if(k == 0) return 0;
+			for_each_distance(center, [&](const size_t i, const double square) {
+				base_type::offer(output, count, k, addresses[i], square);
+			});
+			return base_type::finish(output, count);
+		}
+	}; //class CoordinateArray
+
+} //namespace ben
+
+#endif
+
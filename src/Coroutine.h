@@ -0,0 +1,283 @@
+#ifndef BenoitCoroutine_h
+#define BenoitCoroutine_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+//Unlike the rest of Benoit, this header needs C++20. Nothing else includes it.
+#if !defined(__cpp_impl_coroutine)
+#error "Coroutine.h needs C++20 coroutine support (-std=c++20)"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include "Graph.h"
+#include "ThreadPool.h"
+
+namespace ben {
+/* Coroutine support lets a node's long-lived behavior be written as straight-line code instead of a
+ * state machine. A behavior is a coroutine returning NodeTask, bound to one node with
+ * CoroutineScheduler::spawn. Inside it,
+ *
+ * 	co_await pull(port)		suspends until the InPort yields a signal, and returns it
+ * 	co_await any_input(node)	suspends until any input of the node yields, and returns
+ * 					the source ID and the signal
+ *
+ * and signals are sent with CoroutineScheduler::push, which wakes the target if it is suspended.
+ * Suspended behaviors cost no thread; CoroutineScheduler::run multiplexes all of them onto a
+ * ThreadPool until none can make progress.
+ *
+ * Buffers can't be inspected without pulling, so waiting works by polling: a woken awaiter tries
+ * its pull again before resuming the coroutine, and goes back to sleep if the signal was meant
+ * for another port. Registration is followed by one more poll, so a push that lands in between is
+ * never lost. At most one coroutine per node may be suspended at a time.
+ */
+	class CoroutineContext;
+
+	struct Waiter {
+	//something a coroutine is suspended on; poll() is called before each resumption
+		std::coroutine_handle<> handle;
+		size_t slot = 0; //of the node whose coroutine is waiting
+		virtual bool poll() = 0;
+	protected:
+		~Waiter() = default;
+	};
+
+	class NodeTask {
+	public:
+		struct promise_type {
+			CoroutineContext* context = nullptr;
+			size_t slot = 0;
+			struct Start : Waiter { bool poll() { return true; } } start;
+
+			NodeTask get_return_object()
+				{ return NodeTask( std::coroutine_handle<promise_type>::from_promise(*this) ); }
+			std::suspend_always initial_suspend() noexcept { return {}; } //started by spawn
+			std::suspend_always final_suspend() noexcept { return {}; } //destroyed by the scheduler
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+		typedef std::coroutine_handle<promise_type> handle_type;
+
+	private:
+		friend class CoroutineContext;
+		handle_type handle;
+
+	public:
+		explicit NodeTask(handle_type h) : handle(h) {}
+		NodeTask(const NodeTask& rhs) = delete;
+		NodeTask& operator=(const NodeTask& rhs) = delete;
+		NodeTask(NodeTask&& rhs) : handle(rhs.handle) { rhs.handle = nullptr; }
+		~NodeTask() { if(handle) handle.destroy(); } //only if never spawned
+	}; //class NodeTask
+
+
+	class CoroutineContext {
+	/*
+		The node-type-independent half of CoroutineScheduler: one waiter slot per node,
+		the ready queue and the run loop.
+	*/
+	private:
+		struct Slot {
+			std::atomic<Waiter*> waiting{nullptr};
+			std::atomic<bool> notified{false}; //set by every wake, cleared before each poll
+			char padding[64 - sizeof(std::atomic<Waiter*>) - sizeof(std::atomic<bool>)];
+		};
+
+		ThreadPool* pool;
+		std::unique_ptr<Slot[]> slots;
+		std::vector<NodeTask::handle_type> tasks;
+		std::mutex queue_mutex;
+		std::deque<Waiter*> ready;
+		std::atomic<size_t> pending{0}; //queued or running waiters
+
+		void enqueue(Waiter* w) {
+			pending.fetch_add(1);
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			ready.push_back(w);
+		}
+		Waiter* dequeue() {
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			if( ready.empty() ) return nullptr;
+			Waiter* w = ready.front();
+			ready.pop_front();
+			return w;
+		}
+
+	protected:
+		explicit CoroutineContext(ThreadPool& workers) : pool(&workers) {}
+		~CoroutineContext() { for(auto h : tasks) h.destroy(); }
+
+		void resize(const size_t n) { slots.reset(new Slot[n]); }
+		void start(NodeTask&& task, const size_t slot) {
+			auto h = task.handle;
+			task.handle = nullptr;
+			h.promise().context = this;
+			h.promise().slot = slot;
+			h.promise().start.handle = h;
+			h.promise().start.slot = slot;
+			tasks.push_back(h);
+			enqueue(&h.promise().start);
+		}
+		void wake(const size_t slot) {
+			slots[slot].notified.store(true);
+			Waiter* w = slots[slot].waiting.exchange(nullptr);
+			if(w) enqueue(w);
+		}
+
+	public:
+		CoroutineContext(const CoroutineContext& rhs) = delete;
+		CoroutineContext& operator=(const CoroutineContext& rhs) = delete;
+
+		bool suspend(const size_t slot, Waiter* w) {
+			//Polls w and, if it isn't ready, registers it to be woken. Returns false if w is 
+			//ready and the coroutine should carry on. Once w is registered a waking thread
+			//may queue it and another worker may resume the coroutine, so after that point
+			//only the slot is touched, never w.
+			Slot& s = slots[slot];
+			while(true) {
+				s.notified.store(false);
+				if( w->poll() ) return false;
+				s.waiting.store(w);
+				if( !s.notified.load() ) return true; 
+				//a wake raced with registration: take w back and poll again, unless the
+				//waking thread already queued it
+				Waiter* expected = w;
+				if( !s.waiting.compare_exchange_strong(expected, nullptr) ) return true;
+			}
+		}
+
+		size_t live() const {
+			size_t n = 0;
+			for(auto h : tasks) if( !h.done() ) ++n;
+			return n;
+		}
+
+		void run() {
+			//resumes coroutines until none are ready
+			pool->parallel([this](const unsigned worker) {
+				while( pending.load() > 0 ) {
+					Waiter* w = dequeue();
+					if(w == nullptr) { std::this_thread::yield(); continue; }
+					if( !suspend(w->slot, w) ) w->handle.resume();
+					pending.fetch_sub(1);
+				}
+			});
+		}
+	}; //class CoroutineContext
+
+
+	template<typename P>
+	struct PullAwaiter : Waiter {
+		typedef typename P::signal_type signal_type;
+		const P* port;
+		signal_type signal;
+		explicit PullAwaiter(const P& p) : port(&p), signal() {}
+		bool poll() { return port->pull(signal); }
+		bool await_ready() { return poll(); }
+		bool await_suspend(NodeTask::handle_type h) {
+			handle = h;
+			slot = h.promise().slot;
+			return h.promise().context->suspend(h.promise().slot, this);
+		}
+		signal_type await_resume() { return signal; }
+	}; //struct PullAwaiter
+
+	template<typename N>
+	struct AnyInputAwaiter : Waiter {
+		typedef typename N::id_type id_type;
+		typedef typename N::input_type::signal_type signal_type;
+		struct result_type { id_type source; signal_type signal; };
+		const N* node;
+		result_type result;
+		explicit AnyInputAwaiter(const N& n) : node(&n), result() {}
+		bool poll() {
+			for(auto& x : node->inputs)
+				if( x.pull(result.signal) ) { result.source = x.get_address(); return true; }
+			return false;
+		}
+		bool await_ready() { return poll(); }
+		bool await_suspend(NodeTask::handle_type h) {
+			handle = h;
+			slot = h.promise().slot;
+			return h.promise().context->suspend(h.promise().slot, this);
+		}
+		result_type await_resume() { return result; }
+	}; //struct AnyInputAwaiter
+
+	template<typename P>
+	PullAwaiter<P> pull(const P& port) { return PullAwaiter<P>(port); }
+	template<typename N>
+	AnyInputAwaiter<N> any_input(const N& node) { return AnyInputAwaiter<N>(node); }
+
+
+	template<typename N>
+	class CoroutineScheduler : public CoroutineContext {
+	/*
+		Binds behaviors to the nodes of a Graph. Like DataflowScheduler, it works from a
+		snapshot of Graph::ordering() taken on construction.
+	*/
+	public:
+		typedef N node_type;
+		typedef Graph<N> graph_type;
+		typedef typename N::id_type id_type;
+		typedef typename N::output_iterator output_iterator;
+		typedef typename N::output_type::signal_type signal_type;
+
+	private:
+		std::unordered_map<id_type, size_t> positions;
+
+	public:
+		CoroutineScheduler(ThreadPool& workers, const graph_type& graph) : CoroutineContext(workers) {
+			auto& nodes = graph.ordering();
+			positions.reserve(nodes.size());
+			for(size_t i=0; i<nodes.size(); ++i) positions[nodes[i]->ID()] = i;
+			resize(nodes.size());
+		}
+
+		bool spawn(const node_type& node, NodeTask&& task) {
+			//the task starts at the next call to run()
+			auto iter = positions.find(node.ID());
+			if(iter == positions.end()) return false;
+			start(std::move(task), iter->second);
+			return true;
+		}
+		bool push(const output_iterator iter, const signal_type& signal) {
+			//same return value as OutPort::push
+			bool delivered = iter->push(signal);
+			if(delivered) {
+				auto target = positions.find(iter->get_address());
+				if(target != positions.end()) wake(target->second);
+			}
+			return delivered;
+		}
+	}; //class CoroutineScheduler
+
+} //namespace ben
+
+#endif
+
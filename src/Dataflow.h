@@ -0,0 +1,193 @@
+#ifndef BenoitDataflow_h
+#define BenoitDataflow_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "Graph.h"
+#include "ThreadPool.h"
+
+namespace ben {
+
+	class ReadySet {
+	/*
+		A fixed-size bitmap of atomic words. Setting a bit is one fetch_or, and the
+		return value says whether this call was the one that set it, so each slot is
+		queued at most once no matter how many threads mark it. drain() hands out
+		whole words, clearing them as it goes.
+	*/
+	private:
+		typedef uint64_t word_type;
+		static const unsigned word_bits = 64;
+		std::unique_ptr<std::atomic<word_type>[]> words;
+		size_t n_words;
+		std::atomic<size_t> marked; //bits set since the last drain, possibly overcounted
+
+	public:
+		explicit ReadySet(const size_t n=0) : words(), n_words(0), marked(0) { resize(n); }
+		ReadySet(const ReadySet& rhs) = delete;
+		ReadySet& operator=(const ReadySet& rhs) = delete;
+		~ReadySet() = default;
+
+		void resize(const size_t n) {
+			//clears all bits
+			n_words = (n + word_bits - 1) / word_bits;
+			words.reset(new std::atomic<word_type>[n_words]);
+			for(size_t i=0; i<n_words; ++i) words[i].store(0);
+			marked.store(0);
+		}
+		size_t word_count() const { return n_words; }
+		bool empty() const { return marked.load() == 0; }
+
+		bool mark(const size_t slot) {
+			//returns true if the bit was clear
+			const word_type bit = word_type(1) << (slot % word_bits);
+			bool fresh = !( words[slot / word_bits].fetch_or(bit) & bit );
+			if(fresh) marked.fetch_add(1);
+			return fresh;
+		}
+		bool is_marked(const size_t slot) const
+			{ return words[slot / word_bits].load() & (word_type(1) << (slot % word_bits)); }
+
+		template<typename F>
+		void drain(const size_t word, F f) {
+			//clears one word and calls f(slot) for each bit that was set
+			word_type bits = words[word].exchange(0);
+			while(bits) {
+				unsigned bit = __builtin_ctzll(bits);
+				bits &= bits - 1;
+				f(word*word_bits + bit);
+			}
+		}
+		void reset_count() { marked.store(0); } //call once all words have been drained
+	}; //class ReadySet
+
+
+/* DataflowScheduler runs only the nodes that have received messages. It is meant for message
+ * graphs (stdMessageNode and anything else with OutPort outputs) where most nodes are idle most
+ * of the time, so that CPU cost follows message traffic instead of graph size.
+ *
+ * Messages sent through DataflowScheduler::push mark their target ready whenever the Buffer
+ * reports that no unread signal was overwritten, that is, whenever the push delivered new data.
+ * Execution proceeds in ticks: run_tick() steps every node that was ready at the start of the tick,
+ * in parallel, and nodes marked during a tick run in the next one. Sources outside the graph can
+ * wake nodes with activate().
+ *
+ * A step function is called as step(node, scheduler) and should pull what it needs from its
+ * InPorts; a node that leaves data unread is not woken again until another message arrives, unless
+ * it calls activate on itself. Pushing through an OutPort directly bypasses the scheduler.
+ *
+ * The set of nodes is a snapshot of Graph::ordering(), taken on construction and by refresh(). Call
+ * refresh() between ticks after adding or removing nodes; pending activations are dropped.
+ */
+	template<typename N>
+	class DataflowScheduler {
+	public:
+		typedef N node_type;
+		typedef Graph<N> graph_type;
+		typedef typename N::id_type id_type;
+		typedef typename N::output_iterator output_iterator;
+		typedef typename N::output_type::signal_type signal_type;
+
+	private:
+		typedef DataflowScheduler self_type;
+		ThreadPool* pool;
+		const graph_type* graph;
+		std::vector<node_type*> nodes;
+		std::unordered_map<id_type, size_t> slots;
+		ReadySet sets[2];
+		unsigned current; //index of the set being drained; the other collects new activations
+		size_t chunk_words;
+
+	public:
+		DataflowScheduler() = delete;
+		DataflowScheduler(ThreadPool& workers, const graph_type& g, const size_t chunk=4)
+			: pool(&workers), graph(&g), current(0), chunk_words(chunk) { refresh(); }
+		DataflowScheduler(const self_type& rhs) = delete;
+		self_type& operator=(const self_type& rhs) = delete;
+		~DataflowScheduler() = default;
+
+		void refresh() {
+			nodes = graph->ordering();
+			slots.clear();
+			slots.reserve(nodes.size());
+			for(size_t i=0; i<nodes.size(); ++i) slots[nodes[i]->ID()] = i;
+			sets[0].resize(nodes.size());
+			sets[1].resize(nodes.size());
+		}
+
+		size_t size() const { return nodes.size(); }
+		bool idle() const { return sets[1-current].empty(); }
+		bool is_ready(const id_type address) const {
+			auto iter = slots.find(address);
+			return iter != slots.end() and sets[1-current].is_marked(iter->second);
+		}
+
+		bool activate(const id_type address) {
+			//schedules the node for the next tick, returns false if it isn't in the snapshot
+			auto iter = slots.find(address);
+			if(iter == slots.end()) return false;
+			sets[1-current].mark(iter->second);
+			return true;
+		}
+		bool push(const output_iterator iter, const signal_type& signal) {
+			//same return value as OutPort::push
+			bool delivered = iter->push(signal);
+			if(delivered) activate(iter->get_address());
+			return delivered;
+		}
+
+		template<typename F>
+		size_t run_tick(F step) {
+			//returns the number of nodes stepped
+			current = 1 - current; //new activations now go to the other set
+			ReadySet& ready = sets[current];
+			if( ready.empty() ) return 0;
+			std::atomic<size_t> count(0);
+			pool->parallel_for(ready.word_count(), chunk_words, [&](const size_t first, const size_t last) {
+				size_t local = 0;
+				for(size_t w=first; w<last; ++w)
+					ready.drain(w, [&](const size_t slot) { step(*nodes[slot], *this); ++local; });
+				count.fetch_add(local);
+			});
+			ready.reset_count();
+			return count.load();
+		}
+		template<typename F>
+		size_t run(F step, const size_t max_ticks=size_t(-1)) {
+			//runs ticks until no node is ready, returns the number of ticks
+			size_t ticks = 0;
+			while( ticks < max_ticks and !idle() ) {
+				run_tick(step);
+				++ticks;
+			}
+			return ticks;
+		}
+	}; //class DataflowScheduler
+
+} //namespace ben
+
+#endif
+
@@ -24,6 +24,7 @@
 #include <iostream>
 #include <list>
 #include <vector>
+#include <algorithm>
 #include <atomic>
 #include <mutex>
 #include "Singleton.h"
@@ -31,6 +32,7 @@
 #include "Path.h"
 #include "Port.h"
 #include "LinkManager.h"
+#include "ChangeLog.h"
 
 namespace ben {	
 /* A DirectedNode is the vertex of a distributed directed graph structure. Each is managed by an Index, 
@@ -67,7 +69,19 @@ namespace ben {
 			      "Index and Port unique ID types don't match");
 	
 		//std::mutex node_mutex; //would need this to alter graph structure in multiple threads
+		friend struct LinkAccess;
 		void perform_leave() { clear(); }
+		void touch(const ChangeKind kind, const id_type source, const id_type target) const { 
+			//lets the Graph know that its links have changed
+			auto graph = get_index();
+			if(graph) graph->links_changed(kind, source, target);
+		}
+		void touch() const { touch(ChangeKind::links_reset, ID(), ID()); } //after changes to several links
+		void touch_value(const id_type target) const {
+			//lets the Graph log a new link value; the links themselves haven't changed
+			auto graph = get_index();
+			if(graph) graph->value_changed(ID(), target);
+		}
 		
 	public:
 		//although these are public, do not count on the type staying the same, just that there
@@ -94,6 +108,7 @@ namespace ben {
 				inputs = std::move(rhs.inputs);
 				outputs = std::move(rhs.outputs);
 			}
+			return *this;
 		}
 		virtual ~DirectedNode() { clear(); } //might want to lock while deleting links 
 	
@@ -116,7 +131,8 @@ namespace ben {
 			//the type safety for this function comes in LinkManager::add
 			auto iter = get_index()->find(address);
 			if( iter == get_index()->end() ) return false;
-			else return inputs.add(iter->outputs, args...);
+			else if( inputs.add(iter->outputs, args...) ) { touch(ChangeKind::link_added, address, ID()); return true; }
+			else return false;
 
 			//if( get_index()->manages(address) ) {
 			//	return inputs.add(get_index()->elem(address).outputs, args...);
@@ -126,7 +142,8 @@ namespace ben {
 		bool add_output(const id_type address, ARGS... args) {//see add_input
 			auto iter = get_index()->find(address);
 			if( iter == get_index()->end() ) return false;
-			else return outputs.add(iter->inputs, args...);
+			else if( outputs.add(iter->inputs, args...) ) { touch(ChangeKind::link_added, ID(), address); return true; }
+			else return false;
 
 			//if( get_index()->manages(address) ) {
 			//	return outputs.add(get_index()->elem(address).inputs, args...);
@@ -237,41 +254,83 @@ namespace ben {
 					}
 				}
 
+				touch();
 				return true;
 			} else return false;
 		}
 
+		template<typename V>
+		bool set_value(const id_type address, const V& v) {
+			//sets the value of the output Path to address, and logs it in the Graph's ChangeLog,
+			//which Path::set_value can't reach; returns false if there is no such output
+			auto iter = outputs.find(address);
+			if( iter == outputs.end() ) return false;
+			iter->set_value(v);
+			touch_value(address);
+			return true;
+		}
+
 		void remove_input(const input_iterator iter) {
 			//O(1); doesn't have to call LinkManager::find first
 			auto address = iter->get_address();
 			inputs.remove(walk(iter).outputs, iter);
+			touch(ChangeKind::link_removed, address, ID());
 		}
 		void remove_input(const id_type address) {
 			//O(n), must search for the right port
-			auto node_iter = get_index()->find(address);
-			if( node_iter == get_index()->end() ) return;
-			else inputs.remove(node_iter->outputs);
+			auto iter = inputs.find(address);
+			if( iter != inputs.end() ) remove_input(iter);
 			//inputs.remove(get_index()->elem(address).outputs);
 		}
 		void remove_output(const output_iterator iter) { //see remove_input
 			auto address = iter->get_address();
 			outputs.remove(walk(iter).inputs, iter);
+			touch(ChangeKind::link_removed, ID(), address);
 		}
 		void remove_output(const id_type address) { //see remove_input
-			auto node_iter = get_index()->find(address);
-			if( node_iter == get_index()->end() ) return;
-			else outputs.remove(node_iter->inputs);
+			auto iter = outputs.find(address);
+			if( iter != outputs.end() ) remove_output(iter);
 			//outputs.remove(get_index()->elem(address).inputs);
 		}
 		
+		size_t remove_inputs(std::vector<id_type> addresses) {
+			//removes the inputs from all of addresses with one pass over inputs, instead of one
+			//search per address; addresses that aren't inputs are ignored
+			//returns the number removed
+			if(inputs.size() == 0 or addresses.empty()) return 0;
+			std::sort(addresses.begin(), addresses.end());
+			auto listed = [&](const id_type x) { return std::binary_search(addresses.begin(), addresses.end(), x); };
+			for(auto iter=inputs.begin(); iter!=inputs.end(); ++iter) 
+				if( listed(iter->get_address()) ) walk(iter).outputs.clean_up(ID());
+			size_t removed = inputs.clean_up_if(listed);
+			if(removed > 0) touch();
+			return removed;
+		}
+		size_t remove_outputs(std::vector<id_type> addresses) { //see remove_inputs
+			if(outputs.size() == 0 or addresses.empty()) return 0;
+			std::sort(addresses.begin(), addresses.end());
+			auto listed = [&](const id_type x) { return std::binary_search(addresses.begin(), addresses.end(), x); };
+			for(auto iter=outputs.begin(); iter!=outputs.end(); ++iter) 
+				if( listed(iter->get_address()) ) walk(iter).inputs.clean_up(ID());
+			size_t removed = outputs.clean_up_if(listed);
+			if(removed > 0) touch();
+			return removed;
+		}
+		void reserve_inputs(const size_t n) { inputs.reserve(n); } //ahead of many add_input calls
+		void reserve_outputs(const size_t n) { outputs.reserve(n); }
+		
 		void clear_inputs() { 
 			//cleaning up after all links before deleting them prevents iterator invalidation
+			if(inputs.size() == 0) return;
 			for(auto iter=inputs.begin(); iter!=inputs.end(); ++iter) walk(iter).outputs.clean_up(ID());
 			inputs.clear();
+			touch();
 		}
 		void clear_outputs() { //see clear_inputs
+			if(outputs.size() == 0) return;
 			for(auto iter=outputs.begin(); iter!=outputs.end(); ++iter) walk(iter).inputs.clean_up(ID());
 			outputs.clear();
+			touch();
 		}
 		void clear() { clear_inputs(); clear_outputs(); }
 		
@@ -0,0 +1,191 @@
+#ifndef BenoitDistance_h
+#define BenoitDistance_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace ben {
+/* Distance kernels for points stored as std::array<T,N>. Each metric is a struct with a term for
+ * one coordinate difference and a way to combine terms; Unroll applies it over all N coordinates
+ * with a fixed chain of inline calls, so there is no loop or indirect call left for the compiler
+ * to see through. All three accumulate in double, whatever T is.
+ *
+ * distances compares one query against many points at once, writing one result per point. When
+ * the compiler targets AVX2 (-mavx2 or -march=native) and T is double, it handles four points per
+ * instruction, with a scalar loop for the remainder; otherwise it calls the scalar kernel per
+ * point. The points must be contiguous, as in a std::vector of std::arrays. A second overload takes
+ * the points as N columns, one array per coordinate, as CoordinateArray stores them. That layout
+ * needs no shuffling: four points take one load per coordinate.
+ */
+	struct SquaredEuclidean {
+		static double term(const double difference) { return difference*difference; }
+		static double combine(const double sum, const double x) { return sum + x; }
+#ifdef __AVX2__
+		static __m256d term(const __m256d difference) { return _mm256_mul_pd(difference, difference); }
+		static __m256d combine(const __m256d sum, const __m256d x) { return _mm256_add_pd(sum, x); }
+#endif
+	}; //struct SquaredEuclidean
+
+	struct Manhattan {
+		static double term(const double difference) { return std::fabs(difference); }
+		static double combine(const double sum, const double x) { return sum + x; }
+#ifdef __AVX2__
+		static __m256d term(const __m256d difference)
+			{ return _mm256_andnot_pd(_mm256_set1_pd(-0.0), difference); } //clears the sign bit
+		static __m256d combine(const __m256d sum, const __m256d x) { return _mm256_add_pd(sum, x); }
+#endif
+	}; //struct Manhattan
+
+	struct Chebyshev {
+		static double term(const double difference) { return std::fabs(difference); }
+		static double combine(const double most, const double x) { return x > most ? x : most; }
+#ifdef __AVX2__
+		static __m256d term(const __m256d difference)
+			{ return _mm256_andnot_pd(_mm256_set1_pd(-0.0), difference); }
+		static __m256d combine(const __m256d most, const __m256d x) { return _mm256_max_pd(most, x); }
+#endif
+	}; //struct Chebyshev
+
+	template<size_t I, size_t N>
+	struct Unroll {
+		template<typename M, typename T>
+		static double apply(const T* a, const T* b, const double so_far) {
+			return Unroll<I+1, N>::template apply<M>(a, b,
+					M::combine(so_far, M::term(double(a[I]) - double(b[I]))));
+		}
+#ifdef __AVX2__
+		template<typename M>
+		static __m256d apply4(const std::array<double,N>* points, const __m256d* query, const __m256d so_far) {
+			__m256d coordinate = _mm256_set_pd(points[3][I], points[2][I], points[1][I], points[0][I]);
+			return Unroll<I+1, N>::template apply4<M>(points, query,
+					M::combine(so_far, M::term(_mm256_sub_pd(coordinate, query[I]))));
+		}
+#endif
+	}; //struct Unroll
+
+	template<size_t N>
+	struct Unroll<N,N> {
+		template<typename M, typename T>
+		static double apply(const T*, const T*, const double so_far) { return so_far; }
+#ifdef __AVX2__
+		template<typename M>
+		static __m256d apply4(const std::array<double,N>*, const __m256d*, const __m256d so_far) { return so_far; }
+#endif
+	}; //struct Unroll
+
+	template<typename M, typename T, size_t N> //size_t to match std::array, for deduction
+	double distance(const std::array<T,N>& a, const std::array<T,N>& b) {
+		return Unroll<0,N>::template apply<M>(a.data(), b.data(), 0.0);
+	}
+
+	template<typename T, size_t N>
+	double squared_distance(const std::array<T,N>& a, const std::array<T,N>& b)
+		{ return distance<SquaredEuclidean>(a, b); }
+	template<typename T, size_t N>
+	double manhattan_distance(const std::array<T,N>& a, const std::array<T,N>& b)
+		{ return distance<Manhattan>(a, b); }
+	template<typename T, size_t N>
+	double chebyshev_distance(const std::array<T,N>& a, const std::array<T,N>& b)
+		{ return distance<Chebyshev>(a, b); }
+
+	template<typename M, typename T, size_t N>
+	struct Batch {
+		static void apply(const std::array<T,N>& query, const std::array<T,N>* points,
+				  const size_t count, double* output) {
+			for(size_t i=0; i<count; ++i) output[i] = distance<M>(query, points[i]);
+		}
+	}; //struct Batch
+
+#ifdef __AVX2__
+	template<typename M, size_t N>
+	struct Batch<M, double, N> {
+		static void apply(const std::array<double,N>& query, const std::array<double,N>* points,
+				  const size_t count, double* output) {
+			__m256d broadcast[N];
+			for(size_t i=0; i<N; ++i) broadcast[i] = _mm256_set1_pd(query[i]);
+			size_t i = 0;
+			for(; i+4 <= count; i+=4)
+				_mm256_storeu_pd(output + i, Unroll<0,N>::template apply4<M>(points + i, broadcast, _mm256_setzero_pd()));
+			for(; i<count; ++i) output[i] = distance<M>(query, points[i]);
+		}
+	}; //struct Batch
+#endif
+
+	template<typename M, typename T, size_t N>
+	struct ColumnBatch {
+		static void apply(const std::array<T,N>& query, const std::array<const T*,N>& columns,
+				  const size_t count, double* output) {
+			for(size_t i=0; i<count; ++i) output[i] = 0.0;
+			for(size_t j=0; j<N; ++j) {
+				const T* column = columns[j];
+				const double x = double(query[j]);
+				for(size_t i=0; i<count; ++i) output[i] = M::combine(output[i], M::term(double(column[i]) - x));
+			}
+		}
+	}; //struct ColumnBatch
+
+#ifdef __AVX2__
+	template<typename M, size_t N>
+	struct ColumnBatch<M, double, N> {
+		static void apply(const std::array<double,N>& query, const std::array<const double*,N>& columns,
+				  const size_t count, double* output) {
+			size_t i = 0;
+			for(; i+4 <= count; i+=4) {
+				__m256d sum = _mm256_setzero_pd();
+				for(size_t j=0; j<N; ++j) {
+					__m256d difference = _mm256_sub_pd(_mm256_loadu_pd(columns[j] + i), _mm256_set1_pd(query[j]));
+					sum = M::combine(sum, M::term(difference));
+				}
+				_mm256_storeu_pd(output + i, sum);
+			}
+			for(; i<count; ++i) {
+				double sum = 0.0;
+				for(size_t j=0; j<N; ++j) sum = M::combine(sum, M::term(columns[j][i] - query[j]));
+				output[i] = sum;
+			}
+		}
+	}; //struct ColumnBatch
+#endif
+
+	template<typename M, typename T, size_t N>
+	void distances(const std::array<T,N>& query, const std::array<T,N>* points, const size_t count, double* output) {
+		//output[i] is the distance from query to points[i] by metric M
+		Batch<M,T,N>::apply(query, points, count, output);
+	}
+
+	template<typename M, typename T, size_t N>
+	void distances(const std::array<T,N>& query, const std::array<const T*,N>& columns, const size_t count, double* output) {
+		//output[i] is the distance from query to the point (columns[0][i], ..., columns[N-1][i])
+		ColumnBatch<M,T,N>::apply(query, columns, count, output);
+	}
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,275 @@
+#ifndef BenoitEdgeList_h
+#define BenoitEdgeList_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <future>
+#include <cstdlib>
+#include <cstring>
+#include "Graph.h"
+#include "CSR.h"
+#include "ThreadPool.h"
+
+namespace ben {
+/* EdgeListLoader builds a Graph from a text edge list without holding the file in memory. Two
+ * formats are understood:
+ *
+ * 	snap		"source target [value]" per line, '#' starts a comment line
+ * 	matrix_market	coordinate format: '%' comment lines, one "rows columns entries" line, then
+ * 			"row column [value]" per line; a "symmetric" header adds both directions
+ *
+ * IDs are taken from the file as they are (Matrix Market indices stay 1-based). The file is read
+ * in fixed-size chunks, the next chunk being read on another thread while the current one is
+ * parsed in parallel on a ThreadPool, so memory beyond the graph itself is two chunks plus the
+ * parsed links of one chunk. Links are then created in file order on the calling thread.
+ *
+ * Graph doesn't own nodes, so the loader asks the caller for them: make_node(graph, id) is called
+ * once for each new ID, and must construct a node with that ID in graph, in storage the caller
+ * owns, and return a reference to it. Path links take the value column, or 1 if there is none;
+ * Port links ignore it. Links that already exist are counted as duplicates and left alone, which
+ * also takes care of undirected edge lists that list every link both ways.
+ */
+	enum class EdgeFormat { snap, matrix_market };
+
+	struct EdgeRecord {
+		unsigned int source, target;
+		double value;
+		bool valued;
+	}; //struct EdgeRecord
+
+	inline bool parse_edge(const char* first, const char* last, EdgeRecord& edge, bool& malformed) {
+		//Parses one line, which must be followed by a newline or a null. Returns false for
+		//blank and comment lines, and also for malformed lines, which set malformed.
+		auto blank = [](const char c) { return c == ' ' or c == '\t' or c == '\r' or c == ','; };
+		auto digit = [](const char c) { return c >= '0' and c <= '9'; };
+		auto number = [&](unsigned int& x) {
+			while(first != last and blank(*first)) ++first;
+			if(first == last or !digit(*first)) return false;
+			x = 0;
+			while(first != last and digit(*first)) x = 10*x + unsigned(*first++ - '0');
+			return true;
+		};
+
+		malformed = false;
+		while(first != last and blank(*first)) ++first;
+		if(first == last or *first == '#' or *first == '%') return false;
+		if( !number(edge.source) or !number(edge.target) ) { malformed = true; return false; }
+		while(first != last and blank(*first)) ++first;
+		edge.valued = false;
+		if(first != last) {
+			char* end;
+			edge.value = std::strtod(first, &end);
+			if(end == first) { malformed = true; return false; }
+			edge.valued = true;
+		}
+		return true;
+	}
+
+	template<typename N>
+	class EdgeListLoader {
+	public:
+		typedef N node_type;
+		typedef Graph<N> graph_type;
+		typedef typename N::id_type id_type;
+
+	private:
+		typedef EdgeListLoader self_type;
+		typedef link_value<typename link_types<N>::output_type> value_traits;
+		typedef typename value_traits::type value_type;
+
+		ThreadPool* pool;
+		size_t chunk_bytes;
+		std::vector< std::vector<EdgeRecord> > parsed; //by worker, in file order
+		std::vector<size_t> bad_lines; //by worker
+		size_t link_count, node_count, malformed_count, duplicate_count;
+		bool header_pending, symmetric;
+
+		template<typename F>
+		bool apply(const EdgeRecord& edge, const std::shared_ptr<graph_type>& graph, F& make_node);
+		template<typename F>
+		bool line(const char* first, const char* last, const std::shared_ptr<graph_type>& graph, F& make_node);
+		template<typename F>
+		bool chunk(const char* first, const char* last, const std::shared_ptr<graph_type>& graph, F& make_node);
+
+	public:
+		EdgeListLoader() = delete;
+		explicit EdgeListLoader(ThreadPool& workers, const size_t chunk=(1 << 22))
+			: pool(&workers), chunk_bytes(chunk > 0 ? chunk : 1), parsed(workers.size()),
+			  bad_lines(workers.size(), 0), link_count(0), node_count(0), malformed_count(0),
+			  duplicate_count(0), header_pending(false), symmetric(false) {}
+		EdgeListLoader(const self_type& rhs) = delete;
+		self_type& operator=(const self_type& rhs) = delete;
+		~EdgeListLoader() = default;
+
+		template<typename F>
+		bool load(const std::string& filename, const std::shared_ptr<graph_type>& graph, F make_node,
+			  const EdgeFormat format=EdgeFormat::snap);
+
+		//counts from the last call to load
+		size_t links() const { return link_count; }
+		size_t nodes() const { return node_count; }
+		size_t malformed() const { return malformed_count; }
+		size_t duplicates() const { return duplicate_count; }
+	}; //class EdgeListLoader
+
+	template<typename N>
+	template<typename F>
+	bool EdgeListLoader<N>::load(const std::string& filename, const std::shared_ptr<graph_type>& graph,
+				     F make_node, const EdgeFormat format) {
+	//Returns false if the file couldn't be read, or if make_node returned a node that isn't in graph
+	//under the requested ID. Malformed lines are skipped and counted.
+		link_count = node_count = malformed_count = duplicate_count = 0;
+		header_pending = (format == EdgeFormat::matrix_market);
+		symmetric = false;
+		std::ifstream in(filename.c_str(), std::ios::binary);
+		if(!in) return false;
+
+		std::vector<char> buffers[2];
+		auto read = [&](std::vector<char>& buffer) -> size_t {
+			buffer.resize(chunk_bytes);
+			in.read(buffer.data(), chunk_bytes);
+			return in.gcount();
+		};
+
+		bool status = true;
+		std::string carry; //the unfinished line at the end of the last chunk
+		unsigned current = 0;
+		size_t length = read(buffers[current]);
+		while(length > 0 and status) {
+			auto next = std::async(std::launch::async, read, std::ref(buffers[1-current]));
+			const char* first = buffers[current].data();
+			const char* last = first + length;
+			const char* head = static_cast<const char*>( std::memchr(first, '\n', length) );
+			if(head == nullptr) carry.append(first, last); //a line longer than a chunk
+			else {
+				carry.append(first, head);
+				status = line(carry.data(), carry.data() + carry.size(), graph, make_node);
+				const char* tail = last;
+				while(*(tail-1) != '\n') --tail; //stops at head+1 at the latest
+				if(status) status = chunk(head+1, tail, graph, make_node);
+				carry.assign(tail, last);
+			}
+			length = next.get();
+			current = 1 - current;
+		}
+		if( status and !carry.empty() ) status = line(carry.data(), carry.data() + carry.size(), graph, make_node);
+		return status and !in.bad();
+	}
+
+	template<typename N>
+	template<typename F>
+	bool EdgeListLoader<N>::line(const char* first, const char* last, const std::shared_ptr<graph_type>& graph, F& make_node) {
+	//one line, on the calling thread; also consumes the Matrix Market header
+		if(header_pending) {
+			if(first != last and *first == '%') {
+				std::string banner(first, last);
+				if(banner.compare(0, 2, "%%") == 0 and banner.find("symmetric") != std::string::npos) symmetric = true;
+				return true;
+			}
+			EdgeRecord dimensions;
+			bool malformed;
+			if( parse_edge(first, last, dimensions, malformed) ) header_pending = false;
+			else if(malformed) ++malformed_count;
+			return true;
+		}
+		EdgeRecord edge;
+		bool malformed;
+		if( parse_edge(first, last, edge, malformed) ) return apply(edge, graph, make_node);
+		if(malformed) ++malformed_count;
+		return true;
+	}
+
+	template<typename N>
+	template<typename F>
+	bool EdgeListLoader<N>::chunk(const char* first, const char* last, const std::shared_ptr<graph_type>& graph, F& make_node) {
+	//[first, last) holds whole lines, each ending in a newline
+		while(header_pending and first != last) { //the header is parsed sequentially
+			const char* end = static_cast<const char*>( std::memchr(first, '\n', last - first) );
+			if( !line(first, end, graph, make_node) ) return false;
+			first = end + 1;
+		}
+		if(first == last) return true;
+
+		//split into one run of whole lines per worker and parse them in parallel
+		const unsigned workers = pool->size();
+		std::vector<const char*> bounds(workers + 1, last);
+		bounds[0] = first;
+		for(unsigned w=1; w<workers; ++w) {
+			const char* split = first + (last - first) * w / workers;
+			if(split < bounds[w-1]) split = bounds[w-1];
+			while(split != last and *(split-1) != '\n') ++split;
+			bounds[w] = split;
+		}
+		pool->parallel([&](const unsigned worker) {
+			auto& edges = parsed[worker];
+			edges.clear();
+			bad_lines[worker] = 0;
+			EdgeRecord edge;
+			bool malformed;
+			const char* begin = bounds[worker];
+			while(begin != bounds[worker+1]) {
+				const char* end = static_cast<const char*>( std::memchr(begin, '\n', bounds[worker+1] - begin) );
+				if( parse_edge(begin, end, edge, malformed) ) edges.push_back(edge);
+				else if(malformed) ++bad_lines[worker];
+				begin = end + 1;
+			}
+		});
+
+		for(unsigned w=0; w<workers; ++w) {
+			malformed_count += bad_lines[w];
+			for(auto& edge : parsed[w]) if( !apply(edge, graph, make_node) ) return false;
+		}
+		return true;
+	}
+
+	template<typename N>
+	template<typename F>
+	bool EdgeListLoader<N>::apply(const EdgeRecord& edge, const std::shared_ptr<graph_type>& graph, F& make_node) {
+		auto node_of = [&](const id_type address) -> node_type* {
+			auto iter = graph->find(address);
+			if( iter != graph->end() ) return &*iter;
+			node_type& node = make_node(graph, address);
+			++node_count;
+			if( node.ID() != address or node.get_index() != graph ) return nullptr;
+			return &node;
+		};
+
+		node_type* source = node_of(edge.source);
+		node_type* target = node_of(edge.target);
+		if(source == nullptr or target == nullptr) return false;
+		const value_type v = value_type(edge.valued ? edge.value : 1);
+		if( add_link(*source, edge.target, v) ) ++link_count;
+		else ++duplicate_count;
+		if(symmetric and link_types<N>::directed and edge.source != edge.target) {
+			if( add_link(*target, edge.source, v) ) ++link_count;
+			else ++duplicate_count;
+		}
+		return true;
+	}
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,185 @@
+#ifndef BenoitEpoch_h
+#define BenoitEpoch_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <limits>
+#include <cstdint>
+
+namespace ben {
+/* EpochDomain reclaims memory that lock-free readers might still be looking at, with quiescent-state
+ * based reclamation (the user-space flavor of RCU). A writer that replaces a shared structure
+ * publishes the new one and hands the old one to retire, which stamps it with a new epoch. Every
+ * thread that reads such structures concurrently with writers holds an EpochReader, and calls
+ * quiescent() now and then at a point where it holds no pointers into them, such as between two
+ * traversals. That copies the current epoch into the reader's own slot. Something retired in epoch
+ * E is freed once every reader's slot shows E or later, because each has let go of everything it
+ * read before then.
+ *
+ * Reading costs nothing: no locks, and no writes to memory another thread reads, except each
+ * reader's own slot at its quiescent points. A reader that stops reading for a while should go
+ * offline() so it doesn't hold up reclamation, and come back online() before it reads again.
+ * Threads that never read concurrently with writers don't need an EpochReader. retire tries to
+ * reclaim right away, so with no readers registered, it frees at once. synchronize waits for every
+ * online reader to pass a quiescent point, then reclaims everything retired so far.
+ *
+ * All Indexes share the domain returned by global(), so each thread registers once.
+ */
+	class EpochDomain {
+	public:
+		typedef uint64_t epoch_type;
+		static const epoch_type offline_epoch = std::numeric_limits<epoch_type>::max();
+
+		struct Record {
+			std::atomic<epoch_type> seen;
+			char padding[128 - sizeof(std::atomic<epoch_type>)]; //own cache line
+		};
+
+	private:
+		struct Retired {
+			epoch_type epoch;
+			void* object;
+			void (*destroy)(void*);
+		};
+
+		std::atomic<epoch_type> epoch;
+		std::mutex lock; //for readers and retired
+		std::vector<Record*> readers;
+		std::vector<Retired> retired;
+
+		epoch_type oldest() const {
+			//the earliest epoch an online reader might still be reading in
+			std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the one in EpochReader::online
+			epoch_type low = offline_epoch;
+			for(auto x : readers) {
+				epoch_type seen = x->seen.load(std::memory_order_acquire);
+				if(seen < low) low = seen;
+			}
+			return low;
+		}
+		size_t collect(const epoch_type low) {
+			size_t kept = 0;
+			for(auto& x : retired) {
+				if(x.epoch <= low) x.destroy(x.object);
+				else retired[kept++] = x;
+			}
+			retired.resize(kept);
+			return kept;
+		}
+
+	public:
+		EpochDomain() : epoch(1), lock(), readers(), retired() {}
+		EpochDomain(const EpochDomain& rhs) = delete;
+		EpochDomain& operator=(const EpochDomain& rhs) = delete;
+		~EpochDomain() { collect(offline_epoch); }
+
+		static EpochDomain& global() {
+			static EpochDomain domain;
+			return domain;
+		}
+
+		epoch_type current() const { return epoch.load(std::memory_order_acquire); }
+		Record* enter() {
+			Record* record = new Record;
+			std::lock_guard<std::mutex> guard(lock);
+			record->seen.store(current(), std::memory_order_release);
+			readers.push_back(record);
+			return record;
+		}
+		void leave(Record* record) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				for(size_t i=0; i<readers.size(); ++i) {
+					if(readers[i] == record) {
+						readers[i] = readers.back();
+						readers.pop_back();
+						break;
+					}
+				}
+			}
+			delete record;
+		}
+
+		template<typename T>
+		void retire(T* object) {
+			//call after object is unreachable for new readers; it is deleted once old ones are done
+			std::lock_guard<std::mutex> guard(lock);
+			epoch_type stamp = epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+			retired.push_back( Retired{stamp, object, [](void* x) { delete static_cast<T*>(x); }} );
+			collect( oldest() );
+		}
+		size_t reclaim() {
+			//frees what no reader can still see; returns how many retired objects remain
+			std::lock_guard<std::mutex> guard(lock);
+			return collect( oldest() );
+		}
+		void synchronize() {
+			//waits for every online reader to pass a quiescent point, then frees everything retired
+			epoch_type target = epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+			while(true) {
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if(oldest() >= target) {
+						collect(target);
+						return;
+					}
+				}
+				std::this_thread::yield();
+			}
+		}
+		size_t pending() {
+			std::lock_guard<std::mutex> guard(lock);
+			return retired.size();
+		}
+	}; //class EpochDomain
+
+	class EpochReader {
+	/*
+		Registers the constructing thread as a reader with an EpochDomain until destruction. Use
+		it from the thread that constructed it. Readers start online.
+	*/
+	private:
+		EpochDomain* domain;
+		EpochDomain::Record* record;
+
+	public:
+		explicit EpochReader(EpochDomain& owner=EpochDomain::global())
+			: domain(&owner), record(owner.enter()) {}
+		EpochReader(const EpochReader& rhs) = delete;
+		EpochReader& operator=(const EpochReader& rhs) = delete;
+		~EpochReader() { domain->leave(record); }
+
+		void quiescent() { record->seen.store(domain->current(), std::memory_order_release); }
+		void offline() { record->seen.store(EpochDomain::offline_epoch, std::memory_order_release); }
+		void online() {
+			record->seen.store(domain->current(), std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst); //before any read that follows
+		}
+	}; //class EpochReader
+
+} //namespace ben
+
+#endif
+
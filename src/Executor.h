@@ -0,0 +1,132 @@
+#ifndef BenoitExecutor_h
+#define BenoitExecutor_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "Graph.h"
+#include "ThreadPool.h"
+
+namespace ben {
+
+	template<typename N> class Partition;
+
+/* Executor runs a step function over every node of a Graph using a ThreadPool. Nodes are taken
+ * in Graph::ordering() and split into chunks; see ThreadPool::parallel_for for the partitioning
+ * and work stealing. Smaller chunks balance better, larger chunks have less overhead.
+ *
+ * The step function is called as step(node) and may run concurrently on different nodes. It must
+ * not add or remove nodes or links, but it may push and pull through Ports, set Path values and
+ * walk the graph. The Executor does not own the pool, so several Executors can share one.
+ *
+ * For feed-forward graphs of DirectedNodes, run_levels steps the nodes level by level (see 
+ * Graph::levels), so every node runs after all of its inputs, with each level in parallel. 
+ * run_pipelined overlaps a sequence of input batches across levels: in wave w, level l works on 
+ * batch w-l. Links are shared between batches, so a pipelined step should keep per-batch results 
+ * in its own storage, indexed by the batch number it is given. Nodes left out of the levels 
+ * because of cycles are not stepped. 
+ *
+ * run_partitions gives each Partition part to one worker (parts p, p+W, p+2W... go to worker p of W),
+ * with no stealing, so that a part's nodes stay in one core's cache. Pair it with 
+ * ThreadPool::pin_workers.
+ */
+	template<typename N>
+	class Executor {
+	public:
+		typedef N node_type;
+		typedef Graph<N> graph_type;
+
+	private:
+		typedef Executor self_type;
+		ThreadPool* pool;
+		size_t chunk_size;
+
+	public:
+		Executor() = delete;
+		explicit Executor(ThreadPool& workers, const size_t chunk=64)
+			: pool(&workers), chunk_size(chunk) {}
+		Executor(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~Executor() = default;
+
+		size_t get_chunk_size() const { return chunk_size; }
+		void set_chunk_size(const size_t chunk) { chunk_size = chunk; }
+
+		template<typename F>
+		void run(const graph_type& graph, F step) {
+			//one sweep over all nodes, returns when every node has been stepped
+			auto& nodes = graph.ordering();
+			pool->parallel_for(nodes.size(), chunk_size, [&](const size_t first, const size_t last) {
+				for(size_t i=first; i<last; ++i) step(*nodes[i]);
+			});
+		}
+		template<typename F>
+		void run(const std::shared_ptr<graph_type>& graph, F step) { run(*graph, step); }
+
+		template<typename F>
+		void run_partitions(const Partition<N>& partition, F step) {
+			const unsigned workers = pool->size();
+			pool->parallel([&](const unsigned worker) {
+				for(unsigned p=worker; p<partition.parts(); p+=workers)
+					for(auto iter=partition.begin(p); iter!=partition.end(p); ++iter) step(**iter);
+			});
+		}
+
+		template<typename F>
+		void run_levels(const graph_type& graph, F step) {
+			//step(node), inputs before outputs
+			for(auto& level : graph.levels()) {
+				pool->parallel_for(level.size(), chunk_size, [&](const size_t first, const size_t last) {
+					for(size_t i=first; i<last; ++i) step(*level[i]);
+				});
+			}
+		}
+		template<typename F>
+		void run_pipelined(const graph_type& graph, const size_t batches, F step) {
+			//step(node, batch) for every batch in [0,batches), respecting level order within a batch
+			auto& levels = graph.levels();
+			const size_t depth = levels.size();
+			if(depth == 0 or batches == 0) return;
+			std::vector<size_t> offsets, active; //flattened index space of the levels in this wave
+			for(size_t wave=0; wave < depth + batches - 1; ++wave) {
+				offsets.assign(1, 0);
+				active.clear();
+				for(size_t l = (wave < batches ? 0 : wave-batches+1); l < depth and l <= wave; ++l) {
+					active.push_back(l);
+					offsets.push_back(offsets.back() + levels[l].size());
+				}
+				pool->parallel_for(offsets.back(), chunk_size, [&](const size_t first, const size_t last) {
+					size_t k = std::upper_bound(offsets.begin(), offsets.end(), first) - offsets.begin() - 1;
+					for(size_t i=first; i<last; ++i) {
+						while(i >= offsets[k+1]) ++k;
+						step(*levels[active[k]][i - offsets[k]], wave - active[k]);
+					}
+				});
+			}
+		}
+	}; //class Executor
+
+} //namespace ben
+
+#endif
+
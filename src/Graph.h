@@ -22,26 +22,84 @@
 */
 
 #include <map>
+#include <vector>
+#include <atomic>
+#include <algorithm>
 #include <iostream>
 #include "Index.h"
+#include "Commons.h"
+#include "ChangeLog.h"
 
 namespace ben {
+
+	template<typename N> class GraphBatch;
+
 /* Graph is the manager of a distributed directed graph consisting of the Nodes and Links that connect
  * them. As an Index, it does not own the Nodes (or it would not be a distributed structure). 
  *
  * Nodes may not be connected between Indicies. When an individual Node is moved, all Links must be cleared from it. 
  * Indicies may be swapped or merged, in which cases the Links between Nodes are preserved. 
  *
- * See Index and IndexBase for more information. Graph adds very little to these base classes. 
+ * Index iterators are forward-only, so Graph also keeps an ordering of its nodes: a vector sorted 
+ * by ID, rebuilt lazily whenever membership changes. It is stable from run to run and random-access,
+ * which is what parallel code needs to split the nodes into ranges. ordering() is not thread-safe; 
+ * call it before handing the nodes out to other threads.
+ *
+ * Nodes report link changes to their Graph through links_changed(), which bumps a version counter.
+ * Structure derived from the links, like the topological levels of a DAG of DirectedNodes, is cached
+ * against that counter and recomputed on demand after any add, remove, mirror or clear. 
+ *
+ * enable_log attaches a ChangeLog, which records nodes joining and leaving and links changing, for
+ * consumers that update incrementally. It costs nothing while disabled. Link values are logged
+ * when they are set through a node's set_value; Path::set_value can't reach the Graph, so a value
+ * written straight to a Path goes unrecorded unless the writer calls value_changed as well. The
+ * log pointer isn't atomic: enable or disable the log only while no other thread is changing the
+ * Graph's nodes, links or link values.
+ *
+ * Graph is also a Commons. Single node methods don't lock it, but batch() returns a GraphBatch, 
+ * which applies many link changes under one write lock; readers holding a ScopedReadLock on the 
+ * Graph see all of a batch or none of it. batch() is defined in Batch.h.
+ *
+ * See Index and IndexBase for more information. 
  */	
 	template<typename N> 
-	class Graph : public Index<N> {
+	class Graph : public Index<N>, public Commons {
 	private:
 		typedef Index<N> base_type;
 
-		bool perform_add(Singleton* ptr) { return true; }
-		void perform_remove(Singleton* ptr) {} //clean-up of links is performed by the Node calling remove
-		bool perform_merge(base_type& other) { return true; } //no work necessary; links are left intact
+		mutable std::vector<N*> order;
+		mutable bool order_valid = false;
+		std::atomic<unsigned long> link_version{0};
+
+		mutable std::vector< std::vector<N*> > level_sets; 
+		mutable unsigned long level_version = 0;
+		mutable bool levels_valid = false, all_leveled = true;
+
+		std::shared_ptr<ChangeLog> log;
+
+		void invalidate() { order_valid = false; levels_valid = false; }
+		void record(const ChangeKind kind, const unsigned int source, const unsigned int target=0) 
+			{ if(log) log->record(kind, source, target); }
+		bool perform_add(Singleton* ptr) { 
+			invalidate(); 
+			record(ChangeKind::joined, ptr->ID());
+			return true; 
+		}
+		void perform_remove(Singleton* ptr) { //clean-up of links is performed by the Node calling remove
+			invalidate(); 
+			record(ChangeKind::left, ptr->ID());
+		} 
+		void perform_update(Singleton*) { invalidate(); }
+		bool perform_merge(base_type& other) { //no work necessary; links are left intact
+			invalidate();
+			Graph& donor = static_cast<Graph&>(other);
+			donor.invalidate(); //other is emptied by merge
+			for(auto& x : donor) {
+				donor.record(ChangeKind::left, x.ID());
+				record(ChangeKind::joined, x.ID());
+			}
+			return true; 
+		} 
 	
 	public:
 		typedef N 	node_type;
@@ -58,8 +116,89 @@ namespace ben {
 		Graph(Graph&& rhs) = delete;
 		Graph& operator=(Graph&& rhs) = delete;
 		~Graph() = default; 
+
+		const std::vector<node_type*>& ordering() const {
+			//all managed nodes, sorted by ID
+			if(!order_valid) {
+				order.clear();
+				order.reserve(this->size());
+				for(auto& x : *this) order.push_back(&x);
+				std::sort(order.begin(), order.end(), 
+					  [](const node_type* a, const node_type* b) { return a->ID() < b->ID(); });
+				order_valid = true;
+			}
+			return order;
+		}
+		size_type position(const id_type address) const {
+			//index of a node in ordering(), or ordering().size() if it isn't managed here
+			auto& nodes = ordering();
+			auto iter = std::lower_bound(nodes.begin(), nodes.end(), address, 
+						     [](const node_type* a, const id_type b) { return a->ID() < b; });
+			if(iter != nodes.end() and (*iter)->ID() == address) return iter - nodes.begin();
+			else return nodes.size();
+		}
+
+		void links_changed(const ChangeKind kind, const id_type source, const id_type target) { //called by nodes
+			link_version.fetch_add(1); 
+			record(kind, source, target);
+		} 
+		void value_changed(const id_type source, const id_type target) { //called by nodes' set_value
+			record(ChangeKind::value_changed, source, target);
+		}
+		unsigned long get_link_version() const { return link_version.load(); }
+
+		//not thread-safe: call only while no other thread changes nodes, links or link values
+		void enable_log(const size_t capacity=(1 << 16)) { if(!log) log = std::make_shared<ChangeLog>(capacity); }
+		void disable_log() { log.reset(); }
+		std::shared_ptr<ChangeLog> get_log() const { return log; } //empty unless enabled
+
+		const std::vector< std::vector<node_type*> >& levels() const;
+		bool acyclic() const { levels(); return all_leveled; }
+
+		GraphBatch<N> batch();
 	}; //class Graph
 
+	template<typename N>
+	const std::vector< std::vector<N*> >& Graph<N>::levels() const {
+		//Topological levels for DAGs of DirectedNodes: level 0 holds nodes with no inputs, and 
+		//every other node sits one level below its deepest input. Nodes on a cycle, or downstream 
+		//of one, are left out and acyclic() returns false. Not thread-safe, like ordering(). 
+		unsigned long version = get_link_version();
+		if(levels_valid and level_version == version) return level_sets;
+
+		auto& nodes = ordering();
+		std::vector<size_type> waiting(nodes.size());
+		std::vector<size_type> frontier, next;
+		for(size_type i=0; i<nodes.size(); ++i) {
+			waiting[i] = nodes[i]->inputs.size();
+			if(waiting[i] == 0) frontier.push_back(i);
+		}
+
+		level_sets.clear();
+		size_type leveled = 0;
+		while( !frontier.empty() ) {
+			level_sets.push_back( std::vector<node_type*>() );
+			auto& current = level_sets.back();
+			current.reserve(frontier.size());
+			next.clear();
+			for(size_type i : frontier) {
+				current.push_back(nodes[i]);
+				for(auto& x : nodes[i]->outputs) {
+					size_type j = position(x.get_address());
+					if(--waiting[j] == 0) next.push_back(j);
+				}
+			}
+			leveled += frontier.size();
+			std::sort(next.begin(), next.end()); //keeps each level in ID order
+			frontier.swap(next);
+		}
+
+		all_leveled = (leveled == nodes.size());
+		level_version = version;
+		levels_valid = true;
+		return level_sets;
+	}
+
 } //namespace ben
 
 #endif
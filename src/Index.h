@@ -41,6 +41,11 @@ namespace ben {
  * allowed, although moves are. 
  *
  * Because IndexBase is now based on std::unordered_map, only forward iterators are provided.
+ *
+ * find and elem go through IndexBase's lock-free lookup table, so traversal threads can call them
+ * while other threads add or remove Singletons, as long as each holds an EpochReader (see
+ * IndexBase). An iterator from find points at its Singleton without a place in the map; the first
+ * increment looks that place up, which is not safe against concurrent writers.
  */
 
 	//Singleton forward declares this
@@ -59,6 +64,10 @@ namespace ben {
 		using base_type::index; //hiding this field
 		using base_type::add;
 		using base_type::remove;
+		using base_type::lookup;
+		using base_type::publish;
+		using base_type::withdraw;
+		using base_type::writing;
 
 		template<typename T>
 		friend bool merge(std::shared_ptr<T> one, std::shared_ptr<T> two);
@@ -76,17 +85,16 @@ namespace ben {
 	
 		iterator find(const id_type address) const { 
 		//this is ok as const because Index does not own the Singletons is manages
-			return iterator( index.find(address) ); 
+			return iterator( &index, lookup(address) ); 
 		}
 		singleton_type& elem(const id_type address) const {
 		//throw an exception if address does not exist?
 		//this is not safe to use unless you already know that address exists in this index
-			auto iter = index.find(address);
-			return *static_cast<singleton_type*>(iter->second);
+			return *static_cast<singleton_type*>( lookup(address) );
 		}
 		
-		iterator begin() const { return iterator( index.begin() ); }
-		iterator end() const { return iterator( index.end() ); }
+		iterator begin() const { return iterator( &index, index.begin() ); }
+		iterator end() const { return iterator( &index, nullptr ); }
 	}; //class Index
 	
 	
@@ -96,32 +104,42 @@ namespace ben {
 	template<typename S>
 	class Index<S>::iterator : public std::iterator<std::forward_iterator_tag, singleton_type> {
 	protected:
-		typename map_type::iterator current;
+		const map_type* owner;
+		typename map_type::iterator current; //owner->end() if not placed yet, as from find
+		Singleton* ptr; //null at the end
 		friend class Index;
 		friend std::ostream& operator<< <S>(std::ostream& out, const iterator& iter);
-		iterator(const typename map_type::iterator iter)
-			: current(iter) {}
+		iterator(const map_type* map, const typename map_type::iterator iter)
+			: owner(map), current(iter), ptr(iter != map->end() ? iter->second : nullptr) {}
+		iterator(const map_type* map, Singleton* found)
+			: owner(map), current(const_cast<map_type*>(map)->end()), ptr(found) {}
 			
 	public:
-		iterator() = default;
+		iterator() : owner(nullptr), current(), ptr(nullptr) {}
 		iterator(const iterator& rhs) = default;
 		iterator& operator=(const iterator& rhs) = default;
 		~iterator() = default;
 		
 		singleton_type& operator*() const 
-			{ return *static_cast<singleton_type*>(current->second); } 
+			{ return *static_cast<singleton_type*>(ptr); } 
 		singleton_type* operator->() const 
-			{ return static_cast<singleton_type*>(current->second); }
+			{ return static_cast<singleton_type*>(ptr); }
 		
-		iterator& operator++() { ++current; return *this; }
-		iterator  operator++(int) { 
-			auto temp = current;
+		iterator& operator++() { 
+			map_type& map = *const_cast<map_type*>(owner);
+			if(current == map.end()) current = map.find(ptr->ID());
 			++current;
+			ptr = current != map.end() ? current->second : nullptr;
+			return *this; 
+		}
+		iterator  operator++(int) { 
+			auto temp = *this;
+			++(*this);
 			return temp;
 		}
 		
 		bool operator==(const iterator& rhs) const
-			{ return current==rhs.current; }
+			{ return owner==rhs.owner and ptr==rhs.ptr; }
 		bool operator!=(const iterator& rhs) const
 			{ return !( (*this) == rhs ); }
 	}; //class iterator
@@ -143,7 +161,9 @@ namespace ben {
 		static_assert(std::is_base_of<Index<singleton_type>, T>::value,
 				"Only Index-derived classes can be used");
 
-		if(two == one) return false; //redundant, but clear
+		if(two == one) return false; //redundant, but clear, and locking both would deadlock
+		std::lock(one->writing, two->writing);
+		std::lock_guard<std::mutex> one_lock(one->writing, std::adopt_lock), two_lock(two->writing, std::adopt_lock);
 		if(two->size() == 0) return true; 
 		for(auto x : two->index) if( one->manages(x.first) ) return false;
 	
@@ -161,8 +181,13 @@ namespace ben {
 		bool status = std::static_pointer_cast< Index<singleton_type> >(one)->perform_merge(*two);
 	
 		it = two->index.begin();
-		if(status) two->index.erase(it, ite); //finish merge
-		else {
+		if(status) { //finish merge
+			for(auto x : two->index) {
+				one->publish(x.first, x.second);
+				two->withdraw(x.first);
+			}
+			two->index.erase(it, ite);
+		} else {
 			//reverse merge
 			while(it != ite) {
 				one->index.erase(it->first);
@@ -25,13 +25,74 @@
 //#include "Singleton.h"
 
 namespace ben {
+
+	IndexBase::Table::Table(const size_t capacity) 
+		: mask(capacity - 1), used(0), slots(new Slot[capacity]) {
+		for(size_t i=0; i<capacity; ++i) {
+			slots[i].key.store(empty, std::memory_order_relaxed);
+			slots[i].value.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	void IndexBase::publish(const id_type address, Singleton* ptr) {
+	//points address at ptr in the lookup table, growing it first if it's too full
+		Table* current = table.load(std::memory_order_relaxed);
+		size_t i = current->start(address);
+		for(uint64_t key; (key = current->slots[i].key.load(std::memory_order_relaxed)) != Table::empty; i=(i+1) & current->mask) {
+			if(key == address) {
+				current->slots[i].value.store(ptr, std::memory_order_release);
+				return;
+			}
+		}
+		if(4*(current->used + 1) > 3*(current->mask + 1)) {
+			//rebuild without the removed keys, at most half full
+			size_t live = 0;
+			for(size_t j=0; j<=current->mask; ++j) if(current->slots[j].value.load(std::memory_order_relaxed)) ++live;
+			size_t capacity = 16;
+			while(capacity < 2*(live + 1)) capacity *= 2;
+			Table* next = new Table(capacity);
+			for(size_t j=0; j<=current->mask; ++j) {
+				Singleton* x = current->slots[j].value.load(std::memory_order_relaxed);
+				if(!x) continue;
+				uint64_t key = current->slots[j].key.load(std::memory_order_relaxed);
+				size_t k = next->start(key);
+				while(next->slots[k].key.load(std::memory_order_relaxed) != Table::empty) k = (k+1) & next->mask;
+				next->slots[k].key.store(key, std::memory_order_relaxed);
+				next->slots[k].value.store(x, std::memory_order_relaxed);
+				++next->used;
+			}
+			table.store(next, std::memory_order_release);
+			EpochDomain::global().retire(current);
+			current = next;
+			i = current->start(address);
+			while(current->slots[i].key.load(std::memory_order_relaxed) != Table::empty) i = (i+1) & current->mask;
+		}
+		current->slots[i].value.store(ptr, std::memory_order_relaxed);
+		current->slots[i].key.store(address, std::memory_order_release); //readers see the value with it
+		++current->used;
+	}
+
+	void IndexBase::withdraw(const id_type address) {
+		Table* current = table.load(std::memory_order_relaxed);
+		for(size_t i=current->start(address); ; i=(i+1) & current->mask) {
+			uint64_t key = current->slots[i].key.load(std::memory_order_relaxed);
+			if(key == Table::empty) return;
+			if(key == address) {
+				current->slots[i].value.store(nullptr, std::memory_order_release);
+				return;
+			}
+		}
+	}
 	
 	bool IndexBase::update_singleton(Singleton* ptr) {
 	//updates the tracking for the indicated Singleton
 	//returns false if no Singleton with this ID is currently being tracked, true otherwise
+		std::lock_guard<std::mutex> lock(writing);
 		auto iter = index.find(ptr->ID());
 		if(iter != index.end()) { 
 			iter->second = ptr;
+			publish(ptr->ID(), ptr);
+			perform_update(ptr);
 			return true;
 		} else return false;
 	}
@@ -40,10 +101,12 @@ namespace ben {
 	//begins tracking referent of ptr
 	//returns false if this Index is already tracking a Singleton with ptr's ID, true otherwise
 	//only called by Singleton, internally
+		std::lock_guard<std::mutex> lock(writing);
 		auto insert_status = index.insert(std::make_pair(ptr->ID(), ptr));
 		if( insert_status.second ) {
 			bool delegate_status = perform_add(ptr); 
-			if(!delegate_status) index.erase(insert_status.first);
+			if(delegate_status) publish(ptr->ID(), ptr);
+			else index.erase(insert_status.first);
 			return delegate_status;
 		} return false;
 	}
@@ -51,9 +114,11 @@ namespace ben {
 	void IndexBase::remove(const id_type address) {
 	//stops tracking Singleton with ID=address, 
 	//only called by Singleton, internally
+		std::lock_guard<std::mutex> lock(writing);
 		auto iter = index.find(address);
 		if( iter != index.end() ) {
 			perform_remove(iter->second); 
+			withdraw(address);
 			index.erase(iter);
 		} 
 	}
@@ -61,6 +126,7 @@ namespace ben {
 	IndexBase::~IndexBase() { //should never be called while any Singletons are still managed
 		//but for safety's sake...
 		for(auto x : index) x.second->update_index(std::shared_ptr<self_type>()); 
+		delete table.load();
 	}
 
 } //namespace ben
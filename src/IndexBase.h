@@ -23,6 +23,10 @@
 
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "Epoch.h"
 //#include "Commons.h"
 
 namespace ben {
@@ -33,34 +37,64 @@ namespace ben {
  * class template should inherit from it. IndexBase encapsulates a map to match IDs to Singleton pointers,
  * like a directory. Like all of the high-level objects in Benoit, IndexBase has identity semantics and 
  * cannot be copied. Inheriting from Commons provides readers/writer locking.
+ *
+ * Lookups by ID (manages, check, and Index::find and elem) don't use the map. They probe a separate
+ * open-addressing table of IDs and pointers, published through an atomic pointer, so they never
+ * lock or write to shared memory and can run while other threads add and remove Singletons.
+ * Writers take turns on a mutex and change the table in place. A new ID goes into an empty slot,
+ * with its key written last. A removal clears the pointer but leaves the key. A move swaps the
+ * pointer. When the table gets too full, a writer builds a bigger one without the removed keys and
+ * publishes it. The old one goes to the global EpochDomain and is freed once every reader has passed
+ * a quiescent point. Threads that look up concurrently with writers must hold an EpochReader and
+ * call its quiescent() between lookups, at points where they no longer use a pointer they found.
+ * That only protects the table; a Singleton that was found is still freed whenever its owner frees
+ * it, so readers should only use the ones they know to be alive.
+ * Iteration, size and merging still use the map, and are not safe against concurrent writers.
  */
 	class IndexBase {
 	public: 
 		typedef unsigned int id_type;
 		friend class Singleton;
 	
-		bool manages(const id_type address) const { return index.count(address) == 1; }
+		bool manages(const id_type address) const { return lookup(address) != nullptr; }
 		size_t size() const { return index.size(); }
 		bool check(const id_type address, const Singleton* local_ptr) const {
 		//verifies correct tracking of Singleton
-			auto iter = index.find(address);
-			if(iter != index.end()) return iter->second == local_ptr;
-			else return false;
+			Singleton* ptr = lookup(address);
+			return ptr != nullptr and ptr == local_ptr;
 		}
 
 	private:
 		typedef IndexBase self_type;
 
+		struct Table {
+			struct Slot {
+				std::atomic<uint64_t> key; //an id_type, or empty
+				std::atomic<Singleton*> value; //null once removed
+			};
+			static const uint64_t empty = ~uint64_t(0);
+			size_t mask; //capacity - 1
+			size_t used; //slots with a key, for the writer
+			std::unique_ptr<Slot[]> slots;
+
+			explicit Table(const size_t capacity);
+			size_t start(const id_type address) const { return (uint64_t(address) * 0x9e3779b97f4a7c15ull >> 32) & mask; }
+		};
+		std::atomic<Table*> table; //the version readers see
+
 		//these functions perform custom operations on derived data structure
 		//for context, see the exposed add, remove, and merge_into methods
 		//return true if successful, roll back and return false if not
+		//they run with writing locked, which isn't recursive, so they must not call add, remove,
+		//or merge on this Index
 		virtual bool perform_add(Singleton* ptr) = 0; //make these members of Index instead?
 		virtual void perform_remove(Singleton* ptr) = 0;
+		virtual void perform_update(Singleton*) {} //a tracked Singleton has moved to a new address
 
 		bool update_singleton(Singleton* ptr);
 
 	protected:
-		IndexBase() = default;
+		IndexBase() : table(new Table(16)), writing(), index() {}
 		IndexBase(const self_type& rhs) = delete;
 		IndexBase(self_type&& rhs) = delete;
 		self_type& operator=(const self_type& rhs) = delete;
@@ -68,10 +102,22 @@ namespace ben {
 		virtual ~IndexBase();
  
 		typedef std::unordered_map<id_type, Singleton*> map_type;
+		std::mutex writing; //one writer at a time
 		mutable map_type index;
 		
 		bool add(Singleton* ptr); 
 		void remove(const id_type address);
+		void publish(const id_type address, Singleton* ptr); //for the lookup table only, with writing locked
+		void withdraw(const id_type address);
+		Singleton* lookup(const id_type address) const {
+			//lock-free; null if address isn't tracked here
+			const Table* current = table.load(std::memory_order_acquire);
+			for(size_t i=current->start(address); ; i=(i+1) & current->mask) {
+				uint64_t key = current->slots[i].key.load(std::memory_order_acquire);
+				if(key == address) return current->slots[i].value.load(std::memory_order_acquire);
+				if(key == Table::empty) return nullptr;
+			}
+		}
 	}; //class IndexBase	
 
 } //namespace ben
@@ -0,0 +1,301 @@
+#ifndef BenoitKDTree_h
+#define BenoitKDTree_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "SpatialIndex.h"
+
+namespace ben {
+/* KDTree is the default SpatialIndex of a Space. Internal nodes split on the coordinate with the
+ * widest spread, at the median, and leaves hold up to about leaf_size points in a bucket. A bulk
+ * build takes O(n log n). Inserts go down to a leaf, and a leaf that grows to twice leaf_size is
+ * split into a subtree of its own. A hash map from ID to leaf makes removals O(leaf_size). A move
+ * that stays within its leaf's cell updates the point in place, and any other move is a removal
+ * and an insert. The tree is rebuilt from scratch when an insert lands deeper than about twice
+ * the balanced depth, or once the changes since the last build outnumber the points it started
+ * with, so its depth stays logarithmic and every change costs O(log n) amortized.
+ *
+ * Range and radius queries prune on the splitting planes. nearest is a depth-first search that
+ * visits the near side of each split first, keeping the k best candidates in the caller's array.
+ */
+	template<typename T, unsigned short N>
+	class KDTree : public SpatialIndex<T,N> {
+	private:
+		typedef SpatialIndex<T,N> base_type;
+		typedef KDTree self_type;
+
+	public:
+		typedef typename base_type::point_type point_type;
+		typedef typename base_type::id_type id_type;
+		typedef typename base_type::region_type region_type;
+
+	private:
+		struct Entry {
+			id_type id;
+			point_type point;
+		};
+		struct KDNode {
+			unsigned short axis; //N for leaves
+			T split; //the left subtree holds coordinates <= split, the right >= split
+			uint32_t left, right, bucket;
+		};
+
+		std::vector<KDNode> nodes; //nodes[0] is the root
+		std::vector< std::vector<Entry> > buckets;
+		std::unordered_map<id_type, uint32_t> leaf_of;
+		size_t leaf_size, built_size, changes;
+
+		uint32_t make_leaf(typename std::vector<Entry>::iterator first, typename std::vector<Entry>::iterator last) {
+			uint32_t index = nodes.size();
+			nodes.push_back( KDNode{N, T(), 0, 0, uint32_t(buckets.size())} );
+			buckets.emplace_back(first, last);
+			for(auto iter=first; iter!=last; ++iter) leaf_of[iter->id] = index;
+			return index;
+		}
+		uint32_t build_range(std::vector<Entry>& entries, const size_t first, const size_t last);
+		void split_leaf(const uint32_t leaf);
+		void rebuild();
+		void changed() { if(++changes > std::max(built_size, 4*leaf_size)) rebuild(); }
+		uint32_t leaf_for(const point_type& point, size_t& depth) const {
+			uint32_t node = 0;
+			depth = 0;
+			while(nodes[node].axis != N) {
+				node = point[nodes[node].axis] < nodes[node].split ? nodes[node].left : nodes[node].right;
+				++depth;
+			}
+			return node;
+		}
+		size_t depth_limit() const {
+			size_t depth = 4, leaves = leaf_of.size() / leaf_size;
+			while(leaves > 0) { depth += 2; leaves >>= 1; }
+			return depth;
+		}
+
+		void region_from(const uint32_t node, const region_type& region, std::vector<id_type>& output) const;
+		void within_from(const uint32_t node, const point_type& center, const double radius,
+				 std::vector<id_type>& output) const;
+		void nearest_from(const uint32_t node, const point_type& center, const size_t k,
+				  Neighbor* heap, size_t& count) const;
+
+	public:
+		explicit KDTree(const size_t bucket_size=16)
+			: leaf_size(bucket_size > 0 ? bucket_size : 1), built_size(0), changes(0) { clear(); }
+		KDTree(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~KDTree() = default;
+
+		void build(const std::vector< std::pair<id_type, point_type> >& points);
+		bool insert(const id_type address, const point_type& point);
+		bool remove(const id_type address);
+		bool move(const id_type address, const point_type& point);
+		void clear() {
+			nodes.clear();
+			buckets.clear();
+			leaf_of.clear();
+			nodes.push_back( KDNode{N, T(), 0, 0, 0} );
+			buckets.emplace_back();
+			built_size = changes = 0;
+		}
+		size_t size() const { return leaf_of.size(); }
+		size_t depth() const { //of the deepest leaf
+			size_t deepest = 0;
+			std::vector< std::pair<uint32_t, size_t> > stack(1, std::make_pair(0u, size_t(0)));
+			while( !stack.empty() ) {
+				auto x = stack.back();
+				stack.pop_back();
+				deepest = std::max(deepest, x.second);
+				if(nodes[x.first].axis != N) {
+					stack.push_back( std::make_pair(nodes[x.first].left, x.second + 1) );
+					stack.push_back( std::make_pair(nodes[x.first].right, x.second + 1) );
+				}
+			}
+			return deepest;
+		}
+
+		void in_region(const region_type& region, std::vector<id_type>& output) const { region_from(0, region, output); }
+		void within(const point_type& center, const double radius, std::vector<id_type>& output) const {
+			if(radius >= 0.0) within_from(0, center, radius, output);
+		}
+		size_t nearest(const point_type& center, const size_t k, Neighbor* output) const {
+			size_t count = 0;
+			if(k > 0) nearest_from(0, center, k, output, count);
+			return base_type::finish(output, count);
+		}
+	}; //class KDTree
+
+	template<typename T, unsigned short N>
+	uint32_t KDTree<T,N>::build_range(std::vector<Entry>& entries, const size_t first, const size_t last) {
+		auto begin = entries.begin();
+		if(last - first <= leaf_size) return make_leaf(begin + first, begin + last);
+		unsigned short axis = 0;
+		T widest = T();
+		for(unsigned short i=0; i<N; ++i) {
+			auto bounds = std::minmax_element(begin + first, begin + last,
+				[i](const Entry& a, const Entry& b) { return a.point[i] < b.point[i]; });
+			T spread = bounds.second->point[i] - bounds.first->point[i];
+			if(i == 0 or spread > widest) { axis = i; widest = spread; }
+		}
+		if( !(widest > T()) ) return make_leaf(begin + first, begin + last); //all the same point
+
+		const size_t middle = first + (last - first)/2;
+		std::nth_element(begin + first, begin + middle, begin + last,
+			[axis](const Entry& a, const Entry& b) { return a.point[axis] < b.point[axis]; });
+		uint32_t index = nodes.size();
+		nodes.push_back( KDNode{axis, entries[middle].point[axis], 0, 0, 0} );
+		uint32_t left = build_range(entries, first, middle);
+		uint32_t right = build_range(entries, middle, last);
+		nodes[index].left = left;
+		nodes[index].right = right;
+		return index;
+	}
+
+	template<typename T, unsigned short N>
+	void KDTree<T,N>::build(const std::vector< std::pair<id_type, point_type> >& points) {
+		//later duplicates of an ID are dropped
+		std::vector<Entry> entries;
+		entries.reserve(points.size());
+		std::unordered_map<id_type, bool> seen;
+		seen.reserve(points.size());
+		for(auto& x : points) if( seen.insert(std::make_pair(x.first, true)).second ) entries.push_back( Entry{x.first, x.second} );
+		nodes.clear();
+		buckets.clear();
+		leaf_of.clear();
+		leaf_of.reserve(entries.size());
+		build_range(entries, 0, entries.size());
+		built_size = entries.size();
+		changes = 0;
+	}
+
+	template<typename T, unsigned short N>
+	void KDTree<T,N>::rebuild() {
+		std::vector< std::pair<id_type, point_type> > points;
+		points.reserve(size());
+		for(auto& bucket : buckets) for(auto& x : bucket) points.push_back( std::make_pair(x.id, x.point) );
+		build(points);
+	}
+
+	template<typename T, unsigned short N>
+	void KDTree<T,N>::split_leaf(const uint32_t leaf) {
+		//builds a subtree from the leaf's bucket and puts its root in the leaf's place
+		std::vector<Entry> entries;
+		entries.swap(buckets[ nodes[leaf].bucket ]);
+		uint32_t root = build_range(entries, 0, entries.size());
+		if(nodes[root].axis == N) { //couldn't split; undo
+			buckets[ nodes[leaf].bucket ].swap( buckets[nodes[root].bucket] );
+			for(auto& x : buckets[ nodes[leaf].bucket ]) leaf_of[x.id] = leaf;
+			buckets.pop_back();
+			nodes.pop_back();
+		} else nodes[leaf] = nodes[root]; //the copy left at root is unreachable until the next rebuild
+	}
+
+	template<typename T, unsigned short N>
+	bool KDTree<T,N>::insert(const id_type address, const point_type& point) {
+		if(leaf_of.count(address) > 0) return false;
+		size_t depth;
+		uint32_t leaf = leaf_for(point, depth);
+		auto& bucket = buckets[ nodes[leaf].bucket ];
+		bucket.push_back( Entry{address, point} );
+		leaf_of[address] = leaf;
+		if(depth > depth_limit()) rebuild();
+		else {
+			if(bucket.size() >= 2*leaf_size) split_leaf(leaf);
+			changed();
+		}
+		return true;
+	}
+
+	template<typename T, unsigned short N>
+	bool KDTree<T,N>::remove(const id_type address) {
+		auto iter = leaf_of.find(address);
+		if(iter == leaf_of.end()) return false;
+		auto& bucket = buckets[ nodes[iter->second].bucket ];
+		for(auto& x : bucket) {
+			if(x.id == address) {
+				x = bucket.back();
+				bucket.pop_back();
+				break;
+			}
+		}
+		leaf_of.erase(iter);
+		changed();
+		return true;
+	}
+
+	template<typename T, unsigned short N>
+	bool KDTree<T,N>::move(const id_type address, const point_type& point) {
+		auto iter = leaf_of.find(address);
+		if(iter == leaf_of.end()) return false;
+		size_t depth;
+		if(leaf_for(point, depth) == iter->second) {
+			for(auto& x : buckets[ nodes[iter->second].bucket ]) if(x.id == address) x.point = point;
+			return true;
+		}
+		remove(address);
+		return insert(address, point);
+	}
+
+	template<typename T, unsigned short N>
+	void KDTree<T,N>::region_from(const uint32_t node, const region_type& region, std::vector<id_type>& output) const {
+		const KDNode& x = nodes[node];
+		if(x.axis == N) {
+			for(auto& y : buckets[x.bucket]) if( region.contains(y.point) ) output.push_back(y.id);
+			return;
+		}
+		if( !(region.lower[x.axis] > x.split) ) region_from(x.left, region, output);
+		if( !(region.upper[x.axis] < x.split) ) region_from(x.right, region, output);
+	}
+
+	template<typename T, unsigned short N>
+	void KDTree<T,N>::within_from(const uint32_t node, const point_type& center, const double radius,
+				      std::vector<id_type>& output) const {
+		const KDNode& x = nodes[node];
+		if(x.axis == N) {
+			for(auto& y : buckets[x.bucket])
+				if(squared_distance(center, y.point) <= radius*radius) output.push_back(y.id);
+			return;
+		}
+		const double offset = double(center[x.axis]) - double(x.split);
+		if(offset <= radius) within_from(x.left, center, radius, output);
+		if(offset >= -radius) within_from(x.right, center, radius, output);
+	}
+
+	template<typename T, unsigned short N>
+	void KDTree<T,N>::nearest_from(const uint32_t node, const point_type& center, const size_t k,
+				       Neighbor* heap, size_t& count) const {
+		const KDNode& x = nodes[node];
+		if(x.axis == N) {
+			for(auto& y : buckets[x.bucket]) base_type::offer(heap, count, k, y.id, squared_distance(center, y.point));
+			return;
+		}
+		const double offset = double(center[x.axis]) - double(x.split);
+		nearest_from(offset < 0.0 ? x.left : x.right, center, k, heap, count);
+		if(count < k or offset*offset <= heap[0].distance)
+			nearest_from(offset < 0.0 ? x.right : x.left, center, k, heap, count);
+	}
+
+} //namespace ben
+
+#endif
+
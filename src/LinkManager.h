@@ -22,6 +22,7 @@
 */
 
 #include <vector>
+#include <algorithm>
 #include <cassert>
 #include "Traits.h"
 
@@ -30,6 +31,10 @@ namespace ben {
 	//this struct allows LinkManagerHelper to friend the node type that uses it
 	template<typename T> struct type_wrapper { typedef T type; };
 
+	//the one other friend of LinkManager and the node types, for bulk algorithms that build
+	//links a side at a time (see Clone.h)
+	struct LinkAccess;
+
 	template<typename N, typename P, typename... ARGS>
 	class LinkManagerHelper {
 		//Don't let this compile! Only the specialization taking a ConstructionTypes struct
@@ -63,6 +68,7 @@ namespace ben {
 	private:
 		friend class LinkManagerHelper<N, link_complement_type, ConstructionTypes<ARGS...> >; //for noncircular calls to add/remove
 		friend class type_wrapper<N>::type; //allow the owning node access to private methods
+		friend struct LinkAccess;
 		std::vector<link_type> links; 
 		id_type nodeID; //needed to initialize complement Ports, public because LinkManager is internal to Node
 
@@ -79,6 +85,7 @@ namespace ben {
 				nodeID = rhs.nodeID;
 				links = std::move(rhs.links);
 			}
+			return *this;
 		} 
 
 		bool add(complement_type& other, const ARGS... args) {
@@ -136,6 +143,17 @@ namespace ben {
 			auto iter = find(address);
 			if(iter != end()) links.erase(iter);
 		}
+		template<typename F>
+		size_t clean_up_if(F pred) {
+			//removes every link whose address satisfies pred, in one pass and independently
+			//of the complements; returns the number removed
+			auto iter = std::remove_if(links.begin(), links.end(), 
+						   [&](const link_type& x) { return pred(x.get_address()); });
+			size_t removed = links.end() - iter;
+			links.erase(iter, links.end());
+			return removed;
+		}
+		void reserve(const size_t n) { links.reserve(n); }
 		void clear() { links.clear(); } //does not clean up after links!
 
 	public:
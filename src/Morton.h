@@ -0,0 +1,459 @@
+#ifndef BenoitMorton_h
+#define BenoitMorton_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include "SpatialIndex.h"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace ben {
+/* A Morton code (or Z-order code) interleaves the bits of a point's integer coordinates: bit j of
+ * coordinate i becomes bit j*N + i of the code. Sorting points by code puts them along a Z-shaped
+ * curve that stays close to itself, so points that are near each other in space are mostly near
+ * each other in the sorted order, and any box is covered by a few runs of consecutive codes.
+ *
+ * Morton<N> holds the kernels: spread scatters a coordinate's bits N places apart, encode combines
+ * N coordinates, and bigmin (Tropf and Herzog, 1981) finds the next code after a given one that
+ * falls inside a box, so a scan over sorted codes can jump the gaps between runs. Each coordinate
+ * gets 64/N bits, at most 32. Two and three dimensions use shift-and-mask spreading; others use
+ * the BMI2 pdep instruction where the compiler allows it, or a loop over the bits.
+ */
+	template<unsigned short N>
+	struct Morton {
+		static_assert(N > 0 and N <= 32, "Morton codes need at least two bits per coordinate");
+		static const unsigned short bits = 64/N < 32 ? 64/N : 32; //per coordinate
+		static const uint32_t top = uint32_t( (uint64_t(1) << bits) - 1 ); //largest coordinate
+
+		static std::array<uint64_t,N> masks() {
+			//the bits of the code that belong to each coordinate
+			std::array<uint64_t,N> output;
+			output.fill(0);
+			for(unsigned short j=0; j<N*bits; ++j) output[j % N] |= uint64_t(1) << j;
+			return output;
+		}
+		static uint64_t spread(const uint32_t x) {
+#ifdef __BMI2__
+			static const uint64_t first = masks()[0];
+			return _pdep_u64(x, first);
+#else
+			uint64_t code = 0;
+			for(unsigned short j=0; j<bits; ++j) code |= uint64_t((x >> j) & 1) << (j*N);
+			return code;
+#endif
+		}
+		static uint64_t encode(const std::array<uint32_t,N>& cell) {
+			uint64_t code = 0;
+			for(unsigned short i=0; i<N; ++i) code |= spread(cell[i]) << i;
+			return code;
+		}
+		static uint64_t bigmin(const uint64_t code, uint64_t low, uint64_t high);
+	}; //struct Morton
+
+	template<>
+	inline uint64_t Morton<2>::spread(const uint32_t x) {
+		uint64_t code = x;
+		code = (code | (code << 16)) & 0x0000ffff0000ffffull;
+		code = (code | (code << 8)) & 0x00ff00ff00ff00ffull;
+		code = (code | (code << 4)) & 0x0f0f0f0f0f0f0f0full;
+		code = (code | (code << 2)) & 0x3333333333333333ull;
+		return (code | (code << 1)) & 0x5555555555555555ull;
+	}
+
+	template<>
+	inline uint64_t Morton<3>::spread(const uint32_t x) {
+		uint64_t code = x & 0x1fffff;
+		code = (code | (code << 32)) & 0x001f00000000ffffull;
+		code = (code | (code << 16)) & 0x001f0000ff0000ffull;
+		code = (code | (code << 8)) & 0x100f00f00f00f00full;
+		code = (code | (code << 4)) & 0x10c30c30c30c30c3ull;
+		return (code | (code << 2)) & 0x1249249249249249ull;
+	}
+
+	template<unsigned short N>
+	uint64_t Morton<N>::bigmin(const uint64_t code, uint64_t low, uint64_t high) {
+		//the smallest code greater than code whose cell lies between low's and high's, if there
+		//is one; low and high are the codes of the box's lower and upper corners
+		const std::array<uint64_t,N> axes = masks();
+		uint64_t best = high;
+		const uint64_t differ = (code ^ low) | (code ^ high); //all three agree above its top bit
+		if(differ == 0) return best;
+		for(int b=63-__builtin_clzll(differ); b>=0; --b) {
+			const uint64_t bit = uint64_t(1) << b;
+			const uint64_t below = axes[b % N] & (bit - 1); //lower bits of the same coordinate
+			const int pattern = ((code & bit) ? 4 : 0) | ((low & bit) ? 2 : 0) | ((high & bit) ? 1 : 0);
+			switch(pattern) {
+				case 1: //0,0,1: the answer is in the upper half if not the lower one
+					best = (low | bit) & ~below;
+					high = (high & ~bit) | below;
+					break;
+				case 3: return low; //0,1,1: the whole box is above code
+				case 4: return best; //1,0,0: the whole box is below code
+				case 5: low = (low | bit) & ~below; break; //1,0,1: only the upper half can be above code
+				default: break; //0,0,0 and 1,1,1: keep going; 0,1,0 and 1,1,0 can't happen
+			}
+		}
+		return best;
+	}
+
+/* MortonIndex is a SpatialIndex that keeps its points sorted by Morton code, in parallel arrays of
+ * codes, IDs and coordinates. Coordinates are quantized into 2^(64/N) cells per axis across the
+ * bounding box of the points as of the last full sort. A region query turns the region into a box
+ * of cells and scans the runs of codes inside it, jumping between runs with bigmin and a binary
+ * search, so it reads short contiguous stretches of memory. Radius queries scan the enclosing box.
+ * nearest takes the points on either side of the center's place along the curve as a first guess,
+ * then scans the box that the k-th best of them fits in.
+ *
+ * Changes are batched. Inserts go to a small unsorted overflow, which queries scan in full, and
+ * removals leave a dead slot in the sorted arrays. A move that stays in its cell updates the point
+ * in place; any other is a removal and an insert. Once the overflow and dead slots add up to an
+ * eighth of the points, the overflow is sorted and merged in, in linear time, or everything is
+ * sorted again over new bounds if some overflow point lies outside the old ones.
+ *
+ * ordering() returns the IDs in Morton order, for use as a locality-preserving order elsewhere,
+ * such as the starting blocks of a Partition.
+ */
+	template<typename T, unsigned short N>
+	class MortonIndex : public SpatialIndex<T,N> {
+	private:
+		typedef SpatialIndex<T,N> base_type;
+		typedef MortonIndex self_type;
+		typedef Morton<N> kernel_type;
+
+	public:
+		typedef typename base_type::point_type point_type;
+		typedef typename base_type::id_type id_type;
+		typedef typename base_type::region_type region_type;
+		typedef std::array<uint32_t,N> cell_type;
+
+	private:
+		struct Slot {
+			bool sorted; //in the sorted arrays, rather than the overflow
+			size_t index;
+		};
+
+		std::array<double,N> origin, scale; //cell = (x - origin)*scale, clamped
+		std::vector<uint64_t> codes;
+		std::vector<id_type> ids;
+		std::vector<point_type> points;
+		std::vector<char> live;
+		size_t dead;
+		std::vector<uint64_t> extra_codes; //the overflow
+		std::vector<id_type> extra_ids;
+		std::vector<point_type> extra_points;
+		std::unordered_map<id_type, Slot> where;
+
+		uint32_t quantize(const double x, const unsigned short axis) const {
+			double cell = (x - origin[axis]) * scale[axis];
+			if( !(cell > 0.0) ) return 0; //also catches NaN
+			if(cell >= double(kernel_type::top)) return kernel_type::top;
+			return uint32_t(cell);
+		}
+		cell_type cell_for(const point_type& point) const {
+			cell_type cell;
+			for(unsigned short i=0; i<N; ++i) cell[i] = quantize(double(point[i]), i);
+			return cell;
+		}
+		uint64_t code_for(const point_type& point) const { return kernel_type::encode(cell_for(point)); }
+		bool in_bounds(const point_type& point) const {
+			for(unsigned short i=0; i<N; ++i) {
+				double cell = (double(point[i]) - origin[i]) * scale[i];
+				if(cell < 0.0 or cell > double(kernel_type::top)) return false;
+			}
+			return true;
+		}
+		void sort_all(std::vector< std::pair<id_type, point_type> >& entries);
+		void merge();
+		void changed() { if(dead + extra_ids.size() > std::max(size_t(32), size()/8)) merge(); }
+
+		template<typename F>
+		void scan(const region_type& box, F f) const;
+
+	public:
+		MortonIndex() : dead(0) { clear(); }
+		MortonIndex(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~MortonIndex() = default;
+
+		void build(const std::vector< std::pair<id_type, point_type> >& entries) {
+			std::vector< std::pair<id_type, point_type> > copy(entries);
+			sort_all(copy);
+		}
+		bool insert(const id_type address, const point_type& point) {
+			if(where.count(address) == 1) return false;
+			where[address] = Slot{false, extra_ids.size()};
+			extra_codes.push_back( code_for(point) );
+			extra_ids.push_back(address);
+			extra_points.push_back(point);
+			changed();
+			return true;
+		}
+		bool remove(const id_type address);
+		bool move(const id_type address, const point_type& point);
+		void clear() {
+			origin.fill(0.0);
+			scale.fill(1.0);
+			codes.clear();
+			ids.clear();
+			points.clear();
+			live.clear();
+			dead = 0;
+			extra_codes.clear();
+			extra_ids.clear();
+			extra_points.clear();
+			where.clear();
+		}
+		size_t size() const { return where.size(); }
+
+		uint64_t code(const point_type& point) const { return code_for(point); } //under the current bounds
+		std::vector<id_type> ordering() const;
+
+		void in_region(const region_type& region, std::vector<id_type>& output) const {
+			scan(region, [&](const id_type address, const point_type& point) {
+				if( region.contains(point) ) output.push_back(address);
+			});
+		}
+		void within(const point_type& center, const double radius, std::vector<id_type>& output) const {
+			if(radius < 0.0) return;
+			scan(region_type::around(center, radius), [&](const id_type address, const point_type& point) {
+				if(squared_distance(center, point) <= radius*radius) output.push_back(address);
+			});
+		}
+		size_t nearest(const point_type& center, const size_t k, Neighbor* output) const;
+	}; //class MortonIndex
+
+	template<typename T, unsigned short N>
+	void MortonIndex<T,N>::sort_all(std::vector< std::pair<id_type, point_type> >& entries) {
+		//sets the bounds from entries, then sorts them by code into the arrays
+		clear();
+		if( entries.empty() ) return;
+		std::array<double,N> low, high;
+		low.fill( std::numeric_limits<double>::max() );
+		high.fill( std::numeric_limits<double>::lowest() );
+		for(auto& x : entries) {
+			for(unsigned short i=0; i<N; ++i) {
+				low[i] = std::min(low[i], double(x.second[i]));
+				high[i] = std::max(high[i], double(x.second[i]));
+			}
+		}
+		for(unsigned short i=0; i<N; ++i) {
+			origin[i] = low[i];
+			scale[i] = high[i] > low[i] ? double(kernel_type::top) / (high[i] - low[i]) : 0.0;
+		}
+
+		std::vector< std::pair<uint64_t, size_t> > order(entries.size());
+		for(size_t i=0; i<entries.size(); ++i) order[i] = std::make_pair(code_for(entries[i].second), i);
+		std::sort(order.begin(), order.end());
+		codes.reserve(order.size());
+		ids.reserve(order.size());
+		points.reserve(order.size());
+		where.reserve(order.size());
+		for(auto& x : order) {
+			if( !where.insert(std::make_pair(entries[x.second].first, Slot{true, ids.size()})).second ) continue;
+			codes.push_back(x.first);
+			ids.push_back(entries[x.second].first);
+			points.push_back(entries[x.second].second);
+		}
+		live.assign(ids.size(), 1);
+	}
+
+	template<typename T, unsigned short N>
+	void MortonIndex<T,N>::merge() {
+		//folds the overflow into the sorted arrays and drops dead slots
+		bool inside = true;
+		for(auto& x : extra_points) if( !in_bounds(x) ) inside = false;
+		if(!inside or ids.size() == dead) {
+			std::vector< std::pair<id_type, point_type> > entries;
+			entries.reserve(size());
+			for(size_t i=0; i<ids.size(); ++i) if(live[i]) entries.push_back( std::make_pair(ids[i], points[i]) );
+			for(size_t i=0; i<extra_ids.size(); ++i) entries.push_back( std::make_pair(extra_ids[i], extra_points[i]) );
+			sort_all(entries);
+			return;
+		}
+
+		std::vector<size_t> order(extra_ids.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return extra_codes[a] < extra_codes[b]; });
+		std::vector<uint64_t> new_codes;
+		std::vector<id_type> new_ids;
+		std::vector<point_type> new_points;
+		new_codes.reserve(size());
+		new_ids.reserve(size());
+		new_points.reserve(size());
+		size_t i = 0, j = 0;
+		while(i < ids.size() or j < order.size()) {
+			if(i < ids.size() and !live[i]) {
+				++i;
+				continue;
+			}
+			if( j == order.size() or (i < ids.size() and codes[i] <= extra_codes[order[j]]) ) {
+				new_codes.push_back(codes[i]);
+				new_ids.push_back(ids[i]);
+				new_points.push_back(points[i++]);
+			} else {
+				new_codes.push_back(extra_codes[order[j]]);
+				new_ids.push_back(extra_ids[order[j]]);
+				new_points.push_back(extra_points[order[j++]]);
+			}
+			where[new_ids.back()] = Slot{true, new_ids.size() - 1};
+		}
+		codes.swap(new_codes);
+		ids.swap(new_ids);
+		points.swap(new_points);
+		live.assign(ids.size(), 1);
+		dead = 0;
+		extra_codes.clear();
+		extra_ids.clear();
+		extra_points.clear();
+	}
+
+	template<typename T, unsigned short N>
+	bool MortonIndex<T,N>::remove(const id_type address) {
+		auto iter = where.find(address);
+		if(iter == where.end()) return false;
+		const Slot slot = iter->second;
+		where.erase(iter);
+		if(slot.sorted) {
+			live[slot.index] = 0;
+			++dead;
+		} else {
+			const size_t last = extra_ids.size() - 1;
+			if(slot.index != last) {
+				extra_codes[slot.index] = extra_codes[last];
+				extra_ids[slot.index] = extra_ids[last];
+				extra_points[slot.index] = extra_points[last];
+				where[extra_ids[slot.index]].index = slot.index;
+			}
+			extra_codes.pop_back();
+			extra_ids.pop_back();
+			extra_points.pop_back();
+		}
+		changed();
+		return true;
+	}
+
+	template<typename T, unsigned short N>
+	bool MortonIndex<T,N>::move(const id_type address, const point_type& point) {
+		auto iter = where.find(address);
+		if(iter == where.end()) return false;
+		const Slot slot = iter->second;
+		const uint64_t code = code_for(point);
+		if(slot.sorted and codes[slot.index] == code) points[slot.index] = point;
+		else if(!slot.sorted) {
+			extra_codes[slot.index] = code;
+			extra_points[slot.index] = point;
+		} else {
+			remove(address);
+			insert(address, point);
+		}
+		return true;
+	}
+
+	template<typename T, unsigned short N>
+	template<typename F>
+	void MortonIndex<T,N>::scan(const region_type& box, F f) const {
+		//calls f(id, point) for every point in the cells that box overlaps
+		for(unsigned short i=0; i<N; ++i) if(box.upper[i] < box.lower[i]) return;
+		const uint64_t low = code_for(box.lower), high = code_for(box.upper);
+		const std::array<uint64_t,N> masks = kernel_type::masks();
+		auto inside = [&](const uint64_t code) {
+			for(unsigned short i=0; i<N; ++i)
+				if((code & masks[i]) < (low & masks[i]) or (code & masks[i]) > (high & masks[i])) return false;
+			return true;
+		};
+
+		auto iter = std::lower_bound(codes.begin(), codes.end(), low);
+		while(iter != codes.end() and *iter <= high) {
+			if( inside(*iter) ) {
+				const size_t i = iter - codes.begin();
+				if(live[i]) f(ids[i], points[i]);
+				++iter;
+			} else if(++iter != codes.end() and inside(*iter)) {
+				continue; //often just one code out of the box, and cheaper to check than to jump
+			} else if(iter != codes.end()) {
+				const uint64_t next = kernel_type::bigmin(*iter, low, high);
+				if(next <= *iter) break; //nothing more in the box
+				iter = std::lower_bound(iter, codes.end(), next);
+			}
+		}
+		for(size_t i=0; i<extra_ids.size(); ++i) if( inside(extra_codes[i]) ) f(extra_ids[i], extra_points[i]);
+	}
+
+	template<typename T, unsigned short N>
+	size_t MortonIndex<T,N>::nearest(const point_type& center, const size_t k, Neighbor* output) const {
+		size_t count = 0;
+		if(k == 0 or size() == 0) return 0;
+		//the points next to center along the curve are near it, if not the nearest; the k-th best of
+		//them bounds the search box, which a single scan then covers
+		const size_t start = std::lower_bound(codes.begin(), codes.end(), code_for(center)) - codes.begin();
+		size_t taken = 0;
+		for(size_t i=start; i<ids.size() and taken<k; ++i) {
+			if(!live[i]) continue;
+			base_type::offer(output, count, k, ids[i], squared_distance(center, points[i]));
+			++taken;
+		}
+		taken = 0;
+		for(size_t i=start; i>0 and taken<k; --i) {
+			if(!live[i-1]) continue;
+			base_type::offer(output, count, k, ids[i-1], squared_distance(center, points[i-1]));
+			++taken;
+		}
+		for(size_t i=0; i<extra_ids.size(); ++i)
+			base_type::offer(output, count, k, extra_ids[i], squared_distance(center, extra_points[i]));
+		if(count == k) {
+			const double half = std::sqrt(output[0].distance);
+			count = 0;
+			scan(region_type::around(center, half), [&](const id_type address, const point_type& point) {
+				base_type::offer(output, count, k, address, squared_distance(center, point));
+			});
+		}
+		return base_type::finish(output, count);
+	}
+
+	template<typename T, unsigned short N>
+	std::vector<typename MortonIndex<T,N>::id_type> MortonIndex<T,N>::ordering() const {
+		std::vector<size_t> order(extra_ids.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return extra_codes[a] < extra_codes[b]; });
+		std::vector<id_type> output;
+		output.reserve(size());
+		size_t i = 0, j = 0;
+		while(i < ids.size() or j < order.size()) {
+			if(i < ids.size() and !live[i]) ++i;
+			else if( j == order.size() or (i < ids.size() and codes[i] <= extra_codes[order[j]]) ) output.push_back(ids[i++]);
+			else output.push_back(extra_ids[order[j++]]);
+		}
+		return output;
+	}
+
+} //namespace ben
+
+#endif
+
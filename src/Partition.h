@@ -0,0 +1,160 @@
+#ifndef BenoitPartition_h
+#define BenoitPartition_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <vector>
+#include <algorithm>
+#include "Graph.h"
+#include "CSR.h"
+
+namespace ben {
+/* Partition splits the nodes of a Graph into K parts while keeping as many links as possible inside
+ * a part, so that threads working on different parts rarely walk or push across to each other.
+ * It uses size-constrained label propagation: nodes start in contiguous blocks of Graph::ordering(),
+ * then each node repeatedly moves to the part most of its neighbors are in, as long as that part
+ * is below capacity (balance * n/K nodes). Links count in both directions. A seed ordering of node
+ * IDs, such as Space::morton_ordering for nodes placed in space, replaces Graph::ordering() for the
+ * starting blocks; nodes it leaves out follow it in Graph::ordering().
+ *
+ * The result is a snapshot; nodes added to the Graph later don't belong to any part, and part_of
+ * returns parts() for them. Executor::run_partitions steps each part on one worker.
+ */
+	template<typename N>
+	class Partition {
+	public:
+		typedef N node_type;
+		typedef Graph<N> graph_type;
+		typedef typename N::id_type id_type;
+		typedef typename std::vector<N*>::const_iterator iterator;
+
+	private:
+		typedef Partition self_type;
+		typedef CSR<unsigned> csr_type;
+		csr_type adjacency;
+		std::vector<unsigned> labels; //part of each node, by position in the CSR
+		std::vector<N*> members; //nodes grouped by part
+		std::vector<size_t> offsets; //where each part starts in members
+		unsigned k;
+
+		void propagate(const unsigned rounds, const double balance, const std::vector<id_type>* seed);
+		void collect(const graph_type& graph);
+
+	public:
+		Partition() = delete;
+		Partition(const graph_type& graph, const unsigned parts, const unsigned rounds=10, const double balance=1.05)
+			: adjacency(graph, link_types<N>::directed ? Direction::both : Direction::outgoing),
+			  labels(), members(), offsets(), k(parts > 0 ? parts : 1) {
+			propagate(rounds, balance, nullptr);
+			collect(graph);
+		}
+		Partition(const graph_type& graph, const unsigned parts, const std::vector<id_type>& seed,
+			  const unsigned rounds=10, const double balance=1.05)
+			: adjacency(graph, link_types<N>::directed ? Direction::both : Direction::outgoing),
+			  labels(), members(), offsets(), k(parts > 0 ? parts : 1) {
+			propagate(rounds, balance, &seed);
+			collect(graph);
+		}
+		Partition(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~Partition() = default;
+
+		unsigned parts() const { return k; }
+		unsigned part_of(const id_type address) const {
+			auto i = adjacency.position(address);
+			return i < labels.size() ? labels[i] : k;
+		}
+		size_t size(const unsigned part) const { return offsets[part+1] - offsets[part]; }
+		iterator begin(const unsigned part) const { return members.begin() + offsets[part]; }
+		iterator end(const unsigned part) const { return members.begin() + offsets[part+1]; }
+
+		size_t edge_cut() const {
+			//links between parts, counted once per listing in the adjacency
+			size_t cut = 0;
+			for(typename csr_type::index_type i=0; i<adjacency.size(); ++i)
+				for(auto j=adjacency.begin(i); j!=adjacency.end(i); ++j)
+					if(labels[i] != labels[*j]) ++cut;
+			return cut;
+		}
+	}; //class Partition
+
+	template<typename N>
+	void Partition<N>::propagate(const unsigned rounds, const double balance, const std::vector<id_type>* seed) {
+		const size_t n = adjacency.size();
+		const size_t capacity = std::max<size_t>(1, size_t(balance * double(n) / k + 0.999));
+		std::vector<size_t> rank(n, n); //place of each node in the starting order
+		size_t next = 0;
+		if(seed) {
+			for(auto address : *seed) {
+				auto i = adjacency.position(address);
+				if(i < n and rank[i] == n) rank[i] = next++;
+			}
+		}
+		for(size_t i=0; i<n; ++i) if(rank[i] == n) rank[i] = next++;
+		labels.resize(n);
+		std::vector<size_t> sizes(k, 0);
+		for(size_t i=0; i<n; ++i) { //contiguous blocks of the starting order
+			labels[i] = unsigned(rank[i] * k / (n > 0 ? n : 1));
+			++sizes[labels[i]];
+		}
+
+		std::vector<unsigned> counts(k, 0);
+		std::vector<unsigned> touched; //parts with nonzero counts, to reset cheaply
+		for(unsigned round=0; round<rounds; ++round) {
+			size_t moves = 0;
+			for(size_t i=0; i<n; ++i) {
+				const unsigned current = labels[i];
+				for(auto j=adjacency.begin(i); j!=adjacency.end(i); ++j) {
+					unsigned label = labels[*j];
+					if(counts[label]++ == 0) touched.push_back(label);
+				}
+				unsigned best = current;
+				for(unsigned label : touched)
+					if( counts[label] > counts[best] and sizes[label] < capacity ) best = label;
+				for(unsigned label : touched) counts[label] = 0;
+				touched.clear();
+
+				if(best != current) {
+					--sizes[current];
+					++sizes[best];
+					labels[i] = best;
+					++moves;
+				}
+			}
+			if(moves == 0) break;
+		}
+	}
+
+	template<typename N>
+	void Partition<N>::collect(const graph_type& graph) {
+		auto& nodes = graph.ordering();
+		offsets.assign(k+1, 0);
+		for(unsigned x : labels) ++offsets[x+1];
+		for(unsigned p=0; p<k; ++p) offsets[p+1] += offsets[p];
+		members.resize(nodes.size());
+		std::vector<size_t> next(offsets.begin(), offsets.end()-1);
+		for(size_t i=0; i<nodes.size(); ++i) members[ next[labels[i]]++ ] = nodes[i];
+	}
+
+} //namespace ben
+
+#endif
+
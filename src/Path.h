@@ -78,6 +78,7 @@ namespace ben {
 				otherID = rhs.otherID;
 				value_ptr = std::move(rhs.value_ptr);
 			}
+			return *this;
 		}
 		~Path() = default;
 
@@ -17,36 +17,42 @@
 
 	You should have received a copy of the GNU General Public License
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
-	
+
 	The author may be reached at jackhall@utexas.edu.
 */
 
 #include <array>
-#include <functional>
+#include <memory>
 #include <algorithm>
+#include "Singleton.h"
+#include "Distance.h"
 
 namespace ben {
-	
-	template<typename T, unsigned short N> 
+
+	template<typename T, unsigned short N> class Space;
+
+	template<typename T, unsigned short N>
 	class CartesianPoint {
 		typedef CartesianPoint self_type;
 		std::array<T,N> data;
-		constexpr unsigned short dimensions() { return N; }
 
 	public:
 		typedef T value_type;
-		typedef std::array<T,N>::iterator iterator;
-		typedef std::array<T,N>::const_iterator const_iterator;
+		typedef typename std::array<T,N>::iterator iterator;
+		typedef typename std::array<T,N>::const_iterator const_iterator;
+		static const unsigned short dimensions = N;
 
-		CartesianPoint() = default;
+		CartesianPoint() : data() {}
 		template<typename... U>
-		CartesianPoint(U... elements) : data{elements...} {}
+		CartesianPoint(const T first, const U... rest) : data{{first, T(rest)...}} {}
+		CartesianPoint(const std::array<T,N>& coordinates) : data(coordinates) {}
 		CartesianPoint(const self_type& rhs) = default;
 		CartesianPoint& operator=(const self_type& rhs) = default;
-		virtual ~CartesianPoint() = default;
+		~CartesianPoint() = default; //not virtual: no vptr in every coordinate array
 
 		value_type& operator[](const unsigned short n) { return data[n]; }
 		const value_type& operator[](const unsigned short n) const { return data[n]; }
+		const std::array<T,N>& coordinates() const { return data; }
 
 		iterator begin() { return data.begin(); }
 		const_iterator begin() const { return data.begin(); }
@@ -55,71 +61,83 @@ namespace ben {
 	};
 
 
-	template<typename T, unsigned short N> 
-	CartesianPoint<T,N> for_both(const CartesianPoint<T,N> a, const CartesianPoint<T,N> b, 
-				     std::function<T(T,T)> f) {
+	template<typename T, unsigned short N, typename F>
+	CartesianPoint<T,N> for_both(const CartesianPoint<T,N>& a, const CartesianPoint<T,N>& b, F f) {
 		CartesianPoint<T,N> c;
-		auto i = a.begin(), j = b.begin();
-		auto g = [&i, &j](T& x) { x = f(*i, *j); ++i; ++j; }
-		std::for_each(c.begin(), c.end(), g);
+		for(unsigned short i=0; i<N; ++i) c[i] = f(a[i], b[i]);
 		return c;
 	}
 
 
 	template<typename T, unsigned short N>
-	T squared_distance(const CartesianPoint<T,N> a, const CartesianPoint<T,N> b) {
-		//create a temporary point that is the difference between a & b
-		auto c = for_both(c.begin(), c.end(), difference);
-
-		//sum the elements of the temporary
-		num_type d = 0;
-		auto sum = [&d](num_type x){ d += x; }
-		std::for_each(c.begin(), c.end(), sum);
-		return d;
-	}
+	T squared_distance(const CartesianPoint<T,N>& a, const CartesianPoint<T,N>& b)
+		{ return T( squared_distance(a.coordinates(), b.coordinates()) ); }
+	template<typename T, unsigned short N>
+	T manhattan_distance(const CartesianPoint<T,N>& a, const CartesianPoint<T,N>& b)
+		{ return T( manhattan_distance(a.coordinates(), b.coordinates()) ); }
+	template<typename T, unsigned short N>
+	T chebyshev_distance(const CartesianPoint<T,N>& a, const CartesianPoint<T,N>& b)
+		{ return T( chebyshev_distance(a.coordinates(), b.coordinates()) ); }
 
 
 	template<typename T, unsigned short N>
 	class Point : public CartesianPoint<T,N>, public Singleton {
+	/*
+		A Point is a location in a Space, with identity semantics like a node in a Graph. Change
+		its coordinates with move_to or set, which tell the Space so it can patch its spatial
+		index for just this Point. After writing coordinates through operator[], call
+		Space::moved with the Point's ID yourself, or Space::update_data for many Points.
+	*/
 	private:
 		typedef Point self_type;
+		typedef Singleton base_type;
+		void perform_leave() {}
 
-	public:	
+	public:
+		typedef Space<T,N> 			index_type;
 		typedef CartesianPoint<T,N> 		point_type;
 		typedef typename point_type::value_type value_type;
 		typedef typename Singleton::id_type 	id_type;
 
 		Point() = default;
-		explicit Point(std::shared_ptr<index_type> space_ptr) 
-			: singleton_type(space_ptr), point_type() {}
+		explicit Point(std::shared_ptr<index_type> space_ptr)
+			: point_type(), base_type(space_ptr) {}
 		Point(std::shared_ptr<index_type> space_ptr, const id_type id)
-			: singleton_type(space_ptr, id), point_type() {} 
-		template<typename... U>
-		Point(std::shared_ptr<index_type> space_ptr, U... coords) : Singleton(space_ptr), point_type(coords...) {}
-		template<typename... U>
-		Point(index_type& space, const id_type id, U... coords) : Singleton(space_ptr, id), point_type(coords...) {}
-		Point(std::shared_ptr<index_type>, space_ptr, const point_type& alias) 
-			: Singleton(space_ptr), point_type(alias) {}
-		Point(std::shared_ptr<index_type> space_ptr, const id_type id, const point_type& alias)
-			: singleton_type(space, id), point_type(alias) {}
+			: point_type(), base_type(space_ptr, id) {}
+		Point(std::shared_ptr<index_type> space_ptr, const point_type& coordinates)
+			: point_type(coordinates), base_type(space_ptr) {}
+		Point(std::shared_ptr<index_type> space_ptr, const id_type id, const point_type& coordinates)
+			: point_type(coordinates), base_type(space_ptr, id) {}
 		Point(const self_type& rhs) = delete;
-		Point(self_type&& rhs) : Singleton(std::move(rhs)), point_type(rhs) {}
+		Point(self_type&& rhs) : point_type(rhs), base_type(std::move(rhs)) {}
 		self_type& operator=(self_type&& rhs) {
 			if(this != &rhs) {
-				Singleton::operator=(std::move(rhs));	
+				base_type::operator=(std::move(rhs));
 				point_type::operator=(rhs);
 			}
 			return *this;
 		}
 		~Point() = default;
-		
+
+		void move_to(const point_type& coordinates) {
+			point_type::operator=(coordinates);
+			if( is_managed() ) get_index()->moved(ID());
+		}
+		void set(const unsigned short n, const value_type x) {
+			(*this)[n] = x;
+			if( is_managed() ) get_index()->moved(ID());
+		}
+
+		bool join_index(std::shared_ptr<index_type> ptr) { return base_type::join_index(ptr); }
+		std::shared_ptr<index_type> get_index() const //ensures proper type casting of the index pointer
+			{ return std::static_pointer_cast<index_type>(base_type::get_index()); }
+
 		//void lock() { point_mutex.lock(); }
 		//bool try_lock() { return point_mutex.try_lock(); }
 		//void unlock() { point_mutex.unlock(); }
-		
+
 	}; //class Point
-	
+
 } //namespace ben
 
 #endif
-
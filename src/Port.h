@@ -186,6 +186,7 @@ namespace ben {
 	
 		id_type get_address() const { return targetID; }
 		bool push(const signal_type& signal) { return buffer_ptr->push(signal); } //take another look at const requirements
+		bool flush() { return buffer_ptr->flush(); } //only for Buffers that batch, like SocketBuffer
 	}; //struct OutPort
 
 	template<typename B>
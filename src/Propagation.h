@@ -0,0 +1,248 @@
+#ifndef BenoitPropagation_h
+#define BenoitPropagation_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include "Graph.h"
+#include "CSR.h"
+#include "ThreadPool.h"
+
+namespace ben {
+/* Iterative score propagation over the links of a Graph, run on a ThreadPool against a CSR snapshot
+ * rather than the node objects.
+ *
+ * propagate is the general kernel: a Jacobi iteration in which every node's new score is
+ * update(i, sum of weight*score over its incoming links), repeated until the scores change by
+ * less than the tolerance (summed over all nodes) or the iteration limit is reached. It pulls,
+ * so it takes an incoming CSR (Direction::incoming), and every node is written by one worker.
+ *
+ * PageRank is the usual damped random walk, with transition probabilities proportional to link
+ * weights (Path values for stdDirectedNode<double>, 1 for Ports) and the rank of nodes without
+ * outputs spread evenly over the graph. It can pull, each node summing over its inputs, or push,
+ * each node adding its share to its outputs with atomic additions. Pulling writes each score
+ * once and suits most graphs; pushing reads the outgoing links directly, with no transpose, and
+ * can win when a few nodes have very many inputs. Either way the scores are indexed like the CSR,
+ * by position in Graph::ordering(), and sum to 1.
+ */
+	enum class Flow { pull, push };
+
+	inline void atomic_add(std::atomic<double>& x, const double y) {
+		double old = x.load(std::memory_order_relaxed);
+		while( !x.compare_exchange_weak(old, old + y, std::memory_order_relaxed) ) {}
+	}
+
+	template<typename W, typename F>
+	unsigned propagate(ThreadPool& pool, const CSR<W>& incoming, std::vector<double>& scores, F update,
+			   const double tolerance, const unsigned max_iterations, const size_t chunk=256) {
+		//returns the number of iterations run; scores must start with one entry per node
+		std::vector<double> next(scores.size());
+		unsigned iteration = 0;
+		while(iteration < max_iterations) {
+			++iteration;
+			std::atomic<double> change(0.0);
+			pool.parallel_for(scores.size(), chunk, [&](const size_t first, const size_t last) {
+				double local = 0.0;
+				for(size_t i=first; i<last; ++i) {
+					double sum = 0.0;
+					const W* w = incoming.weights_of(i);
+					for(auto j=incoming.begin(i); j!=incoming.end(i); ++j, ++w) sum += double(*w) * scores[*j];
+					next[i] = update(i, sum);
+					local += std::fabs(next[i] - scores[i]);
+				}
+				atomic_add(change, local);
+			});
+			scores.swap(next);
+			if(change.load() < tolerance) break;
+		}
+		return iteration;
+	}
+
+
+	template<typename W=double>
+	class PageRank {
+	public:
+		typedef W weight_type;
+		typedef typename CSR<W>::index_type index_type;
+		typedef typename CSR<W>::id_type id_type;
+
+	private:
+		typedef PageRank self_type;
+		ThreadPool* pool;
+		double damping, tolerance;
+		unsigned max_iterations;
+		Flow flow;
+		size_t chunk_size;
+
+		std::vector<id_type> ids;
+		std::vector<double> ranks;
+		double change; //summed over all nodes, in the last iteration
+
+		unsigned run_pull(const CSR<W>& outgoing, const std::vector<double>& out_weight);
+		unsigned run_push(const CSR<W>& outgoing, const std::vector<double>& out_weight);
+		double dangling_sum(const std::vector<double>& out_weight) const;
+
+	public:
+		PageRank() = delete;
+		explicit PageRank(ThreadPool& workers, const double damping_factor=0.85, const double tol=1e-9,
+				  const unsigned iterations=100, const Flow direction=Flow::pull)
+			: pool(&workers), damping(damping_factor), tolerance(tol), max_iterations(iterations),
+			  flow(direction), chunk_size(256), change(0.0) {}
+		PageRank(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~PageRank() = default;
+
+		void set_flow(const Flow direction) { flow = direction; }
+		Flow get_flow() const { return flow; }
+		void set_tolerance(const double tol) { tolerance = tol; }
+		void set_max_iterations(const unsigned iterations) { max_iterations = iterations; }
+		void set_chunk_size(const size_t chunk) { chunk_size = chunk > 0 ? chunk : 1; }
+
+		template<typename N>
+		unsigned run(const Graph<N>& graph) { return run( CSR<W>(graph, Direction::outgoing) ); }
+		unsigned run(const CSR<W>& outgoing); //returns the number of iterations
+
+		const std::vector<double>& scores() const { return ranks; } //by position in the CSR
+		double score(const id_type address) const {
+			//0 for nodes that weren't in the graph
+			auto iter = std::lower_bound(ids.begin(), ids.end(), address);
+			if(iter != ids.end() and *iter == address) return ranks[iter - ids.begin()];
+			else return 0.0;
+		}
+		double residual() const { return change; }
+	}; //class PageRank
+
+	template<typename W>
+	unsigned PageRank<W>::run(const CSR<W>& outgoing) {
+		const size_t n = outgoing.size();
+		ids = outgoing.id_array();
+		ranks.assign(n, n > 0 ? 1.0/n : 0.0);
+		change = 0.0;
+		if(n == 0) return 0;
+
+		std::vector<double> out_weight(n, 0.0);
+		pool->parallel_for(n, chunk_size, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) {
+				const W* w = outgoing.weights_of(i);
+				for(size_t k=0; k<outgoing.degree(i); ++k) out_weight[i] += double(w[k]);
+			}
+		});
+		return flow == Flow::pull ? run_pull(outgoing, out_weight) : run_push(outgoing, out_weight);
+	}
+
+	template<typename W>
+	double PageRank<W>::dangling_sum(const std::vector<double>& out_weight) const {
+		//rank held by nodes with no (or only zero-weight) outputs
+		std::atomic<double> sum(0.0);
+		pool->parallel_for(ranks.size(), chunk_size, [&](const size_t first, const size_t last) {
+			double local = 0.0;
+			for(size_t i=first; i<last; ++i) if(out_weight[i] <= 0.0) local += ranks[i];
+			atomic_add(sum, local);
+		});
+		return sum.load();
+	}
+
+	template<typename W>
+	unsigned PageRank<W>::run_pull(const CSR<W>& outgoing, const std::vector<double>& out_weight) {
+		//transpose the outgoing links, normalizing each weight by its source's total
+		const size_t n = outgoing.size();
+		std::vector<size_t> offsets(n+1, 0);
+		for(size_t e=0; e<outgoing.edges(); ++e) ++offsets[ outgoing.target_array()[e] + 1 ];
+		for(size_t i=0; i<n; ++i) offsets[i+1] += offsets[i];
+		std::vector<index_type> sources(outgoing.edges());
+		std::vector<double> weights(outgoing.edges());
+		std::vector<size_t> fill(offsets.begin(), offsets.end()-1);
+		for(size_t i=0; i<n; ++i) {
+			const W* w = outgoing.weights_of(i);
+			for(auto j=outgoing.begin(i); j!=outgoing.end(i); ++j, ++w) {
+				size_t slot = fill[*j]++;
+				sources[slot] = i;
+				weights[slot] = out_weight[i] > 0.0 ? double(*w) / out_weight[i] : 0.0;
+			}
+		}
+
+		std::vector<double> next(n);
+		unsigned iteration = 0;
+		while(iteration < max_iterations) {
+			++iteration;
+			const double base = (1.0 - damping + damping*dangling_sum(out_weight)) / n;
+			std::atomic<double> total(0.0);
+			pool->parallel_for(n, chunk_size, [&](const size_t first, const size_t last) {
+				double local = 0.0;
+				for(size_t i=first; i<last; ++i) {
+					double sum = 0.0;
+					for(size_t e=offsets[i]; e<offsets[i+1]; ++e) sum += weights[e] * ranks[sources[e]];
+					next[i] = base + damping*sum;
+					local += std::fabs(next[i] - ranks[i]);
+				}
+				atomic_add(total, local);
+			});
+			ranks.swap(next);
+			change = total.load();
+			if(change < tolerance) break;
+		}
+		return iteration;
+	}
+
+	template<typename W>
+	unsigned PageRank<W>::run_push(const CSR<W>& outgoing, const std::vector<double>& out_weight) {
+		const size_t n = outgoing.size();
+		std::unique_ptr<std::atomic<double>[]> incoming(new std::atomic<double>[n]);
+		unsigned iteration = 0;
+		while(iteration < max_iterations) {
+			++iteration;
+			const double base = (1.0 - damping + damping*dangling_sum(out_weight)) / n;
+			pool->parallel_for(n, chunk_size, [&](const size_t first, const size_t last) {
+				for(size_t i=first; i<last; ++i) incoming[i].store(0.0, std::memory_order_relaxed);
+			});
+			pool->parallel_for(n, chunk_size, [&](const size_t first, const size_t last) {
+				for(size_t i=first; i<last; ++i) {
+					if(out_weight[i] <= 0.0) continue;
+					const double share = damping * ranks[i] / out_weight[i];
+					const W* w = outgoing.weights_of(i);
+					for(auto j=outgoing.begin(i); j!=outgoing.end(i); ++j, ++w)
+						atomic_add(incoming[*j], share * double(*w));
+				}
+			});
+			std::atomic<double> total(0.0);
+			pool->parallel_for(n, chunk_size, [&](const size_t first, const size_t last) {
+				double local = 0.0;
+				for(size_t i=first; i<last; ++i) {
+					double updated = base + incoming[i].load(std::memory_order_relaxed);
+					local += std::fabs(updated - ranks[i]);
+					ranks[i] = updated;
+				}
+				atomic_add(total, local);
+			});
+			change = total.load();
+			if(change < tolerance) break;
+		}
+		return iteration;
+	}
+
+} //namespace ben
+
+#endif
+
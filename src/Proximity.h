@@ -0,0 +1,222 @@
+#ifndef BenoitProximity_h
+#define BenoitProximity_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include "Graph.h"
+#include "UndirectedNode.h"
+#include "Commons.h"
+#include "Space.h"
+#include "Clone.h"
+#include "ThreadPool.h"
+
+namespace ben {
+
+	template<typename T, unsigned short N, typename V, typename R, typename Q>
+	bool link_proximity(ThreadPool& pool, const Space<T,N>& space, Graph< UndirectedNode< Path<V> > >& target,
+			    R remap, Q query, const size_t chunk) {
+	/*
+		The common part of knn_graph and radius_graph. query(center, self, output) appends the
+		Neighbors of one point to output, leaving out self. Pairs found from either end are
+		merged into one link, owned by the end that comes first in the Space's coordinate
+		mirror. Links that already exist are left alone.
+	*/
+		typedef UndirectedNode< Path<V> > node_type;
+		typedef Path<V> link_type;
+		struct Pair {
+			uint32_t other;
+			double distance;
+			bool operator<(const Pair& rhs) const { return other < rhs.other; }
+		};
+
+		const auto& mirror = space.coordinates(); //brings the spatial index up to date as well
+		const size_t n = mirror.size();
+		std::vector<node_type*> nodes(n);
+		for(size_t i=0; i<n; ++i) {
+			auto iter = target.find( remap(mirror.ids()[i]) );
+			if(iter == target.end()) return false;
+			nodes[i] = &*iter;
+		}
+		std::unordered_map<unsigned int, uint32_t> positions;
+		positions.reserve(n);
+		for(size_t i=0; i<n; ++i) positions[ mirror.ids()[i] ] = i;
+
+		//queries, in parallel, gathered per chunk of points
+		const size_t step = chunk > 0 ? chunk : 1;
+		std::vector< std::vector<Pair> > found( (n + step - 1) / step );
+		std::vector<size_t> counts(n+1, 0);
+		pool.parallel_for(n, step, [&](const size_t first, const size_t last) {
+			std::vector<Neighbor> neighbors;
+			std::vector<Pair>& output = found[first / step];
+			for(size_t i=first; i<last; ++i) {
+				neighbors.clear();
+				query(mirror.point(i), mirror.ids()[i], neighbors);
+				for(auto& x : neighbors) output.push_back( Pair{positions.find(x.id)->second, x.distance} );
+				counts[i+1] = neighbors.size();
+			}
+		});
+
+		//file each pair under its lower end, then sort and merge duplicates, also in parallel
+		std::vector<size_t> offsets(n+1, 0);
+		for(size_t c=0; c<found.size(); ++c) {
+			size_t i = c*step;
+			for(size_t e=0; i<n and e<found[c].size(); ++i)
+				for(size_t end=e+counts[i+1]; e<end; ++e) ++offsets[ std::min<size_t>(i, found[c][e].other) + 1 ];
+		}
+		for(size_t i=0; i<n; ++i) offsets[i+1] += offsets[i];
+		std::vector<Pair> owned(offsets[n]);
+		std::vector<size_t> fill(offsets.begin(), offsets.end()-1);
+		for(size_t c=0; c<found.size(); ++c) {
+			size_t i = c*step;
+			for(size_t e=0; i<n and e<found[c].size(); ++i) {
+				for(size_t end=e+counts[i+1]; e<end; ++e) {
+					const Pair& x = found[c][e];
+					if(x.other > i) owned[ fill[i]++ ] = x;
+					else owned[ fill[x.other]++ ] = Pair{uint32_t(i), x.distance};
+				}
+			}
+			std::vector<Pair>().swap(found[c]);
+		}
+		//the filter and the slots below read target's links, so it is locked from here on
+		ScopedWriteLock lock(target);
+		std::vector<size_t> kept(n+1, 0);
+		pool.parallel_for(n, step, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) {
+				auto begin = owned.begin() + offsets[i], end = owned.begin() + offsets[i+1];
+				std::sort(begin, end);
+				end = std::unique(begin, end, [](const Pair& a, const Pair& b) { return a.other == b.other; });
+				end = std::remove_if(begin, end, [&](const Pair& x) { return nodes[i]->find(nodes[x.other]->ID()) != nodes[i]->end(); });
+				kept[i+1] = end - begin;
+			}
+		});
+
+		//transpose for the complements
+		std::vector<size_t> in_offsets(n+1, 0);
+		for(size_t i=0; i<n; ++i)
+			for(size_t e=offsets[i]; e<offsets[i]+kept[i+1]; ++e) ++in_offsets[ owned[e].other + 1 ];
+		for(size_t i=0; i<n; ++i) in_offsets[i+1] += in_offsets[i];
+		std::vector<uint32_t> in_sources(in_offsets[n]), in_slots(in_offsets[n]);
+		std::vector<size_t> base(n);
+		for(size_t i=0; i<n; ++i) base[i] = LinkAccess::owned(*nodes[i]).size();
+		fill.assign(in_offsets.begin(), in_offsets.end()-1);
+		for(size_t i=0; i<n; ++i) {
+			for(size_t e=offsets[i]; e<offsets[i]+kept[i+1]; ++e) {
+				size_t slot = fill[ owned[e].other ]++;
+				in_sources[slot] = i;
+				in_slots[slot] = base[i] + (e - offsets[i]);
+			}
+		}
+
+		//the links themselves, as in clone_nodes: owned ends first, then complements
+		pool.parallel_for(n, step, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) {
+				auto& links = LinkAccess::owned(*nodes[i]);
+				LinkAccess::reserve(links, kept[i+1] + in_offsets[i+1] - in_offsets[i]);
+				for(size_t e=offsets[i]; e<offsets[i]+kept[i+1]; ++e)
+					LinkAccess::append(links, link_type(nodes[owned[e].other]->ID(), V(owned[e].distance)));
+			}
+		});
+		//owned links and complements share each node's vector, so look the links up before it grows
+		std::vector<link_type*> in_links(in_offsets[n]);
+		pool.parallel_for(n, step, [&](const size_t first, const size_t last) {
+			for(size_t j=first; j<last; ++j)
+				for(size_t s=in_offsets[j]; s<in_offsets[j+1]; ++s)
+					in_links[s] = &LinkAccess::at(LinkAccess::owned(*nodes[ in_sources[s] ]), in_slots[s]);
+		});
+		pool.parallel_for(n, step, [&](const size_t first, const size_t last) {
+			for(size_t j=first; j<last; ++j) {
+				auto& links = LinkAccess::complements(*nodes[j]);
+				for(size_t s=in_offsets[j]; s<in_offsets[j+1]; ++s)
+					LinkAccess::append(links, link_type(*in_links[s], nodes[ in_sources[s] ]->ID()));
+			}
+		});
+		for(auto x : nodes) LinkAccess::touch(*x);
+		return true;
+	}
+
+	template<typename T, unsigned short N, typename V, typename R>
+	bool knn_graph(ThreadPool& pool, const Space<T,N>& space, Graph< UndirectedNode< Path<V> > >& target,
+		       const size_t k, R remap, const size_t chunk=64) {
+	/*
+		Links every Point's node to the nodes of its k nearest Points, with the distance as the
+		Path value. The node for a Point is the one in target with ID remap(Point ID); each must
+		exist already, or nothing is linked and the result is false. A pair that are among each
+		other's k nearest share one link, so a node can end up with more than k links.
+
+		Linking pairs one at a time with add costs a lookup of the other node per link, and
+		each node's links may grow many times over. Here the queries run in parallel against the Space's spatial
+		index, every node's links are counted and reserved once, and the links and then their
+		complements are appended in parallel, as in clone_nodes. target is write-locked while
+		existing links are checked and new ones added; the Space must not change during the call.
+	*/
+		const auto& index = space.spatial_index();
+		return link_proximity(pool, space, target, remap,
+			[&](const std::array<T,N>& center, const unsigned int self, std::vector<Neighbor>& output) {
+				output.resize(k + 1);
+				size_t found = index.nearest(center, k + 1, output.data());
+				output.resize(found);
+				auto iter = std::find_if(output.begin(), output.end(), [&](const Neighbor& x) { return x.id == self; });
+				if(iter != output.end()) output.erase(iter);
+				else if(output.size() > k) output.pop_back();
+			}, chunk);
+	}
+
+	template<typename T, unsigned short N, typename V, typename R>
+	bool radius_graph(ThreadPool& pool, const Space<T,N>& space, Graph< UndirectedNode< Path<V> > >& target,
+			  const double radius, R remap, const size_t chunk=64) {
+	/*
+		Links every Point's node to the nodes of all other Points within radius of it, with the
+		distance as the Path value. Otherwise the same as knn_graph.
+	*/
+		const auto& index = space.spatial_index();
+		const auto& mirror = space.coordinates();
+		return link_proximity(pool, space, target, remap,
+			[&](const std::array<T,N>& center, const unsigned int self, std::vector<Neighbor>& output) {
+				thread_local std::vector<unsigned int> addresses;
+				addresses.clear();
+				index.within(center, radius, addresses);
+				std::array<T,N> other;
+				for(auto x : addresses) {
+					if(x == self) continue;
+					mirror.find(x, other);
+					output.push_back( Neighbor{x, std::sqrt(squared_distance(center, other))} );
+				}
+			}, chunk);
+	}
+
+	//for Points and nodes with the same IDs
+	struct SameID { unsigned int operator()(const unsigned int address) const { return address; } };
+	template<typename T, unsigned short N, typename V>
+	bool knn_graph(ThreadPool& pool, const Space<T,N>& space, Graph< UndirectedNode< Path<V> > >& target, const size_t k)
+		{ return knn_graph(pool, space, target, k, SameID()); }
+	template<typename T, unsigned short N, typename V>
+	bool radius_graph(ThreadPool& pool, const Space<T,N>& space, Graph< UndirectedNode< Path<V> > >& target, const double radius)
+		{ return radius_graph(pool, space, target, radius, SameID()); }
+
+} //namespace ben
+
+#endif
+
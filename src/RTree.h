@@ -0,0 +1,521 @@
+#ifndef BenoitRTree_h
+#define BenoitRTree_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include "SpatialIndex.h"
+
+namespace ben {
+/* RTree is a SpatialIndex that groups nearby points under bounding boxes, up to fanout entries
+ * per node, and adapts to uneven density where a CellList cannot. Its nodes follow the data
+ * rather than fixed planes, so clustered points pack into tight boxes, and a region query
+ * reports whole subtrees whose boxes fall inside the region without checking their points.
+ *
+ * build packs the tree bottom-up with Sort-Tile-Recursive: the points are sorted into slabs on
+ * the first coordinate, each slab is sorted into slabs on the next, and so on, and the last
+ * coordinate is cut into full leaves. Upper levels are packed the same way from the centers of
+ * the level below. The result has nearly full nodes that barely overlap.
+ *
+ * insert descends to the leaf whose box grows least, and splits nodes that overflow at the middle
+ * of their widest coordinate. remove takes the point out of its leaf, found through a hash map,
+ * and a node left with fewer than 40% of fanout entries is dissolved and its points inserted
+ * again, as in Guttman's original R-tree. move is done in place when the point stays inside its
+ * leaf's box. fanout is held between 4 and 64.
+ */
+	template<typename T, unsigned short N>
+	class RTree : public SpatialIndex<T,N> {
+	private:
+		typedef SpatialIndex<T,N> base_type;
+		typedef RTree self_type;
+
+	public:
+		typedef typename base_type::point_type point_type;
+		typedef typename base_type::id_type id_type;
+		typedef typename base_type::region_type region_type;
+
+	private:
+		static const uint32_t none = ~uint32_t(0);
+		static const size_t most = 64;
+
+		struct RNode {
+			uint32_t parent;
+			unsigned short level; //0 for leaves
+			std::vector<uint32_t> children;
+			std::vector<id_type> ids; //leaves only, in step with points
+			std::vector<point_type> points;
+		};
+
+		std::vector<RNode> nodes;
+		std::vector<region_type> boxes; //apart from the nodes, so pruning reads less memory
+		std::vector<uint32_t> unused;
+		std::unordered_map<id_type, uint32_t> leaf_of;
+		uint32_t root;
+		size_t fanout, minimum;
+
+		static region_type empty_box() {
+			region_type box;
+			for(unsigned short i=0; i<N; ++i) {
+				box.lower[i] = std::numeric_limits<T>::max();
+				box.upper[i] = std::numeric_limits<T>::lowest();
+			}
+			return box;
+		}
+		static void extend(region_type& box, const point_type& point) {
+			for(unsigned short i=0; i<N; ++i) {
+				if(point[i] < box.lower[i]) box.lower[i] = point[i];
+				if(point[i] > box.upper[i]) box.upper[i] = point[i];
+			}
+		}
+		static void extend(region_type& box, const region_type& other) {
+			extend(box, other.lower);
+			extend(box, other.upper);
+		}
+		static double center(const region_type& box, const unsigned short i) { return 0.5*(double(box.lower[i]) + double(box.upper[i])); }
+		static double area(const region_type& box) {
+			double product = 1.0;
+			for(unsigned short i=0; i<N; ++i) product *= double(box.upper[i]) - double(box.lower[i]);
+			return product;
+		}
+		static double margin(const region_type& box) {
+			double sum = 0.0;
+			for(unsigned short i=0; i<N; ++i) sum += double(box.upper[i]) - double(box.lower[i]);
+			return sum;
+		}
+		static bool overlaps(const region_type& a, const region_type& b) {
+			for(unsigned short i=0; i<N; ++i)
+				if(a.upper[i] < b.lower[i] or b.upper[i] < a.lower[i]) return false;
+			return true;
+		}
+		static bool encloses(const region_type& outer, const region_type& inner) {
+			for(unsigned short i=0; i<N; ++i)
+				if(inner.lower[i] < outer.lower[i] or inner.upper[i] > outer.upper[i]) return false;
+			return true;
+		}
+		static double gap(const region_type& box, const point_type& point) {
+			//squared distance from point to the nearest part of box
+			double sum = 0.0;
+			for(unsigned short i=0; i<N; ++i) {
+				double x = double(point[i]), d = 0.0;
+				if(x < double(box.lower[i])) d = double(box.lower[i]) - x;
+				else if(x > double(box.upper[i])) d = x - double(box.upper[i]);
+				sum += d*d;
+			}
+			return sum;
+		}
+
+		void reset(const size_t capacity) {
+			//drops every node and its box together, leaving no root
+			nodes.clear();
+			boxes.clear();
+			unused.clear();
+			leaf_of.clear();
+			nodes.reserve(capacity);
+			boxes.reserve(capacity);
+		}
+		uint32_t allocate(const unsigned short level) {
+			uint32_t index;
+			if( unused.empty() ) {
+				index = nodes.size();
+				nodes.emplace_back();
+				boxes.emplace_back();
+			} else {
+				index = unused.back();
+				unused.pop_back();
+			}
+			RNode& x = nodes[index];
+			boxes[index] = empty_box();
+			x.parent = none;
+			x.level = level;
+			x.children.clear();
+			x.ids.clear();
+			x.points.clear();
+			return index;
+		}
+		size_t count(const uint32_t node) const {
+			return nodes[node].level == 0 ? nodes[node].ids.size() : nodes[node].children.size();
+		}
+		void refit(const uint32_t node) {
+			const RNode& x = nodes[node];
+			region_type& box = boxes[node];
+			box = empty_box();
+			for(auto& y : x.points) extend(box, y);
+			for(auto y : x.children) extend(box, boxes[y]);
+		}
+		void add_entry(const uint32_t leaf, const id_type address, const point_type& point) {
+			nodes[leaf].ids.push_back(address);
+			nodes[leaf].points.push_back(point);
+			leaf_of[address] = leaf;
+		}
+
+		template<typename K, typename E>
+		void tile(std::vector<uint32_t>& items, const size_t first, const size_t last,
+			  const unsigned short axis, K key, E emit) const;
+		uint32_t choose_leaf(const point_type& point) const;
+		void split(uint32_t node);
+		void collect(const uint32_t node, std::vector< std::pair<id_type, point_type> >& orphans);
+		void condense(uint32_t node);
+		void relayout();
+
+		void region_from(const uint32_t node, const region_type& region, std::vector<id_type>& output) const;
+		void everything_from(const uint32_t node, std::vector<id_type>& output) const;
+		void within_from(const uint32_t node, const point_type& center, const double radius,
+				 std::vector<id_type>& output) const;
+		void nearest_from(const uint32_t node, const point_type& center, const size_t k,
+				  Neighbor* heap, size_t& count) const;
+
+	public:
+		explicit RTree(const size_t node_size=16)
+			: root(none), fanout(std::min(std::max(node_size, size_t(4)), size_t(most))), minimum(fanout*2/5) { clear(); }
+		RTree(const self_type& rhs) = default;
+		self_type& operator=(const self_type& rhs) = default;
+		~RTree() = default;
+
+		void build(const std::vector< std::pair<id_type, point_type> >& points);
+		bool insert(const id_type address, const point_type& point);
+		bool remove(const id_type address);
+		bool move(const id_type address, const point_type& point);
+		void clear() {
+			reset(1);
+			root = allocate(0);
+		}
+		size_t size() const { return leaf_of.size(); }
+		size_t depth() const { return nodes[root].level + 1; }
+
+		void in_region(const region_type& region, std::vector<id_type>& output) const {
+			if( overlaps(region, boxes[root]) ) region_from(root, region, output);
+		}
+		void within(const point_type& center, const double radius, std::vector<id_type>& output) const {
+			if(radius >= 0.0 and gap(boxes[root], center) <= radius*radius) within_from(root, center, radius, output);
+		}
+		size_t nearest(const point_type& center, const size_t k, Neighbor* output) const {
+			size_t count = 0;
+			if(k > 0 and size() > 0) nearest_from(root, center, k, output, count);
+			return base_type::finish(output, count);
+		}
+	}; //class RTree
+
+	template<typename T, unsigned short N>
+	template<typename K, typename E>
+	void RTree<T,N>::tile(std::vector<uint32_t>& items, const size_t first, const size_t last,
+			      const unsigned short axis, K key, E emit) const {
+		//Sort-Tile-Recursive: calls emit(first, last) for each run of up to fanout items
+		std::sort(items.begin() + first, items.begin() + last,
+			  [&](const uint32_t a, const uint32_t b) { return key(a, axis) < key(b, axis); });
+		if(axis == N-1) {
+			for(size_t i=first; i<last; i+=fanout) emit(i, std::min(i + fanout, last));
+			return;
+		}
+		const size_t pages = (last - first + fanout - 1) / fanout;
+		const size_t slabs = size_t( std::ceil(std::pow(double(pages), 1.0 / (N - axis))) );
+		const size_t slab = fanout * ((pages + slabs - 1) / slabs);
+		for(size_t i=first; i<last; i+=slab) tile(items, i, std::min(i + slab, last), axis+1, key, emit);
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::build(const std::vector< std::pair<id_type, point_type> >& points) {
+		if( points.empty() ) {
+			clear();
+			return;
+		}
+		reset(2 * points.size() / fanout + 2);
+		leaf_of.reserve(points.size());
+
+		std::vector<uint32_t> order(points.size()), level;
+		std::iota(order.begin(), order.end(), 0);
+		tile(order, 0, order.size(), 0,
+		     [&](const uint32_t i, const unsigned short axis) { return double(points[i].second[axis]); },
+		     [&](const size_t first, const size_t last) {
+			uint32_t leaf = allocate(0);
+			for(size_t i=first; i<last; ++i) add_entry(leaf, points[order[i]].first, points[order[i]].second);
+			refit(leaf);
+			level.push_back(leaf);
+		});
+
+		unsigned short height = 0;
+		while(level.size() > 1) {
+			std::vector<uint32_t> parents;
+			++height;
+			tile(level, 0, level.size(), 0,
+			     [&](const uint32_t i, const unsigned short axis) { return center(boxes[i], axis); },
+			     [&](const size_t first, const size_t last) {
+				uint32_t parent = allocate(height);
+				for(size_t i=first; i<last; ++i) {
+					nodes[parent].children.push_back(level[i]);
+					nodes[level[i]].parent = parent;
+				}
+				refit(parent);
+				parents.push_back(parent);
+			});
+			level.swap(parents);
+		}
+		root = level.front();
+		relayout();
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::relayout() {
+		//renumbers the nodes breadth-first, so that siblings sit next to each other
+		std::vector<uint32_t> order(1, root), label(nodes.size(), uint32_t(none));
+		order.reserve(nodes.size());
+		for(size_t i=0; i<order.size(); ++i)
+			for(auto child : nodes[order[i]].children) order.push_back(child);
+		for(size_t i=0; i<order.size(); ++i) label[order[i]] = i;
+
+		std::vector<RNode> moved(order.size());
+		std::vector<region_type> moved_boxes(order.size());
+		for(size_t i=0; i<order.size(); ++i) {
+			RNode& x = moved[i];
+			x = std::move(nodes[order[i]]);
+			moved_boxes[i] = boxes[order[i]];
+			if(x.parent != none) x.parent = label[x.parent];
+			for(auto& child : x.children) child = label[child];
+			for(auto address : x.ids) leaf_of[address] = i;
+		}
+		nodes.swap(moved);
+		boxes.swap(moved_boxes);
+		unused.clear();
+		root = 0;
+	}
+
+	template<typename T, unsigned short N>
+	uint32_t RTree<T,N>::choose_leaf(const point_type& point) const {
+		//the child whose box grows least, then the one with the smaller margin growth, then area
+		uint32_t node = root;
+		while(nodes[node].level > 0) {
+			uint32_t best = none;
+			double best_growth = 0.0, best_margin = 0.0, best_area = 0.0;
+			for(auto child : nodes[node].children) {
+				const region_type& box = boxes[child];
+				region_type grown = box;
+				extend(grown, point);
+				double growth = area(grown) - area(box), margins = margin(grown) - margin(box), size = area(box);
+				if(best == none or growth < best_growth
+				   or (growth == best_growth and (margins < best_margin or (margins == best_margin and size < best_area)))) {
+					best = child;
+					best_growth = growth;
+					best_margin = margins;
+					best_area = size;
+				}
+			}
+			node = best;
+		}
+		return node;
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::split(uint32_t node) {
+		//halves overflowing nodes at the middle of their widest coordinate, up to the root
+		while(count(node) > fanout) {
+			const uint32_t sibling = allocate(nodes[node].level);
+			unsigned short axis = 0;
+			for(unsigned short i=1; i<N; ++i)
+				if(double(boxes[node].upper[i]) - double(boxes[node].lower[i])
+				   > double(boxes[node].upper[axis]) - double(boxes[node].lower[axis])) axis = i;
+
+			RNode& x = nodes[node];
+			RNode& y = nodes[sibling];
+			if(x.level == 0) {
+				std::vector<uint32_t> order(x.ids.size());
+				std::iota(order.begin(), order.end(), 0);
+				std::sort(order.begin(), order.end(),
+					  [&](const uint32_t a, const uint32_t b) { return x.points[a][axis] < x.points[b][axis]; });
+				std::vector<id_type> ids;
+				std::vector<point_type> points;
+				for(size_t i=0; i<order.size(); ++i) {
+					if(i < order.size()/2) {
+						ids.push_back(x.ids[order[i]]);
+						points.push_back(x.points[order[i]]);
+					} else {
+						y.ids.push_back(x.ids[order[i]]);
+						y.points.push_back(x.points[order[i]]);
+						leaf_of[x.ids[order[i]]] = sibling;
+					}
+				}
+				x.ids.swap(ids);
+				x.points.swap(points);
+			} else {
+				std::sort(x.children.begin(), x.children.end(), [&](const uint32_t a, const uint32_t b)
+					  { return center(boxes[a], axis) < center(boxes[b], axis); });
+				y.children.assign(x.children.begin() + x.children.size()/2, x.children.end());
+				x.children.resize(x.children.size()/2);
+				for(auto child : y.children) nodes[child].parent = sibling;
+			}
+			refit(node);
+			refit(sibling);
+
+			const uint32_t parent = nodes[node].parent;
+			if(parent == none) { //grow a new root
+				root = allocate(nodes[node].level + 1);
+				nodes[root].children = {node, sibling};
+				nodes[node].parent = nodes[sibling].parent = root;
+				refit(root);
+				return;
+			}
+			nodes[sibling].parent = parent;
+			nodes[parent].children.push_back(sibling); //the parent's box already covers both
+			node = parent;
+		}
+	}
+
+	template<typename T, unsigned short N>
+	bool RTree<T,N>::insert(const id_type address, const point_type& point) {
+		if(leaf_of.count(address) == 1) return false;
+		const uint32_t leaf = choose_leaf(point);
+		add_entry(leaf, address, point);
+		for(uint32_t node=leaf; node!=none; node=nodes[node].parent) extend(boxes[node], point);
+		split(leaf);
+		return true;
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::collect(const uint32_t node, std::vector< std::pair<id_type, point_type> >& orphans) {
+		//gathers every point under node and frees the subtree
+		RNode& x = nodes[node];
+		for(size_t i=0; i<x.ids.size(); ++i) {
+			orphans.push_back( std::make_pair(x.ids[i], x.points[i]) );
+			leaf_of.erase(x.ids[i]);
+		}
+		for(auto child : x.children) collect(child, orphans);
+		unused.push_back(node);
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::condense(uint32_t node) {
+		//dissolves underfull nodes from node up to the root, then inserts their points again
+		std::vector< std::pair<id_type, point_type> > orphans;
+		while(node != root) {
+			const uint32_t parent = nodes[node].parent;
+			if(count(node) < minimum) {
+				auto& siblings = nodes[parent].children;
+				siblings.erase( std::find(siblings.begin(), siblings.end(), node) );
+				collect(node, orphans);
+			} else refit(node);
+			node = parent;
+		}
+		refit(root);
+		while(nodes[root].level > 0 and nodes[root].children.size() <= 1) {
+			const uint32_t old = root;
+			if( nodes[root].children.empty() ) root = allocate(0);
+			else {
+				root = nodes[old].children.front();
+				nodes[root].parent = none;
+			}
+			unused.push_back(old);
+		}
+		for(auto& x : orphans) insert(x.first, x.second);
+	}
+
+	template<typename T, unsigned short N>
+	bool RTree<T,N>::remove(const id_type address) {
+		auto iter = leaf_of.find(address);
+		if(iter == leaf_of.end()) return false;
+		const uint32_t leaf = iter->second;
+		leaf_of.erase(iter);
+		RNode& x = nodes[leaf];
+		size_t i = std::find(x.ids.begin(), x.ids.end(), address) - x.ids.begin();
+		x.ids[i] = x.ids.back();
+		x.points[i] = x.points.back();
+		x.ids.pop_back();
+		x.points.pop_back();
+		condense(leaf);
+		return true;
+	}
+
+	template<typename T, unsigned short N>
+	bool RTree<T,N>::move(const id_type address, const point_type& point) {
+		auto iter = leaf_of.find(address);
+		if(iter == leaf_of.end()) return false;
+		RNode& x = nodes[iter->second];
+		region_type spot{point, point};
+		if( encloses(boxes[iter->second], spot) ) { //the box may end up looser than it has to be, never too small
+			x.points[ std::find(x.ids.begin(), x.ids.end(), address) - x.ids.begin() ] = point;
+			return true;
+		}
+		remove(address);
+		return insert(address, point);
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::everything_from(const uint32_t node, std::vector<id_type>& output) const {
+		const RNode& x = nodes[node];
+		output.insert(output.end(), x.ids.begin(), x.ids.end());
+		for(auto child : x.children) everything_from(child, output);
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::region_from(const uint32_t node, const region_type& region, std::vector<id_type>& output) const {
+		//node's box overlaps region; its children's boxes are checked here, before visiting them
+		const RNode& x = nodes[node];
+		for(size_t i=0; i<x.ids.size(); ++i) if( region.contains(x.points[i]) ) output.push_back(x.ids[i]);
+		for(auto child : x.children) {
+			if( !overlaps(region, boxes[child]) ) continue;
+			if( encloses(region, boxes[child]) ) everything_from(child, output);
+			else region_from(child, region, output);
+		}
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::within_from(const uint32_t node, const point_type& center, const double radius,
+				     std::vector<id_type>& output) const {
+		//node's box is within radius of center
+		const RNode& x = nodes[node];
+		if(x.level == 0) {
+			double squares[most];
+			distances<SquaredEuclidean>(center, x.points.data(), x.points.size(), squares);
+			for(size_t i=0; i<x.ids.size(); ++i) if(squares[i] <= radius*radius) output.push_back(x.ids[i]);
+			return;
+		}
+		for(auto child : x.children)
+			if(gap(boxes[child], center) <= radius*radius) within_from(child, center, radius, output);
+	}
+
+	template<typename T, unsigned short N>
+	void RTree<T,N>::nearest_from(const uint32_t node, const point_type& center, const size_t k,
+				      Neighbor* heap, size_t& count) const {
+		const RNode& x = nodes[node];
+		if(x.level == 0) {
+			double squares[most];
+			distances<SquaredEuclidean>(center, x.points.data(), x.points.size(), squares);
+			for(size_t i=0; i<x.ids.size(); ++i) base_type::offer(heap, count, k, x.ids[i], squares[i]);
+			return;
+		}
+		std::pair<double, uint32_t> order[most]; //children, nearest box first
+		const size_t n = x.children.size();
+		for(size_t i=0; i<n; ++i) order[i] = std::make_pair(gap(boxes[x.children[i]], center), x.children[i]);
+		std::sort(order, order + n);
+		for(size_t i=0; i<n; ++i) {
+			if(count == k and order[i].first >= heap[0].distance) break;
+			nearest_from(order[i].second, center, k, heap, count);
+		}
+	}
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,201 @@
+#ifndef BenoitSharedBuffer_h
+#define BenoitSharedBuffer_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Traits.h"
+
+namespace ben {
+/* A SharedBuffer passes signals between processes on one machine. Its storage lives in a POSIX
+ * shared-memory segment, so an OutPort in one process and an InPort in another can share a
+ * channel by name, with one copy into the ring and one out of it:
+ *
+ * 	//process A, in its Graph
+ * 	node.add_output(target, std::string("/signals"));
+ * 	//process B, standalone
+ * 	InPort< SharedBuffer<double,8> > input(source, std::string("/signals"));
+ *
+ * Whichever side opens the name first creates the segment; both must agree on the signal type
+ * and length, or the second one fails to open and is_open() is false. Segments outlive the
+ * processes that use them until SharedBuffer::unlink(name) is called. A default-constructed
+ * SharedBuffer (which is what Port::clone makes) maps an anonymous segment instead, which is
+ * shared only with processes forked after it was created.
+ *
+ * The interface is Buffer's, but the storage is a ring of the last B signals rather than a delay
+ * line: pull returns the oldest unread signal as soon as it has been pushed, and push returns
+ * false if it overwrote one that was never read. For B=1 this is exactly Buffer<S,1>. There
+ * must be one pushing and one pulling thread (in any processes). Neither ever waits on the
+ * other. Each slot has a seqlock stamp, and signals are copied as 64-bit atomic words, so a
+ * reader that was lapped by the writer notices and moves on. Signals must therefore be
+ * trivially copyable, and nothing in the segment may hold a pointer.
+ */
+	template<typename S, unsigned short B>
+	class SharedBuffer {
+	public:
+		typedef S signal_type;
+		typedef ConstructionTypes<std::string> construction_types;
+		static_assert(std::is_trivially_copyable<signal_type>::value,
+			      "signals passed through shared memory must be trivially copyable");
+		static_assert(B > 0, "SharedBuffer needs room for at least one signal");
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "SharedBuffer needs address-free 64-bit atomics");
+
+	private:
+		typedef SharedBuffer self_type;
+		static const size_t words = (sizeof(signal_type) + 7) / 8;
+		static const uint64_t magic = 0x4245534842554631ull; //"BESHBUF1"
+
+		struct Slot {
+			std::atomic<uint64_t> stamp; //2*sequence+1 while being written, 2*sequence+2 once written
+			std::atomic<uint64_t> data[words];
+		};
+		struct Segment {
+			std::atomic<uint64_t> ready; //magic, once the creator has initialized everything else
+			uint32_t length, signal_size;
+			alignas(64) std::atomic<uint64_t> head; //sequence number of the next push
+			alignas(64) std::atomic<uint64_t> tail; //sequence number of the next pull
+			alignas(64) Slot slots[B];
+		};
+
+		Segment* segment;
+		std::string name;
+
+		static void initialize(Segment* ptr) {
+			ptr->length = B;
+			ptr->signal_size = sizeof(signal_type);
+			new(&ptr->head) std::atomic<uint64_t>(0);
+			new(&ptr->tail) std::atomic<uint64_t>(0);
+			for(auto& x : ptr->slots) {
+				new(&x.stamp) std::atomic<uint64_t>(0);
+				for(auto& y : x.data) new(&y) std::atomic<uint64_t>(0);
+			}
+			ptr->ready.store(magic, std::memory_order_release); //the segment starts zeroed, so this is last
+		}
+
+		bool open(const std::string& channel) {
+			name = channel.empty() or channel[0] != '/' ? "/" + channel : channel;
+			bool creator = true;
+			int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			if(fd < 0) {
+				creator = false;
+				fd = shm_open(name.c_str(), O_RDWR, 0600);
+				if(fd < 0) return false;
+			}
+			struct stat info;
+			if(creator) {
+				if( ftruncate(fd, sizeof(Segment)) != 0 ) { ::close(fd); shm_unlink(name.c_str()); return false; }
+			} else {
+				//the creator may not have sized the segment yet
+				int tries = 0;
+				while( fstat(fd, &info) == 0 and info.st_size == 0 and ++tries < 100000 ) std::this_thread::yield();
+				if( fstat(fd, &info) != 0 or size_t(info.st_size) != sizeof(Segment) ) { ::close(fd); return false; }
+			}
+			void* ptr = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd); //the mapping keeps the segment open
+			if(ptr == MAP_FAILED) return false;
+			segment = static_cast<Segment*>(ptr);
+			if(creator) initialize(segment);
+			else {
+				int tries = 0;
+				while( segment->ready.load(std::memory_order_acquire) != magic and ++tries < 100000 ) std::this_thread::yield();
+				if( segment->ready.load(std::memory_order_acquire) != magic
+				    or segment->length != B or segment->signal_size != sizeof(signal_type) ) {
+					munmap(segment, sizeof(Segment));
+					segment = nullptr;
+					return false;
+				}
+			}
+			return true;
+		}
+
+	public:
+		SharedBuffer() noexcept : segment(nullptr) {
+			void* ptr = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+			if(ptr != MAP_FAILED) {
+				segment = static_cast<Segment*>(ptr);
+				initialize(segment);
+			}
+		}
+		explicit SharedBuffer(const std::string& channel) noexcept : segment(nullptr) { open(channel); }
+		SharedBuffer(const self_type& rhs) = delete;
+		self_type& operator=(const self_type& rhs) = delete;
+		~SharedBuffer() noexcept { if(segment != nullptr) munmap(segment, sizeof(Segment)); }
+
+		static bool unlink(const std::string& channel) {
+			//removes the name; processes that have it open keep using the segment
+			std::string full = channel.empty() or channel[0] != '/' ? "/" + channel : channel;
+			return shm_unlink(full.c_str()) == 0;
+		}
+
+		bool is_open() const { return segment != nullptr; }
+		const std::string& channel() const { return name; } //empty for anonymous segments
+
+		bool push(const signal_type& signal) { //returns false if an unread signal is overwritten
+			if(segment == nullptr) return false;
+			const uint64_t sequence = segment->head.load(std::memory_order_relaxed); //only this thread writes head
+			Slot& slot = segment->slots[sequence % B];
+			uint64_t temp[words] = {};
+			std::memcpy(temp, &signal, sizeof(signal_type));
+			slot.stamp.store(2*sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			for(size_t i=0; i<words; ++i) slot.data[i].store(temp[i], std::memory_order_relaxed);
+			slot.stamp.store(2*sequence + 2, std::memory_order_release);
+			segment->head.store(sequence + 1, std::memory_order_release);
+			const uint64_t read = segment->tail.load(std::memory_order_acquire); //may already include this one
+			return read > sequence or sequence - read < B;
+		}
+
+		bool pull(signal_type& signal) {
+			if(segment == nullptr) return false;
+			uint64_t sequence = segment->tail.load(std::memory_order_relaxed); //only this thread writes tail
+			while(true) {
+				const uint64_t last = segment->head.load(std::memory_order_acquire);
+				if(sequence == last) return false;
+				if(last - sequence > B) sequence = last - B; //skip what has been overwritten
+				const Slot& slot = segment->slots[sequence % B];
+				const uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+				uint64_t temp[words];
+				for(size_t i=0; i<words; ++i) temp[i] = slot.data[i].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if( stamp != 2*sequence + 2 or slot.stamp.load(std::memory_order_relaxed) != stamp ) {
+					++sequence; //lapped by the writer, so this signal is gone
+					continue;
+				}
+				std::memcpy(&signal, temp, sizeof(signal_type));
+				segment->tail.store(sequence + 1, std::memory_order_release);
+				return true;
+			}
+		}
+	}; //class SharedBuffer
+
+} //namespace ben
+
+#endif
+
@@ -0,0 +1,281 @@
+#ifndef BenoitSnapshot_h
+#define BenoitSnapshot_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <fstream>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Graph.h"
+#include "CSR.h"
+
+namespace ben {
+/* A snapshot is a binary image of a whole Graph: node IDs, links and, for Path links, their values.
+ * It is written sequentially by write_snapshot and read back through SnapshotView, which maps the
+ * file into memory. Nothing is parsed or copied when a view opens, so a snapshot can be queried as
+ * soon as the header checks out, and the OS pages in only the parts that are touched. Opening
+ * checks only that the sections lie inside the file; validate reads the offsets and targets as
+ * well, which a file from an untrusted source needs before it is queried. Nodes are built only
+ * when materialize is called, into whatever container the caller chooses, after validating.
+ *
+ * Layout (native byte order, every section starting on an 8-byte boundary):
+ * 	SnapshotHeader
+ * 	node IDs	uint32 x nodes, sorted
+ * 	offsets		uint64 x (nodes+1), into the target array
+ * 	targets		uint32 x links, positions in the ID array
+ * 	values		value_size bytes x links, absent if value_size is 0
+ *
+ * Directed graphs list each link once, under its source. Undirected graphs list each link under
+ * both ends, as CSR does. Buffer contents are not saved: a Buffer can only be read by pulling from
+ * it, which would destroy the state being saved, so Port links come back empty.
+ */
+	struct SnapshotHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t directed;
+		uint64_t nodes;
+		uint64_t links;
+		uint32_t value_size;
+		uint32_t reserved;
+		uint64_t id_offset, offset_offset, target_offset, value_offset; //byte positions of sections
+	}; //struct SnapshotHeader
+
+	const char snapshot_magic[8] = {'B','E','N','O','I','T','S','N'};
+	const uint32_t snapshot_version = 1;
+
+	template<typename N>
+	bool write_snapshot(const Graph<N>& graph, const std::string& filename) {
+		//returns false if the file couldn't be written
+		typedef typename link_types<N>::output_type link_type;
+		typedef link_value<link_type> value_traits;
+		typedef typename value_traits::type value_type;
+		static_assert(std::is_trivially_copyable<value_type>::value,
+			      "snapshots need trivially copyable Path values");
+
+		auto weight = [](const link_type& x) { return value_traits::get(x); };
+		CSR<value_type> csr(graph, Direction::outgoing, weight, weight);
+
+		auto align = [](const uint64_t x) { return (x + 7) & ~uint64_t(7); };
+		SnapshotHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+		header.version = snapshot_version;
+		header.directed = link_types<N>::directed;
+		header.nodes = csr.size();
+		header.links = csr.edges();
+		header.value_size = value_traits::stored ? sizeof(value_type) : 0;
+		header.id_offset = align(sizeof(header));
+		header.offset_offset = align(header.id_offset + header.nodes*sizeof(uint32_t));
+		header.target_offset = align(header.offset_offset + (header.nodes+1)*sizeof(uint64_t));
+		header.value_offset = align(header.target_offset + header.links*sizeof(uint32_t));
+
+		std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+		if(!out) return false;
+		uint64_t written = 0;
+		auto put = [&](const void* data, const uint64_t bytes) {
+			out.write(static_cast<const char*>(data), bytes);
+			written += bytes;
+		};
+		auto pad_to = [&](const uint64_t position) {
+			static const char zeros[8] = {0};
+			put(zeros, position - written);
+		};
+
+		put(&header, sizeof(header));
+		pad_to(header.id_offset);
+		for(auto x : csr.id_array()) { uint32_t id = x; put(&id, sizeof(id)); }
+		pad_to(header.offset_offset);
+		for(auto x : csr.offset_array()) { uint64_t offset = x; put(&offset, sizeof(offset)); }
+		pad_to(header.target_offset);
+		put(csr.target_array().data(), header.links*sizeof(uint32_t));
+		if(header.value_size > 0) {
+			pad_to(header.value_offset);
+			put(csr.weight_array().data(), header.links*sizeof(value_type));
+		}
+		return bool(out.flush());
+	}
+
+
+	class SnapshotView {
+	/*
+		Read-only, memory-mapped access to a snapshot file. All accessors read straight
+		from the mapping. Moving a view transfers the mapping; copying is not allowed.
+	*/
+	public:
+		typedef uint32_t id_type;
+		typedef uint32_t index_type;
+
+	private:
+		typedef SnapshotView self_type;
+		const char* data;
+		size_t length;
+		const SnapshotHeader* header;
+		const uint32_t* ids;
+		const uint64_t* offsets;
+		const uint32_t* targets;
+		const char* values;
+
+		void unmap() {
+			if(data) munmap(const_cast<char*>(data), length);
+			data = nullptr;
+			header = nullptr;
+		}
+
+	public:
+		SnapshotView() : data(nullptr), length(0), header(nullptr), ids(nullptr),
+				 offsets(nullptr), targets(nullptr), values(nullptr) {}
+		explicit SnapshotView(const std::string& filename) : SnapshotView() { open(filename); }
+		SnapshotView(const self_type& rhs) = delete;
+		self_type& operator=(const self_type& rhs) = delete;
+		SnapshotView(self_type&& rhs) : SnapshotView() { *this = std::move(rhs); }
+		self_type& operator=(self_type&& rhs) {
+			if(this != &rhs) {
+				unmap();
+				data = rhs.data; length = rhs.length; header = rhs.header; ids = rhs.ids;
+				offsets = rhs.offsets; targets = rhs.targets; values = rhs.values;
+				rhs.data = nullptr;
+				rhs.header = nullptr;
+			}
+			return *this;
+		}
+		~SnapshotView() { unmap(); }
+
+		bool open(const std::string& filename) {
+			//returns false if the file is missing, truncated, or not a snapshot of this version
+			//only the header is read, so the links may still be inconsistent; see validate
+			unmap();
+			int fd = ::open(filename.c_str(), O_RDONLY);
+			if(fd < 0) return false;
+			struct stat info;
+			if( fstat(fd, &info) != 0 or size_t(info.st_size) < sizeof(SnapshotHeader) ) { ::close(fd); return false; }
+			length = info.st_size;
+			void* ptr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd); //the mapping keeps the file open
+			if(ptr == MAP_FAILED) return false;
+			data = static_cast<const char*>(ptr);
+			header = reinterpret_cast<const SnapshotHeader*>(data);
+
+			auto fits = [&](const uint64_t offset, const uint64_t count, const uint64_t size) {
+				//an 8-byte aligned section of count elements inside the file, without overflow
+				if(offset % 8 != 0 or offset < sizeof(SnapshotHeader) or offset > length) return false;
+				return size == 0 or count <= (length - offset) / size;
+			};
+			bool valid = std::memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) == 0
+				 and header->version == snapshot_version
+				 and header->nodes < std::numeric_limits<uint64_t>::max()
+				 and fits(header->id_offset, header->nodes, sizeof(uint32_t))
+				 and fits(header->offset_offset, header->nodes + 1, sizeof(uint64_t))
+				 and fits(header->target_offset, header->links, sizeof(uint32_t))
+				 and (header->value_size == 0 or fits(header->value_offset, header->links, header->value_size));
+			if(!valid) { unmap(); return false; }
+			ids = reinterpret_cast<const uint32_t*>(data + header->id_offset);
+			offsets = reinterpret_cast<const uint64_t*>(data + header->offset_offset);
+			targets = reinterpret_cast<const uint32_t*>(data + header->target_offset);
+			values = data + header->value_offset;
+			return true;
+		}
+		bool is_open() const { return header != nullptr; }
+		bool validate() const {
+			//true if every node's links lie inside the target section and point at nodes
+			//reads every offset and target, so it costs a pass over the whole file
+			if( !is_open() ) return false;
+			bool valid = offsets[0] == 0 and offsets[header->nodes] == header->links;
+			for(uint64_t i=0; valid and i<header->nodes; ++i) valid = offsets[i] <= offsets[i+1];
+			for(uint64_t e=0; valid and e<header->links; ++e) valid = targets[e] < header->nodes;
+			return valid;
+		}
+
+		size_t size() const { return header->nodes; }
+		size_t links() const { return header->links; }
+		bool directed() const { return header->directed != 0; }
+		size_t value_size() const { return header->value_size; }
+
+		id_type id(const index_type i) const { return ids[i]; }
+		index_type position(const id_type address) const {
+			//returns size() if absent
+			const uint32_t* first = ids;
+			const uint32_t* last = ids + size();
+			auto iter = std::lower_bound(first, last, address);
+			if(iter != last and *iter == address) return iter - first;
+			else return size();
+		}
+		size_t degree(const index_type i) const { return offsets[i+1] - offsets[i]; }
+		const index_type* begin(const index_type i) const { return targets + offsets[i]; }
+		const index_type* end(const index_type i) const { return targets + offsets[i+1]; }
+
+		template<typename V>
+		V value(const index_type i, const size_t k) const {
+			//value of the kth link of node i; V must be the type the snapshot was written with
+			V v;
+			std::memcpy(&v, values + (offsets[i] + k)*sizeof(V), sizeof(V));
+			return v;
+		}
+
+		template<typename N, typename F>
+		bool materialize(const std::shared_ptr< Graph<N> >& graph, F make_node) const;
+	}; //class SnapshotView
+
+	template<typename N, typename F>
+	bool SnapshotView::materialize(const std::shared_ptr< Graph<N> >& graph, F make_node) const {
+	//Builds the snapshot's nodes and links in graph. make_node(graph, id) must construct a node
+	//with that ID in graph, in storage the caller owns, and return a reference to it. Returns false
+	//if the snapshot doesn't fit N, or if any node or link couldn't be added.
+		typedef typename link_types<N>::output_type link_type;
+		typedef link_value<link_type> value_traits;
+		typedef typename value_traits::type value_type;
+		if( !is_open() or directed() != link_types<N>::directed ) return false;
+		if( value_size() != (value_traits::stored ? sizeof(value_type) : 0) or !validate() ) return false;
+
+		std::vector<N*> nodes(size());
+		for(index_type i=0; i<size(); ++i) {
+			nodes[i] = &make_node(graph, id(i));
+			if(nodes[i]->ID() != id(i) or nodes[i]->get_index() != graph) return false;
+		}
+		bool status = true;
+		for(index_type i=0; i<size(); ++i) {
+			bool self_seen = false;
+			for(size_t k=0; k<degree(i); ++k) {
+				index_type j = begin(i)[k];
+				if( !link_types<N>::directed and j < i ) continue; //undirected links are listed twice
+				if( !link_types<N>::directed and j == i ) { //and so are links to self, under the same node
+					if(self_seen) continue;
+					self_seen = true;
+				}
+				status = add_link(*nodes[i], id(j), value<value_type>(i, k)) and status;
+			}
+		}
+		return status;
+	}
+
+} //namespace ben
+
+#endif
+
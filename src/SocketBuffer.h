@@ -0,0 +1,330 @@
+#ifndef BenoitSocketBuffer_h
+#define BenoitSocketBuffer_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <algorithm>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <type_traits>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include "Traits.h"
+
+namespace ben {
+/* A SocketBuffer carries signals from an OutPort in one process to an InPort in another, over a
+ * Unix-domain socket or loopback TCP. It is a Buffer like any other, so the Ports, LinkManager and
+ * DirectedNode don't know the difference:
+ *
+ * 	//process A, in its Graph
+ * 	node.add_output(target, std::string("/tmp/benoit.sock"));	//or "tcp://127.0.0.1:5555"
+ * 	//process B, standalone
+ * 	InPort< SocketBuffer<double,64> > input(source, std::string("/tmp/benoit.sock"));
+ *
+ * The side that pulls listens on the address, and the side that pushes connects to it. Both
+ * happen lazily, on the first pull or push, and nothing ever blocks: push queues the signal, a
+ * connection that isn't up yet is finished on a later push or flush, and pull returns false when
+ * nothing has arrived. Pushed signals are sent in batches, with one
+ * sendmsg per batch, once B/2 of them are queued (every push when B is 1). OutPort::flush sends
+ * whatever is queued; call it when a burst of pushes is done. If the connection drops, the
+ * sender reconnects on a later push or flush, at most every 10 ms, and the listener accepts the
+ * new connection once the old one is closed.
+ *
+ * As with Buffer, each end holds at most B signals. When a queue is full the oldest signal is
+ * dropped, and push returns false. Signals in flight when a connection drops are lost, too.
+ * Signals are sent as raw bytes, so they must be trivially copyable and both processes must
+ * agree on their layout; each connection starts with a greeting that checks their size. There
+ * should be one pushing thread and one pulling thread. A default-constructed SocketBuffer (as
+ * made by Port::clone) has no address and passes nothing.
+ */
+	template<typename S, unsigned short B>
+	class SocketBuffer {
+	public:
+		typedef S signal_type;
+		typedef ConstructionTypes<std::string> construction_types;
+		static_assert(std::is_trivially_copyable<signal_type>::value,
+			      "signals sent through sockets must be trivially copyable");
+		static_assert(std::is_default_constructible<signal_type>::value,
+			      "signals should be default-constructible");
+		static_assert(B > 0, "SocketBuffer needs room for at least one signal");
+
+	private:
+		typedef SocketBuffer self_type;
+		typedef std::chrono::steady_clock clock_type;
+		struct Greeting {
+			uint32_t magic, signal_size;
+		};
+		static const uint32_t magic = 0x42454e53; //"BENS"
+		static const size_t batch = B > 1 ? B/2 : 1;
+
+		std::string address;
+		sockaddr_storage peer;
+		socklen_t peer_length;
+		bool valid;
+
+		//pushing side
+		int out_fd;
+		bool connecting; //out_fd is waiting for a nonblocking connect to finish
+		std::array<signal_type, B> out_queue;
+		size_t out_first, out_count;
+		Greeting greeting;
+		size_t greeting_sent; //bytes of the greeting sent on this connection
+		char partial[sizeof(signal_type)]; //the unsent end of a signal sendmsg split
+		size_t partial_first, partial_size;
+		clock_type::time_point next_attempt;
+
+		//pulling side
+		int listen_fd, in_fd;
+		bool in_greeted;
+		std::unique_ptr<char[]> staging;
+		size_t staged;
+		std::array<signal_type, B> in_queue;
+		size_t in_first, in_count;
+
+		bool parse_address() {
+			std::memset(&peer, 0, sizeof(peer));
+			if(address.compare(0, 6, "tcp://") == 0) {
+				size_t colon = address.rfind(':');
+				if(colon == std::string::npos or colon < 6) return false;
+				sockaddr_in* inet = reinterpret_cast<sockaddr_in*>(&peer);
+				inet->sin_family = AF_INET;
+				inet->sin_port = htons( std::atoi(address.c_str() + colon + 1) );
+				if( inet_pton(AF_INET, address.substr(6, colon - 6).c_str(), &inet->sin_addr) != 1 ) return false;
+				peer_length = sizeof(sockaddr_in);
+			} else {
+				sockaddr_un* local = reinterpret_cast<sockaddr_un*>(&peer);
+				if( address.empty() or address.size() >= sizeof(local->sun_path) ) return false;
+				local->sun_family = AF_UNIX;
+				std::strcpy(local->sun_path, address.c_str());
+				peer_length = sizeof(sockaddr_un);
+			}
+			return true;
+		}
+		bool is_tcp() const { return peer.ss_family == AF_INET; }
+		static bool would_block() { return errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR; }
+
+		bool connect_peer() {
+			//a nonblocking connect, started at most every 10 ms; true once the connection is up
+			if(connecting) {
+				pollfd ready{out_fd, POLLOUT, 0};
+				if( poll(&ready, 1, 0) == 0 ) return false; //still in progress
+				int error = 0;
+				socklen_t length = sizeof(error);
+				if( getsockopt(out_fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 or error != 0 ) {
+					disconnect();
+					return false;
+				}
+				connecting = false;
+				return true;
+			}
+			if(clock_type::now() < next_attempt) return false;
+			next_attempt = clock_type::now() + std::chrono::milliseconds(10);
+			int fd = socket(peer.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if(fd < 0) return false;
+			if( is_tcp() ) {
+				int on = 1; //batching is done here
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+			}
+			out_fd = fd;
+			greeting_sent = 0;
+			if( connect(fd, reinterpret_cast<sockaddr*>(&peer), peer_length) == 0 ) return true;
+			if(errno == EINPROGRESS) connecting = true; //finished on a later push or flush
+			else disconnect(); //refused, or EAGAIN from a full Unix-domain backlog: retry later
+			return false;
+		}
+		void disconnect() {
+			::close(out_fd);
+			out_fd = -1;
+			connecting = false;
+			partial_size = 0; //the listener drops a signal cut off by a closed connection
+		}
+		bool send_queued() {
+			//one sendmsg for the greeting, any split signal and the queue; true if nothing is left
+			if((out_fd < 0 or connecting) and !connect_peer()) return false;
+			iovec parts[4];
+			int n = 0;
+			if(greeting_sent < sizeof(Greeting))
+				parts[n++] = iovec{reinterpret_cast<char*>(&greeting) + greeting_sent, sizeof(Greeting) - greeting_sent};
+			if(partial_size > 0) parts[n++] = iovec{partial + partial_first, partial_size};
+			const size_t wrapped = out_first + out_count > B ? out_first + out_count - B : 0;
+			if(out_count > wrapped) parts[n++] = iovec{&out_queue[out_first], (out_count - wrapped)*sizeof(signal_type)};
+			if(wrapped > 0) parts[n++] = iovec{&out_queue[0], wrapped*sizeof(signal_type)};
+			if(n == 0) return true;
+
+			msghdr message;
+			std::memset(&message, 0, sizeof(message));
+			message.msg_iov = parts;
+			message.msg_iovlen = n;
+			ssize_t sent = sendmsg(out_fd, &message, MSG_NOSIGNAL);
+			if(sent < 0) {
+				if( !would_block() ) disconnect();
+				return false;
+			}
+			size_t used = std::min(size_t(sent), sizeof(Greeting) - greeting_sent);
+			greeting_sent += used;
+			sent -= used;
+			used = std::min(size_t(sent), partial_size);
+			partial_first += used;
+			partial_size -= used;
+			sent -= used;
+			while(sent > 0) {
+				if(size_t(sent) < sizeof(signal_type)) { //keep the rest of a split signal
+					partial_first = sent;
+					partial_size = sizeof(signal_type) - sent;
+					std::memcpy(partial, &out_queue[out_first], sizeof(signal_type));
+					sent = 0;
+				} else sent -= sizeof(signal_type);
+				out_first = (out_first + 1) % B;
+				--out_count;
+			}
+			return out_count == 0 and partial_size == 0 and greeting_sent == sizeof(Greeting);
+		}
+
+		bool start_listening() {
+			int fd = socket(peer.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if(fd < 0) return false;
+			int on = 1;
+			if( is_tcp() ) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			else ::unlink(address.c_str()); //a stale socket file from a listener that didn't clean up
+			if( bind(fd, reinterpret_cast<sockaddr*>(&peer), peer_length) != 0 or listen(fd, 4) != 0 ) {
+				::close(fd);
+				return false;
+			}
+			listen_fd = fd;
+			return true;
+		}
+		void receive() {
+			//reads at most B signals, and only into an empty queue
+			if(listen_fd < 0 and !start_listening()) return;
+			while(true) {
+				if(in_fd < 0) {
+					in_fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+					if(in_fd < 0) return;
+					in_greeted = false;
+					staged = 0;
+				}
+				if(in_greeted and in_count == B) return;
+				//the greeting alone, then no more than the free slots in the queue can hold
+				const size_t wanted = in_greeted ? (B - in_count)*sizeof(signal_type) : sizeof(Greeting);
+				ssize_t got = recv(in_fd, staging.get() + staged, wanted - staged, 0);
+				if(got < 0 and would_block()) return;
+				if(got <= 0) { //the sender closed or lost the connection; look for the next one
+					::close(in_fd);
+					in_fd = -1;
+					continue;
+				}
+				staged += got;
+				if(!in_greeted) {
+					if(staged < sizeof(Greeting)) return;
+					Greeting hello;
+					std::memcpy(&hello, staging.get(), sizeof(Greeting));
+					if(hello.magic != magic or hello.signal_size != sizeof(signal_type)) {
+						::close(in_fd);
+						in_fd = -1;
+						continue;
+					}
+					in_greeted = true;
+					staged = 0;
+					continue; //now the signals
+				}
+				size_t position = 0;
+				for(; in_count < B and staged - position >= sizeof(signal_type); position += sizeof(signal_type)) {
+					std::memcpy(&in_queue[(in_first + in_count) % B], staging.get() + position, sizeof(signal_type));
+					++in_count;
+				}
+				std::memmove(staging.get(), staging.get() + position, staged - position);
+				staged -= position;
+				return;
+			}
+		}
+
+	public:
+		SocketBuffer() noexcept : SocketBuffer(std::string()) {}
+		explicit SocketBuffer(const std::string& channel) noexcept
+			: address(channel), peer_length(0), valid(false), out_fd(-1), connecting(false), out_queue(), out_first(0), out_count(0),
+			  greeting{magic, uint32_t(sizeof(signal_type))}, greeting_sent(0), partial_first(0), partial_size(0),
+			  next_attempt(clock_type::now()), listen_fd(-1), in_fd(-1), in_greeted(false), staged(0),
+			  in_queue(), in_first(0), in_count(0) {
+			if( !address.empty() ) valid = parse_address();
+			if(valid) staging.reset(new char[sizeof(Greeting) + B*sizeof(signal_type)]);
+		}
+		SocketBuffer(const self_type& rhs) = delete;
+		self_type& operator=(const self_type& rhs) = delete;
+		~SocketBuffer() noexcept {
+			if(out_fd >= 0) {
+				send_queued();
+				::close(out_fd);
+			}
+			if(in_fd >= 0) ::close(in_fd);
+			if(listen_fd >= 0) {
+				::close(listen_fd);
+				if( !is_tcp() ) ::unlink(address.c_str());
+			}
+		}
+
+		bool is_open() const { return valid; } //whether the address could be parsed
+		bool is_connected() const { return (out_fd >= 0 and !connecting) or in_fd >= 0; }
+		const std::string& channel() const { return address; }
+		size_t queued() const { return out_count + (partial_size > 0 ? 1 : 0); } //pushed but not yet sent
+
+		bool push(const signal_type& signal) { //returns false if an unsent signal is dropped
+			if(!valid) return false;
+			bool kept = true;
+			if(out_count == B) {
+				out_first = (out_first + 1) % B;
+				--out_count;
+				kept = false;
+			}
+			out_queue[(out_first + out_count) % B] = signal;
+			++out_count;
+			if(out_count >= batch) send_queued();
+			return kept;
+		}
+		bool flush() { return valid and send_queued(); } //true if everything pushed has been sent
+
+		bool pull(signal_type& signal) {
+			if(!valid) return false;
+			if(in_count == 0) receive();
+			if(in_count == 0) return false;
+			signal = in_queue[in_first];
+			in_first = (in_first + 1) % B;
+			--in_count;
+			return true;
+		}
+	}; //class SocketBuffer
+
+} //namespace ben
+
+#endif
+
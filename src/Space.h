@@ -17,20 +17,56 @@
 
 	You should have received a copy of the GNU General Public License
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
-	
+
 	The author may be reached at jackhall@utexas.edu.
 */
 
-#include <map>
-#include <set>
-#include "src/Region.h"
-#include "src/Point.h"
-#include "src/Interval.h"
-#include "src/Commons.h"
+#include <array>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <unordered_set>
+#include <limits>
+#include "Index.h"
 #include "Point.h"
+#include "SpatialIndex.h"
+#include "KDTree.h"
+#include "CoordinateArray.h"
+#include "Morton.h"
+#include "ThreadPool.h"
 
 namespace ben {
-
+/* Space is the Index of a set of Points, as Graph is the Index of a set of nodes. Like Graph, it does
+ * not own its Points. Geometric queries go through a SpatialIndex, a KDTree by default, which keeps
+ * its own copy of every Point's coordinates. Queries return IDs; use elem or find to get the Points.
+ * Each Space can use a different SpatialIndex: pass one to the constructor, or swap it in later with
+ * set_spatial_index. A CellList is the better choice when most queries are within with one radius.
+ * A MortonIndex keeps the Points sorted along a Z-order curve, so region queries are short scans.
+ * Space also mirrors all coordinates in a CoordinateArray, which keeps them in contiguous columns
+ * and is kept in step with the spatial index. coordinates() returns it for linear scans, which
+ * read memory in order instead of visiting Points scattered across the heap.
+ *
+ * Points that join the Space are put in the spatial index and the mirror lazily, before the next
+ * query, and Points that leave are taken out of both right away. Points moved with Point::move_to or
+ * Point::set tell the Space through moved, which queues them the same way; so does calling moved
+ * yourself after writing coordinates through operator[]. The next query applies everything queued
+ * in one pass, patching each Point in place, or rebuilds both in bulk if more than half of the
+ * Points are queued. Because of that, the first query after Points join or move changes the
+ * index, and queries are only safe to run concurrently once one has run since the last change. A
+ * Point is queued only once, however often it moves between queries. update_data rebuilds both
+ * from every Point, for when you don't know which ones moved.
+ *
+ * knn answers a batch of nearest-neighbor queries on a ThreadPool, all against the same index, and
+ * writes k Neighbors per query into one flat array the caller allocates: query i gets
+ * output[i*k] through output[i*k + k-1], closest first. If the Space has fewer than k Points, the
+ * slots past the last one get the largest possible ID and an infinite distance. The queries
+ * themselves allocate nothing, so the caller can reuse the array from one batch to the next.
+ *
+ * morton_ordering lists the Point IDs along a Z-order curve, so that Points near each other in
+ * space are mostly near each other in the list. It comes straight from a MortonIndex if that is the
+ * spatial index, and is sorted from the mirror otherwise. Use it to lay out or split anything keyed
+ * by Point, such as the starting blocks of a Partition of a graph over the Points.
+ */
 	template<typename T, unsigned short N>
 	class Space : public Index< Point<T,N> > {
 	private:
@@ -39,233 +75,177 @@ namespace ben {
 
 	public:
 		typedef T coordinate_type;
-		typedef PointAlias<T,N> alias_type;
-		typedef wayne::Point<T,N> raw_point_type;
-		typedef typename std::set<singleton_type>::iterator iterator;
+		typedef typename base_type::singleton_type singleton_type;
+		typedef typename base_type::id_type id_type;
+		typedef std::array<T,N> raw_point_type;
+		typedef Box<T,N> region_type;
+		typedef SpatialIndex<T,N> spatial_type;
+		typedef CoordinateArray<T,N> mirror_type;
 		static const unsigned short dimensions = N;
+
 	private:
-		//TMP tricks - these are kind of awkward for weird compilation reasons,
-		//but they remove increment and comparison computions from loops
-		template<unsigned short M=0, typename dummy=void> struct get_low_point {
-			static void call(const wayne::Region<T,N>& region, 
-					 raw_point_type& point) {
-				point.template elem<M>() = region.template elem<M>().lower;
-				get_low_point<M+1>::call(region, point);
-			}
-		};
-		
-		template<typename dummy> struct get_low_point<N-1,dummy> {
-			static void call(const wayne::Region<T,N>& region, 
-					 raw_point_type& point) {
-				point.template elem<N-1>() = region.template elem<N-1>().lower;
-			}
-		};
-		//-----
-		template<unsigned short M=0, typename dummy=void> struct get_high_point {
-			static void call(const wayne::Region<T,N>& region,
-					 raw_point_type& point) {
-				point.template elem<M>() = region.template elem<M>().upper;
-				get_high_point<M+1>::call(region, point);
-			}
-		};
-	
-		template<typename dummy> struct get_high_point<N-1,dummy> {
-			static void call(const wayne::Region<T,N>& region,
-					 raw_point_type& point) {
-				point.template elem<N-1>() = region.template elem<N-1>().upper;
-			}
-		};
-		//-----
-		template<unsigned short M=0, typename dummy=void> struct get_region_around{
-			static void call(const raw_point_type& point, 
-					 const double radius, 
-					 wayne::Region<T,N>& region) {
-				region.template elem<M>().lower = point.template elem<M>() - radius;
-				region.template elem<M>().upper = point.template elem<M>() + radius;
-				get_region_around<M+1>::call(point, radius, region);
-			}
-		};
-	
-		template<typename dummy> struct get_region_around<N-1,dummy> {
-			static void call(const raw_point_type& point, 
-					 const double radius, 
-					 wayne::Region<T,N>& region) {
-				region.template elem<N-1>().lower = point.template elem<N-1>() - radius;
-				region.template elem<N-1>().upper = point.template elem<N-1>() + radius;
-			}
-		};	
-		
-		std::set<alias_type> points;
-		
+		std::unique_ptr<spatial_type> spatial;
+		mutable mirror_type mirror;
+		mutable std::vector<id_type> pending; //joined or moved since the last query, each once
+		mutable std::unordered_set<id_type> queued; //the IDs in pending
+
+		void queue(const id_type address) { if( queued.insert(address).second ) pending.push_back(address); }
+
+		void sync() const;
+		void rebuild() const;
+		bool perform_add(Singleton* ptr) {
+			queue(ptr->ID());
+			return true;
+		}
+		void perform_remove(Singleton* ptr) {
+			spatial->remove(ptr->ID());
+			mirror.remove(ptr->ID());
+		}
+		bool perform_merge(base_type& other) {
+			self_type& donor = static_cast<self_type&>(other);
+			for(auto& x : donor) queue(x.ID());
+			donor.spatial->clear();
+			donor.mirror.clear();
+			donor.pending.clear();
+			donor.queued.clear();
+			return true;
+		}
+
 	public:
-		Space() = default;
+		Space() : spatial(new KDTree<T,N>()) {}
+		explicit Space(std::unique_ptr<spatial_type> backend)
+			: spatial(backend ? std::move(backend) : std::unique_ptr<spatial_type>(new KDTree<T,N>())) {}
 		Space(const self_type& rhs) = delete;
-		Space(self_type&& rhs);
+		Space(self_type&& rhs) = delete;
 		self_type& operator=(const self_type& rhs) = delete;
-		self_type& operator=(self_type&& rhs);
-		virtual ~Space() { clear(); }
-		
-		void update_data();
-		
-		alias_type get_alias(const id_type address);
-		
-		virtual bool add(reference& x);
-		virtual bool remove(const id_type address);
-		virtual void clear() { base_type::clear(); points.clear(); }
-		
-		virtual bool move_to(self_type& destination, const id_type address); //move single point
-		virtual void swap_with(self_type& other); //all Nodes
-		virtual bool merge_into(self_type& other); 
-		
-		std::set<singleton_type> in_region(const wayne::Region<double,N> region) const;
-		std::set<singleton_type> within(const raw_point_type pt, 
-					    const double radius) const;
-		singleton_type closest_to(const raw_point_type pt) const;
-						    
-		iterator begin() { return points.begin(); }
-		iterator end()   { return points.end(); }
-		//need closest point for search? might have to do voronoi partitions
+		self_type& operator=(self_type&& rhs) = delete;
+		~Space() = default;
+
+		void update_data() { rebuild(); }
+		void moved(const id_type address) { queue(address); }
+		template<typename I>
+		void moved(I first, I last) { for(; first!=last; ++first) queue(*first); } //a range of IDs
+		void set_spatial_index(std::unique_ptr<spatial_type> backend); //fills it with every Point
+		const spatial_type& spatial_index() const { sync(); return *spatial; }
+		const mirror_type& coordinates() const { sync(); return mirror; }
+		std::vector<id_type> morton_ordering() const;
+
+		std::vector<id_type> in_region(const region_type& region) const;
+		std::vector<id_type> within(const raw_point_type& pt, const double radius) const;
+		bool closest_to(const raw_point_type& pt, id_type& address) const; //false if the Space is empty
+		size_t nearest(const raw_point_type& pt, const size_t k, Neighbor* output) const; //closest first
+		std::vector<Neighbor> nearest(const raw_point_type& pt, const size_t k) const;
+		size_t knn(ThreadPool& pool, const raw_point_type* queries, const size_t count, const size_t k,
+			   Neighbor* output, const size_t chunk=64) const; //neighbors per query, the same for all
+		std::vector<Neighbor> knn(ThreadPool& pool, const std::vector<raw_point_type>& queries, const size_t k) const;
 	}; //class Space
 
-	
-	template<typename T, unsigned short N>
-	Space<T,N>::Space(Space&& rhs)
-		: base_type(rhs), points( std::move(rhs.points) ) {
-		update_all_points();
-	}
-	
 	template<typename T, unsigned short N>
-	Space<T,N>& Space<T,N>::operator=(Space&& rhs) {
-		if(this != &rhs) {
-			clear();
-			points = std::move(rhs.points);
-			base_type::operator=(rhs);
-			update_all_points();
+	void Space<T,N>::sync() const {
+		if(pending.empty()) return;
+		if(2*pending.size() > mirror.size()) { //cheaper to start over
+			rebuild();
+			return;
 		}
+		for(auto address : pending) {
+			auto iter = this->find(address);
+			if(iter == this->end()) continue; //left again before any query
+			if( !spatial->insert(address, iter->coordinates()) ) spatial->move(address, iter->coordinates());
+			if( !mirror.insert(address, iter->coordinates()) ) mirror.move(address, iter->coordinates());
+		}
+		pending.clear();
+		queued.clear();
 	}
 
 	template<typename T, unsigned short N>
-	void Space<T,N>::update_data() {
-		points.clear();
-		for(auto x& : index) points.insert( *(x.second) );
+	void Space<T,N>::rebuild() const {
+		std::vector< std::pair<id_type, raw_point_type> > points;
+		points.reserve(this->size());
+		for(auto& x : *this) points.push_back( std::make_pair(x.ID(), x.coordinates()) );
+		spatial->build(points);
+		mirror.build(points);
+		pending.clear();
+		queued.clear();
 	}
-	
+
 	template<typename T, unsigned short N>
-	typename Space<T,N>::iterator Space<T,N>::find(const id_type address) { //not redundant; rename?
-		auto it=points.begin()
-		for(auto ite=points.end(); it!=ite; ++it)
-			if(it->ID() == address) return it;
-		return it;
+	void Space<T,N>::set_spatial_index(std::unique_ptr<spatial_type> backend) {
+		if(!backend) return;
+		spatial = std::move(backend);
+		update_data();
 	}
-	
+
 	template<typename T, unsigned short N>
-	bool Space<T,N>::add(singleton_type& x) {
-		if( base_type::add(x) ) { 
-			points.insert(*point_ptr);
-			return true;
-		} else  return false; //shouldn't be trying to add duplicate element
+	std::vector<typename Space<T,N>::id_type> Space<T,N>::morton_ordering() const {
+		sync();
+		auto sorted = dynamic_cast<const MortonIndex<T,N>*>( spatial.get() );
+		if(sorted) return sorted->ordering();
+		std::vector< std::pair<id_type, raw_point_type> > points;
+		points.reserve(mirror.size());
+		for(size_t i=0; i<mirror.size(); ++i) points.push_back( std::make_pair(mirror.ids()[i], mirror.point(i)) );
+		MortonIndex<T,N> layout;
+		layout.build(points);
+		return layout.ordering();
 	}
-	
+
 	template<typename T, unsigned short N>
-	bool Space<T,N>::remove(const id_type address) {
-		auto alias = get_alias(address);
-		if( base_type::remove(address) ) {
-			points.erase(alias); 
-			return true;
-		} else  return false;
+	std::vector<typename Space<T,N>::id_type> Space<T,N>::in_region(const region_type& region) const {
+		sync();
+		std::vector<id_type> output;
+		spatial->in_region(region, output);
+		return output;
 	}
-	
+
 	template<typename T, unsigned short N>
-	bool Space<T,N>::move_to(Space& destination, const id_type address) {
-		auto it = index.find(address);
-		if(it != index.end()) {
-			if(destination.add_point(it->second)) {
-				it->second->update_space(&destination);
-				return remove_point(address);
-			} else return false;
-		} else return false;
+	std::vector<typename Space<T,N>::id_type> Space<T,N>::within(const raw_point_type& pt, const double radius) const {
+		sync();
+		std::vector<id_type> output;
+		spatial->within(pt, radius, output);
+		return output;
 	}
-	
+
 	template<typename T, unsigned short N>
-	void Space<T,N>::swap_with(Space& other) {
-		auto temp_index = std::move(index);
-		auto temp_points = std::move(points);
-		
-		index = std::move(other.index);
-		points = std::move(other.points);
-		
-		other.index = std::move(temp_index);
-		other.points = std::move(temp_points);
-		
-		update_all_points();
-		other.update_all_points();
+	bool Space<T,N>::closest_to(const raw_point_type& pt, id_type& address) const {
+		sync();
+		return spatial->closest_to(pt, address);
 	}
-	
+
 	template<typename T, unsigned short N>
-	bool Space<T,N>::merge_into(Space& other) {
-		auto it = points.begin();
-		auto ite = points.end();
-		typename std::map<id_type, local_type*>::iterator index_iter;
-		while(it != ite) {
-			index_iter = index.find(it->ID());
-			if( other.add_point(index_iter->second) ) {
-				index.erase(index_iter);
-				points.erase(it++);
-			} else ++it;
-		}
-		return points.size() == 0;
+	size_t Space<T,N>::nearest(const raw_point_type& pt, const size_t k, Neighbor* output) const {
+		sync();
+		return spatial->nearest(pt, k, output);
 	}
-	
+
 	template<typename T, unsigned short N>
-	std::set<typename Space<T,N>::singleton_type> 
-	    Space<T,N>::in_region(const wayne::Region<double,N> region) const {
-		
-		singleton_type lower_point, upper_point;
-		get_low_point<N>::call(region, lower_point);
-		get_high_point<N>(region, upper_point);
-		
-		auto lower_iter = points.lower_bound(lower_point);
-		auto upper_iter = points.upper_bound(upper_point);
-		
-		std::set<Space::singleton_type> output;
-		while(lower_iter != upper_iter) {
-			if( region.inside(*lower_iter) ) output.insert(*lower_iter); 
-			++lower_iter;
-		}
+	std::vector<Neighbor> Space<T,N>::nearest(const raw_point_type& pt, const size_t k) const {
+		std::vector<Neighbor> output(k);
+		output.resize( nearest(pt, k, output.data()) );
 		return output;
 	}
-	
+
 	template<typename T, unsigned short N>
-	std::set<typename Space<T,N>::singleton_type> 
-	    Space<T,N>::within(const raw_point_type pt, const double radius) const {
-		wayne::Region<double,N> region;
-		get_region_around<N>(pt, radius, region);
-		auto output = in_region(region);
-		
-		for(auto it=output.begin(), auto it=output.end(); it!=ite; ++it)
-			if(!within<N>(pt, *it, radius)) output.erase(it);
-		
-		return output;
+	size_t Space<T,N>::knn(ThreadPool& pool, const raw_point_type* queries, const size_t count, const size_t k,
+			       Neighbor* output, const size_t chunk) const {
+		sync(); //the only change to the index; after this the workers only read it
+		const spatial_type& index = *spatial;
+		const size_t found = std::min(k, index.size());
+		pool.parallel_for(count, chunk, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) {
+				Neighbor* row = output + i*k;
+				for(size_t j=index.nearest(queries[i], k, row); j<k; ++j)
+					row[j] = Neighbor{ std::numeric_limits<id_type>::max(), std::numeric_limits<double>::infinity() };
+			}
+		});
+		return found;
 	}
-	
+
 	template<typename T, unsigned short N>
-	typename Space<T,N>::singleton_type 
-	    Space<T,N>::closest_to(const raw_point_type pt) const {
-		//for now just search linearly
-		//other options:
-		//	delaunay tesselation
-		//	iterative neighborhood search 
-		singleton_type output = *(points.begin());
-		double distance, best_distance = unwind_distance<N>(pt, output); //no need for sqrt
-		for(auto x& : points) { 
-			distance = unwind_distance<N>(pt, x);
-			if(distance < best_distance) {
-				output = x;
-				best_distance = distance;
-			}
-		}
+	std::vector<Neighbor> Space<T,N>::knn(ThreadPool& pool, const std::vector<raw_point_type>& queries, const size_t k) const {
+		std::vector<Neighbor> output(queries.size()*k);
+		knn(pool, queries.data(), queries.size(), k, output.data());
 		return output;
 	}
+
 } //namespace ben
 
 #endif
@@ -0,0 +1,121 @@
+#ifndef BenoitSpatialIndex_h
+#define BenoitSpatialIndex_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include "Distance.h"
+
+namespace ben {
+/* A SpatialIndex answers geometric queries over a set of points, each known by the ID of the
+ * Point it stands for. Space keeps one, and forwards in_region, within and closest_to to it. The
+ * index holds its own copy of the coordinates, so it never touches the Points themselves.
+ *
+ * Any replacement must implement build (replacing the contents in bulk), insert, remove, move,
+ * clear, size, and the three queries below. Query results are appended to the caller's vector,
+ * so one vector can be reused across queries. nearest fills a caller-provided array with up to k
+ * Neighbors, closest first, and allocates nothing. Queries are const and may run concurrently;
+ * changes may not run alongside anything else.
+ */
+	template<typename T, unsigned short N>
+	struct Box {
+	//an axis-aligned region, closed on both ends
+		std::array<T,N> lower, upper;
+
+		static Box around(const std::array<T,N>& center, const double radius) {
+			Box box;
+			for(unsigned short i=0; i<N; ++i) {
+				box.lower[i] = center[i] - radius;
+				box.upper[i] = center[i] + radius;
+			}
+			return box;
+		}
+		bool contains(const std::array<T,N>& point) const {
+			for(unsigned short i=0; i<N; ++i)
+				if(point[i] < lower[i] or point[i] > upper[i]) return false;
+			return true;
+		}
+	}; //struct Box
+
+	struct Neighbor {
+		unsigned int id;
+		double distance;
+	}; //struct Neighbor
+
+	template<typename T, unsigned short N>
+	class SpatialIndex {
+	public:
+		typedef T coordinate_type;
+		typedef std::array<T,N> point_type;
+		typedef unsigned int id_type;
+		typedef Box<T,N> region_type;
+		static const unsigned short dimensions = N;
+
+		virtual ~SpatialIndex() = default;
+
+		virtual void build(const std::vector< std::pair<id_type, point_type> >& points) = 0;
+		virtual bool insert(const id_type address, const point_type& point) = 0; //false if address is there already
+		virtual bool remove(const id_type address) = 0; //false if address isn't there
+		virtual bool move(const id_type address, const point_type& point) = 0; //false if address isn't there
+		virtual void clear() = 0;
+		virtual size_t size() const = 0;
+
+		virtual void in_region(const region_type& region, std::vector<id_type>& output) const = 0;
+		virtual void within(const point_type& center, const double radius, std::vector<id_type>& output) const = 0;
+		virtual size_t nearest(const point_type& center, const size_t k, Neighbor* output) const = 0;
+
+		bool closest_to(const point_type& center, id_type& address) const {
+			//false if the index is empty
+			Neighbor best;
+			if(nearest(center, 1, &best) == 0) return false;
+			address = best.id;
+			return true;
+		}
+
+	protected:
+		//for nearest: a max-heap of the best candidates so far, by squared distance
+		static bool farther(const Neighbor& a, const Neighbor& b) { return a.distance < b.distance; }
+		static void offer(Neighbor* heap, size_t& count, const size_t k, const id_type address, const double distance) {
+			if(count < k) {
+				heap[count++] = Neighbor{address, distance};
+				std::push_heap(heap, heap + count, farther);
+			} else if(distance < heap[0].distance) {
+				std::pop_heap(heap, heap + count, farther);
+				heap[count-1] = Neighbor{address, distance};
+				std::push_heap(heap, heap + count, farther);
+			}
+		}
+		static size_t finish(Neighbor* heap, const size_t count) {
+			//sorts closest first and converts squared distances
+			std::sort_heap(heap, heap + count, farther);
+			for(size_t i=0; i<count; ++i) heap[i].distance = std::sqrt(heap[i].distance);
+			return count;
+		}
+	}; //class SpatialIndex
+
+} //namespace ben
+
+#endif
+
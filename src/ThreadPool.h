@@ -0,0 +1,222 @@
+#ifndef BenoitThreadPool_h
+#define BenoitThreadPool_h
+
+/*
+    Benoit: a flexible framework for distributed graphs and spaces
+    Copyright (C) 2013  Jack Hall
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    e-mail: jackwhall7@gmail.com
+*/
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <cstdint>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ben {
+/* ThreadPool is a fork-join pool of worker threads. The thread calling parallel() takes part as
+ * worker 0, so a pool of size 1 runs everything inline with no synchronization overhead worth
+ * mentioning. Workers sleep on a condition variable between jobs.
+ *
+ * parallel_for splits [0,n) into chunks and hands each worker a contiguous run of chunks (static
+ * partitioning). A worker that runs out of chunks steals from the back of another worker's run,
+ * so skewed per-item costs (high-degree nodes, for instance) don't leave cores idle.
+ *
+ * A pool runs one job at a time. Do not call parallel or parallel_for from inside a job.
+ *
+ * pin_workers binds each worker to one core, so that work assigned to a worker (a graph
+ * Partition, say) keeps its cache. Since the caller is worker 0, it gets pinned too.
+ */
+	class ThreadPool {
+	public:
+		typedef std::function<void(unsigned)> job_type; //argument is the worker number
+		typedef std::function<void(size_t, size_t)> range_type; //half-open range of items
+
+	private:
+		typedef ThreadPool self_type;
+
+		struct WorkRange {
+			//front and back chunk indices packed into one word, so that the owner (popping
+			//the front) and thieves (popping the back) agree with a single CAS
+			std::atomic<uint64_t> bounds;
+			char padding[64 - sizeof(std::atomic<uint64_t>)]; //keep each range on its own cache line
+
+			WorkRange() : bounds(0) {}
+			void set(const uint32_t first, const uint32_t last)
+				{ bounds.store( (uint64_t(first) << 32) | last ); }
+			bool pop_front(uint32_t& chunk) {
+				uint64_t old = bounds.load();
+				uint32_t first, last;
+				do {
+					first = uint32_t(old >> 32);
+					last = uint32_t(old);
+					if(first >= last) return false;
+				} while( !bounds.compare_exchange_weak(old, (uint64_t(first+1) << 32) | last) );
+				chunk = first;
+				return true;
+			}
+			bool pop_back(uint32_t& chunk) {
+				uint64_t old = bounds.load();
+				uint32_t first, last;
+				do {
+					first = uint32_t(old >> 32);
+					last = uint32_t(old);
+					if(first >= last) return false;
+				} while( !bounds.compare_exchange_weak(old, (uint64_t(first) << 32) | (last-1)) );
+				chunk = last - 1;
+				return true;
+			}
+		}; //struct WorkRange
+
+		std::vector<std::thread> threads;
+		std::unique_ptr<WorkRange[]> ranges;
+		std::mutex pool_mutex;
+		std::condition_variable start_condition, finish_condition;
+		const job_type* current_job;
+		unsigned long generation; //incremented for each job, guarded by pool_mutex
+		unsigned remaining; //workers still running the current job, guarded by pool_mutex
+		std::exception_ptr failure; //the first exception a worker threw from the current job, guarded by pool_mutex
+		bool stopping;
+
+		void finish(std::exception_ptr thrown) {
+			//waits for the other workers, then rethrows thrown, or else whatever one of them threw
+			std::unique_lock<std::mutex> lock(pool_mutex);
+			finish_condition.wait(lock, [this]() { return remaining == 0; });
+			if(!thrown) thrown = failure;
+			failure = nullptr;
+			lock.unlock();
+			if(thrown) std::rethrow_exception(thrown);
+		}
+
+		void work(const unsigned worker) {
+			unsigned long seen = 0;
+			while(true) {
+				const job_type* job;
+				{
+					std::unique_lock<std::mutex> lock(pool_mutex);
+					start_condition.wait(lock, [&]() { return stopping or generation != seen; });
+					if(stopping) return;
+					seen = generation;
+					job = current_job;
+				}
+				std::exception_ptr thrown;
+				try {
+					(*job)(worker);
+				} catch(...) {
+					thrown = std::current_exception(); //for parallel to rethrow on the calling thread
+				}
+				std::lock_guard<std::mutex> lock(pool_mutex);
+				if(thrown and !failure) failure = thrown;
+				if(--remaining == 0) finish_condition.notify_one();
+			}
+		}
+
+	public:
+		explicit ThreadPool(unsigned n = std::thread::hardware_concurrency())
+			: ranges(new WorkRange[n > 0 ? n : 1]), current_job(nullptr),
+			  generation(0), remaining(0), failure(), stopping(false) {
+			if(n == 0) n = 1;
+			threads.reserve(n-1);
+			for(unsigned i=1; i<n; ++i) threads.push_back( std::thread(&self_type::work, this, i) );
+		}
+		ThreadPool(const self_type& rhs) = delete;
+		self_type& operator=(const self_type& rhs) = delete;
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(pool_mutex);
+				stopping = true;
+			}
+			start_condition.notify_all();
+			for(auto& x : threads) x.join();
+		}
+
+		unsigned size() const { return threads.size() + 1; }
+
+		bool pin_workers(const unsigned first_core=0) {
+			//worker i runs on core first_core+i, modulo the number of cores; worker 0 is the
+			//calling thread, which stays pinned afterwards
+			//returns false if any binding failed or pinning isn't supported here
+#ifdef __linux__
+			const unsigned cores = std::thread::hardware_concurrency();
+			if(cores == 0) return false;
+			std::atomic<bool> status(true);
+			parallel([&](const unsigned worker) {
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET((first_core + worker) % cores, &set);
+				if( pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0 ) status.store(false);
+			});
+			return status.load();
+#else
+			return false;
+#endif
+		}
+
+		void parallel(const job_type& job) {
+			//runs job(worker) once on every worker and returns when all of them have finished
+			//if job throws on any worker, one of the exceptions is rethrown here once every worker
+			//is done with job, preferring the calling thread's own
+			if( !threads.empty() ) {
+				std::lock_guard<std::mutex> lock(pool_mutex);
+				current_job = &job;
+				remaining = threads.size();
+				++generation;
+			}
+			start_condition.notify_all();
+			std::exception_ptr thrown;
+			try {
+				job(0);
+			} catch(...) {
+				thrown = std::current_exception();
+			}
+			finish(thrown);
+		}
+
+		void parallel_for(const size_t n, const size_t chunk_size, const range_type& f) {
+			//calls f(begin, end) over chunks covering [0,n), stealing chunks to balance load
+			if(n == 0) return;
+			const size_t chunk = chunk_size > 0 ? chunk_size : 1;
+			const size_t chunks = (n + chunk - 1) / chunk;
+			const unsigned workers = size();
+			for(unsigned i=0; i<workers; ++i)
+				ranges[i].set(uint32_t(chunks*i/workers), uint32_t(chunks*(i+1)/workers));
+
+			parallel([&](const unsigned worker) {
+				uint32_t current;
+				auto run = [&](const uint32_t c) {
+					size_t first = c*chunk;
+					f(first, first+chunk < n ? first+chunk : n);
+				};
+				while( ranges[worker].pop_front(current) ) run(current);
+				for(unsigned i=1; i<workers; ++i) //then steal, starting with the nearest neighbor
+					while( ranges[(worker+i) % workers].pop_back(current) ) run(current);
+			});
+		}
+	}; //class ThreadPool
+
+} //namespace ben
+
+#endif
+
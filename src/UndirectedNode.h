@@ -21,9 +21,12 @@
     e-mail: jackwhall7@gmail.com
 */
 
+#include <vector>
+#include <algorithm>
 #include "Singleton.h"
 #include "Path.h"
 #include "LinkManager.h"
+#include "ChangeLog.h"
 
 namespace ben {
 	
@@ -53,7 +56,19 @@ namespace ben {
 		LinkManager<self_type, link_type> links;
 		//std::mutex
 
+		friend struct LinkAccess;
 		void perform_leave() { clear(); }
+		void touch(const ChangeKind kind, const id_type source, const id_type target) const { 
+			//lets the Graph know that its links have changed
+			auto graph = get_index();
+			if(graph) graph->links_changed(kind, source, target);
+		}
+		void touch() const { touch(ChangeKind::links_reset, ID(), ID()); } //after changes to several links
+		void touch_value(const id_type target) const {
+			//lets the Graph log a new link value; the links themselves haven't changed
+			auto graph = get_index();
+			if(graph) graph->value_changed(ID(), target);
+		}
 	
 	public:
 		UndirectedNode() : base_type(), links(ID()) {}
@@ -68,6 +83,7 @@ namespace ben {
 				base_type::operator=(std::move(rhs));
 				links = std::move(rhs.links);
 			}
+			return *this;
 		}
 		~UndirectedNode() { clear(); } //might want to lock while deleting links
 
@@ -85,8 +101,10 @@ namespace ben {
 			static_assert(std::is_same< typename link_type::construction_types, ConstructionTypes<Args...> >::value,
 					"extra arguments for UndirectedNode::add must match link_type::construction_types");
 			auto node_iter = get_index()->find(address); 
-			if(node_iter != get_index()->end()) return links.add(node_iter->links, args...);
-			else return false;
+			if( node_iter != get_index()->end() and links.add(node_iter->links, args...) ) {
+				touch(ChangeKind::link_added, ID(), address);
+				return true;
+			} else return false;
 		}
 		bool mirror(const self_type& other) { 
 			//links-to-self are cloned to preserve the pattern - if other has a link-to-self, then
@@ -112,14 +130,17 @@ namespace ben {
 						}
 					}
 				}
+				touch();
 				return true;
 			} else return false;
 		}
 		void remove(const iterator iter) {
 			//gets an iterator to the other node and lets LinkManager::remove do the rest
 			//of the work
-			auto node_iter = get_index()->find(iter->get_address());
+			auto address = iter->get_address();
+			auto node_iter = get_index()->find(address);
 			links.remove(node_iter->links, iter);
+			touch(ChangeKind::link_removed, ID(), address);
 		}
 		void remove(const id_type address) {
 			//finds the link referred to and delegates to the other overload of remove
@@ -127,11 +148,38 @@ namespace ben {
 			auto iter = find(address);
 			if(iter != end()) remove(iter);
 		}
+		size_t remove(std::vector<id_type> addresses) {
+			//removes the links to all of addresses with one pass over the links, instead of one
+			//search per address; addresses that aren't linked are ignored
+			//returns the number removed
+			if(links.size() == 0 or addresses.empty()) return 0;
+			std::sort(addresses.begin(), addresses.end());
+			auto listed = [&](const id_type x) { return std::binary_search(addresses.begin(), addresses.end(), x); };
+			for(auto& x : links) 
+				if( x.get_address() != ID() and listed(x.get_address()) )
+					get_index()->elem(x.get_address()).links.clean_up(ID());
+			size_t removed = links.clean_up_if(listed);
+			if(removed > 0) touch();
+			return removed;
+		}
+		template<typename V>
+		bool set_value(const id_type address, const V& v) {
+			//sets the value of the Path to address, and logs it in the Graph's ChangeLog, which
+			//Path::set_value can't reach; returns false if there is no such link
+			auto iter = links.find(address);
+			if( iter == links.end() ) return false;
+			iter->set_value(v);
+			touch_value(address);
+			return true;
+		}
+		void reserve(const size_t n) { links.reserve(n); } //ahead of many add calls
 		void clear() {
 			//removes all link complements before deleting the local copy of the links, thereby
 			//preventing iterator invalidation
+			if(links.size() == 0) return;
 			for(auto& x : links) get_index()->elem(x.get_address()).links.clean_up(ID());
 			links.clear();
+			touch();
 		}
 		
 		size_t size() const { return links.size(); }
@@ -145,7 +193,7 @@ namespace ben {
 		iterator begin() { return links.begin(); }
 		const_iterator begin() const { return links.begin(); }
 		iterator end() { return links.end(); }
-		const_iterator end() const { return links.begin(); }
+		const_iterator end() const { return links.end(); }
 	}; //class UndirectedNode
 
 	//simply uses the default Path class, more user-friendly
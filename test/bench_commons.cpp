@@ -0,0 +1,121 @@
+/*
+	Benoit: a flexible framework for distributed graphs and spaces
+	Copyright (C) 2013  John Wendell Hall
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	The author may be reached at jackhall@utexas.edu.
+*/
+
+//Times readers-writer locks under a read-mostly load: every thread takes the lock over and over
+//for a short read of shared data, and once in a while for a write. Commons runs with and without
+//writer preference, against a pthread rwlock (one shared reader count, like boost::shared_mutex)
+//and a plain mutex.
+//to compile and run:
+//	g++ -std=c++11 -O2 -march=native -I../src bench_commons.cpp -o bench_commons -lpthread
+//	./bench_commons [threads] [locks per thread] [reads per write]
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <pthread.h>
+#include "Commons.h"
+
+namespace {
+
+	typedef std::chrono::steady_clock clock_type;
+
+	class RWLock {
+	//the same interface as Commons over a pthread rwlock
+		pthread_rwlock_t rwlock;
+
+	public:
+		RWLock() { pthread_rwlock_init(&rwlock, nullptr); }
+		~RWLock() { pthread_rwlock_destroy(&rwlock); }
+		void read_lock() { pthread_rwlock_rdlock(&rwlock); }
+		void read_unlock() { pthread_rwlock_unlock(&rwlock); }
+		void write_lock() { pthread_rwlock_wrlock(&rwlock); }
+		void write_unlock() { pthread_rwlock_unlock(&rwlock); }
+	}; //class RWLock
+
+	class Mutex {
+		std::mutex mutex;
+
+	public:
+		void read_lock() { mutex.lock(); }
+		void read_unlock() { mutex.unlock(); }
+		void write_lock() { mutex.lock(); }
+		void write_unlock() { mutex.unlock(); }
+	}; //class Mutex
+
+	template<typename L>
+	void run(const std::string& name, L& lock, const unsigned threads, const unsigned count, const unsigned ratio) {
+		std::vector<long> data(16, 0);
+		std::atomic<long> total(0);
+		std::atomic<unsigned> ready(0);
+		std::vector<std::thread> workers;
+		auto start = clock_type::now();
+		for(unsigned t=0; t<threads; ++t) {
+			workers.emplace_back([&, t]() {
+				++ready;
+				while(ready.load() < threads) std::this_thread::yield(); //start together
+				long sum = 0;
+				for(unsigned i=0; i<count; ++i) {
+					if(ratio > 0 and (i + t) % ratio == 0) {
+						lock.write_lock();
+						for(auto& x : data) ++x;
+						lock.write_unlock();
+					} else {
+						lock.read_lock();
+						for(auto x : data) sum += x;
+						lock.read_unlock();
+					}
+				}
+				total += sum;
+			});
+		}
+		for(auto& x : workers) x.join();
+		double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+		std::cout << std::setw(24) << std::left << name << std::setw(12) << seconds
+			  << std::setw(14) << double(threads) * count / seconds / 1e6 << "(" << total.load() << ")" << std::endl;
+	}
+
+} //anonymous namespace
+
+int main(int argc, char **argv) {
+	using namespace ben;
+	unsigned cores = std::thread::hardware_concurrency();
+	const unsigned threads = argc > 1 ? std::atoi(argv[1]) : (cores > 0 ? cores : 4);
+	const unsigned count = argc > 2 ? std::atoi(argv[2]) : 1000000;
+	const unsigned ratio = argc > 3 ? std::atoi(argv[3]) : 1000; //0 for reads only
+
+	std::cout << threads << " threads, " << count << " locks each, " << ratio << " reads per write" << std::endl;
+	std::cout << std::setw(24) << std::left << "lock" << std::setw(12) << "seconds" << std::setw(14) << "M locks/s" << std::endl;
+	Commons writers_first(true);
+	run("Commons, writers first", writers_first, threads, count, ratio);
+	Commons readers_first(false);
+	run("Commons, readers first", readers_first, threads, count, ratio);
+	RWLock rwlock;
+	run("pthread_rwlock", rwlock, threads, count, ratio);
+	Mutex mutex;
+	run("std::mutex", mutex, threads, count, ratio);
+	return 0;
+}
+
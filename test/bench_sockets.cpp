@@ -0,0 +1,128 @@
+/*
+	Benoit: a flexible framework for distributed graphs and spaces
+	Copyright (C) 2013  John Wendell Hall
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	The author may be reached at jackhall@utexas.edu.
+*/
+
+//Times SocketBuffer between two processes: throughput with and without batching, then round-trip
+//latency through a pair of links, over a Unix-domain socket and loopback TCP.
+//to compile and run:
+//	g++ -std=c++11 -O2 -I../src bench_sockets.cpp -o bench_sockets -lpthread
+//	./bench_sockets [signals] [round trips]
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Port.h"
+#include "SocketBuffer.h"
+
+namespace {
+
+	typedef std::chrono::steady_clock clock_type;
+
+	double seconds_since(const clock_type::time_point start) {
+		return std::chrono::duration<double>(clock_type::now() - start).count();
+	}
+
+	template<unsigned short B>
+	void throughput(const std::string& address, const unsigned n) {
+		//the child counts what arrives and reports it through a pipe when the last signal does
+		typedef ben::SocketBuffer<double, B> buffer_type;
+		int report[2];
+		if(pipe(report) != 0) return;
+		pid_t child = fork();
+		if(child == 0) {
+			ben::InPort<buffer_type> input(0, address);
+			double signal = 0.0;
+			unsigned received = 0;
+			while(signal < n-1) {
+				if( input.pull(signal) ) ++received;
+				else std::this_thread::yield();
+			}
+			if( write(report[1], &received, sizeof(received)) != sizeof(received) ) _exit(1);
+			_exit(0);
+		}
+		ben::OutPort<buffer_type> output(0, address);
+		while( !output.flush() ) std::this_thread::yield(); //connected, once the child listens
+		auto start = clock_type::now();
+		for(unsigned i=0; i<n; ++i) output.push(i);
+		while( !output.flush() ) std::this_thread::yield();
+		unsigned received = 0;
+		if( read(report[0], &received, sizeof(received)) != sizeof(received) ) received = 0;
+		double elapsed = seconds_since(start);
+		waitpid(child, nullptr, 0);
+		close(report[0]);
+		close(report[1]);
+		std::cout << "B = " << B << ":\t" << n/elapsed/1e6 << " million pushes/s, " << received/elapsed/1e6
+			  << " million delivered/s (" << received << " of " << n << ")" << std::endl;
+	}
+
+	void latency(const std::string& there, const std::string& back, const unsigned trips) {
+		//the child echoes every signal; one signal is in flight at a time
+		typedef ben::SocketBuffer<double, 1> buffer_type;
+		pid_t child = fork();
+		if(child == 0) {
+			ben::InPort<buffer_type> input(0, there);
+			ben::OutPort<buffer_type> output(0, back);
+			double signal = 0.0;
+			while(signal >= 0.0) {
+				if( input.pull(signal) ) while( !output.push(signal) or !output.flush() ) std::this_thread::yield();
+				else std::this_thread::yield();
+			}
+			_exit(0);
+		}
+		ben::InPort<buffer_type> input(0, back);
+		ben::OutPort<buffer_type> output(0, there);
+		double signal = 0.0;
+		input.pull(signal); //listen before the child tries to connect
+		while( !output.push(0.0) or !output.flush() ) std::this_thread::yield(); //wait for the child to listen
+		while( !input.pull(signal) ) std::this_thread::yield();
+		auto start = clock_type::now();
+		for(unsigned i=1; i<=trips; ++i) {
+			output.push(i);
+			while( !input.pull(signal) ) std::this_thread::yield();
+		}
+		double elapsed = seconds_since(start);
+		output.push(-1.0);
+		waitpid(child, nullptr, 0);
+		std::cout << "round trip:\t" << 1e6*elapsed/trips << " us" << std::endl;
+	}
+
+} //anonymous namespace
+
+int main(int argc, char **argv) {
+	const unsigned n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	const unsigned trips = argc > 2 ? std::atoi(argv[2]) : 10000;
+	const std::string local = "/tmp/bench_sockets_" + std::to_string(getpid());
+
+	std::cout << "Unix-domain socket" << std::endl;
+	throughput<1>(local + ".sock", n);
+	throughput<256>(local + ".sock", n);
+	latency(local + "_there.sock", local + "_back.sock", trips);
+	std::cout << "loopback TCP" << std::endl;
+	throughput<1>("tcp://127.0.0.1:47621", n);
+	throughput<256>("tcp://127.0.0.1:47622", n);
+	latency("tcp://127.0.0.1:47623", "tcp://127.0.0.1:47624", trips);
+	for(std::string suffix : {".sock", "_there.sock", "_back.sock"}) unlink( (local + suffix).c_str() );
+	return 0;
+}
+
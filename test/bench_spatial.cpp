@@ -0,0 +1,209 @@
+/*
+	Benoit: a flexible framework for distributed graphs and spaces
+	Copyright (C) 2013  John Wendell Hall
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	The author may be reached at jackhall@utexas.edu.
+*/
+
+//Times the SpatialIndexes on uniform and clustered 3D points: bulk build, region, radius and
+//nearest-neighbor queries, then a round of inserts, moves and removals. The baseline scans a
+//std::set of points, as Space did before it had a spatial index.
+//to compile and run:
+//	g++ -std=c++11 -O2 -march=native -I../src bench_spatial.cpp -o bench_spatial
+//	./bench_spatial [points] [queries]
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <set>
+#include <string>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include "SpatialIndex.h"
+#include "KDTree.h"
+#include "RTree.h"
+#include "CellList.h"
+#include "CoordinateArray.h"
+#include "Morton.h"
+
+namespace {
+
+	typedef std::array<double,3> point_type;
+	typedef std::vector< std::pair<unsigned int, point_type> > point_list;
+	typedef ben::Box<double,3> region_type;
+	typedef std::chrono::steady_clock clock_type;
+
+	double seconds_since(const clock_type::time_point start) {
+		return std::chrono::duration<double>(clock_type::now() - start).count();
+	}
+
+	class SetScan : public ben::SpatialIndex<double,3> {
+	//every query is a pass over a std::set, like the old Space
+		typedef std::pair<unsigned int, point_type> entry_type;
+		std::set<entry_type> points;
+		std::vector<point_type> position;
+
+	public:
+		void build(const point_list& list) {
+			clear();
+			for(auto& x : list) insert(x.first, x.second);
+		}
+		bool insert(const id_type address, const point_type& point) {
+			if(address >= position.size()) position.resize(address + 1, point_type{{NAN, NAN, NAN}});
+			if( !std::isnan(position[address][0]) ) return false;
+			position[address] = point;
+			points.insert( entry_type(address, point) );
+			return true;
+		}
+		bool remove(const id_type address) {
+			if(address >= position.size() or std::isnan(position[address][0])) return false;
+			points.erase( entry_type(address, position[address]) );
+			position[address][0] = NAN;
+			return true;
+		}
+		bool move(const id_type address, const point_type& point) {
+			return remove(address) and insert(address, point);
+		}
+		void clear() {
+			points.clear();
+			position.clear();
+		}
+		size_t size() const { return points.size(); }
+		void in_region(const region_type& region, std::vector<id_type>& output) const {
+			for(auto& x : points) if( region.contains(x.second) ) output.push_back(x.first);
+		}
+		void within(const point_type& center, const double radius, std::vector<id_type>& output) const {
+			for(auto& x : points) if(ben::squared_distance(center, x.second) <= radius*radius) output.push_back(x.first);
+		}
+		size_t nearest(const point_type& center, const size_t k, ben::Neighbor* output) const {
+			size_t count = 0;
+			for(auto& x : points) offer(output, count, k, x.first, ben::squared_distance(center, x.second));
+			return finish(output, count);
+		}
+	}; //class SetScan
+
+	point_list uniform(const unsigned n, std::default_random_engine& gen) {
+		std::uniform_real_distribution<double> coordinate(0.0, 100.0);
+		point_list points;
+		for(unsigned i=0; i<n; ++i) points.push_back( std::make_pair(i, point_type{{coordinate(gen), coordinate(gen), coordinate(gen)}}) );
+		return points;
+	}
+
+	point_list clustered(const unsigned n, std::default_random_engine& gen) {
+		//a few tight clusters of very different sizes, and a thin scattering between them
+		std::uniform_real_distribution<double> coordinate(0.0, 100.0);
+		std::vector<point_type> centers;
+		for(unsigned i=0; i<20; ++i) centers.push_back( point_type{{coordinate(gen), coordinate(gen), coordinate(gen)}} );
+		std::exponential_distribution<double> size(1.0);
+		std::vector<double> spread;
+		for(unsigned i=0; i<20; ++i) spread.push_back(0.05 + size(gen));
+		std::uniform_int_distribution<unsigned> pick(0, 19);
+		std::normal_distribution<double> offset(0.0, 1.0);
+		point_list points;
+		for(unsigned i=0; i<n; ++i) {
+			if(i % 20 == 0) {
+				points.push_back( std::make_pair(i, point_type{{coordinate(gen), coordinate(gen), coordinate(gen)}}) );
+				continue;
+			}
+			unsigned c = pick(gen);
+			point_type x = centers[c];
+			for(auto& y : x) y += spread[c]*offset(gen);
+			points.push_back( std::make_pair(i, x) );
+		}
+		return points;
+	}
+
+	void run(const std::string& name, ben::SpatialIndex<double,3>& index, const point_list& points,
+		 const std::vector<point_type>& queries, const double radius) {
+		std::vector<unsigned int> found;
+		ben::Neighbor neighbors[8];
+		size_t hits = 0;
+		std::cout << std::setw(16) << std::left << name;
+
+		auto start = clock_type::now();
+		index.build(points);
+		std::cout << std::setw(12) << seconds_since(start);
+
+		start = clock_type::now();
+		for(auto& x : queries) {
+			found.clear();
+			index.in_region(region_type::around(x, 2.0*radius), found);
+			hits += found.size();
+		}
+		std::cout << std::setw(12) << seconds_since(start);
+
+		start = clock_type::now();
+		for(auto& x : queries) {
+			found.clear();
+			index.within(x, radius, found);
+			hits += found.size();
+		}
+		std::cout << std::setw(12) << seconds_since(start);
+
+		start = clock_type::now();
+		for(auto& x : queries) hits += index.nearest(x, 8, neighbors);
+		std::cout << std::setw(12) << seconds_since(start);
+
+		start = clock_type::now();
+		const unsigned n = points.size();
+		for(unsigned i=0; i<queries.size(); ++i) {
+			index.insert(n + i, queries[i]);
+			index.move(i, queries[queries.size() - 1 - i]);
+			index.remove(n/2 + i);
+		}
+		std::cout << std::setw(12) << seconds_since(start) << "(" << hits << ")" << std::endl;
+	}
+
+} //anonymous namespace
+
+int main(int argc, char **argv) {
+	using namespace ben;
+	const unsigned n = argc > 1 ? std::atoi(argv[1]) : 200000;
+	const unsigned q = argc > 2 ? std::atoi(argv[2]) : 10000;
+	std::default_random_engine gen;
+
+	for(int layout=0; layout<2; ++layout) {
+		point_list points = layout == 0 ? uniform(n, gen) : clustered(n, gen);
+		std::vector<point_type> queries;
+		std::uniform_int_distribution<unsigned> pick(0, n-1);
+		for(unsigned i=0; i<q; ++i) queries.push_back(points[pick(gen)].second); //where the points are
+		std::cout << n << (layout == 0 ? " uniform" : " clustered") << " points, " << q << " queries, seconds" << std::endl;
+		std::cout << std::setw(16) << std::left << "index" << std::setw(12) << "build" << std::setw(12) << "region"
+			  << std::setw(12) << "within" << std::setw(12) << "nearest 8" << std::setw(12) << "changes" << std::endl;
+
+		const double radius = 1.0;
+		KDTree<double,3> kdtree;
+		run("KDTree", kdtree, points, queries, radius);
+		RTree<double,3> rtree;
+		run("RTree", rtree, points, queries, radius);
+		CellList<double,3> cells(radius);
+		run("CellList", cells, points, queries, radius);
+		MortonIndex<double,3> sorted;
+		run("MortonIndex", sorted, points, queries, radius);
+		if(n <= 200000) {
+			std::vector<point_type> few(queries.begin(), queries.begin() + std::min(q, 200u)); //linear scans are slow
+			CoordinateArray<double,3> columns;
+			run("CoordinateArray", columns, points, few, radius);
+			SetScan scan;
+			run("std::set", scan, points, few, radius);
+		}
+		std::cout << std::endl;
+	}
+	return 0;
+}
+
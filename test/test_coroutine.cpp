@@ -0,0 +1,108 @@
+/*
+	Benoit: a flexible framework for distributed graphs and spaces
+	Copyright (C) 2013  John Wendell Hall
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	The author may be reached at jackhall@utexas.edu.
+*/
+
+//coroutines need C++20, unlike the other tests
+//to compile and run:
+//	g++ -std=c++20 -g -I../src test_coroutine.cpp -o test_coroutine -lgtest -lpthread -latomic
+//	./test_coroutine
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include "gtest/gtest.h"
+#include "Graph.h"
+#include "DirectedNode.h"
+#include "Coroutine.h"
+
+namespace {
+
+	typedef ben::stdMessageNode<int, 1> node_type;
+	typedef ben::CoroutineScheduler<node_type> scheduler_type;
+
+	ben::NodeTask relay(node_type& node, scheduler_type& scheduler, const int rounds, std::atomic<int>& sum) {
+		//waits on its only input and passes each signal along, plus one
+		for(int i=0; i<rounds; ++i) {
+			int signal = co_await ben::pull( *node.inputs.begin() );
+			sum += signal;
+			for(auto iter=node.outputs.begin(); iter!=node.outputs.end(); ++iter)
+				scheduler.push(iter, signal + 1);
+		}
+	}
+
+	ben::NodeTask gather(node_type& node, const int count, std::vector<int>& sources) {
+		for(int i=0; i<count; ++i) {
+			auto input = co_await ben::any_input(node);
+			sources.push_back(input.source);
+		}
+	}
+
+	TEST(Coroutines, Relay) {
+		using namespace ben;
+		auto graph_ptr = std::make_shared<Graph<node_type>>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<20; ++i) nodes.emplace_back( new node_type(graph_ptr, i+1) );
+		for(unsigned i=1; i<20; ++i) nodes[i]->add_input(nodes[i-1]->ID());
+
+		ThreadPool pool(3);
+		scheduler_type scheduler(pool, *graph_ptr);
+		std::atomic<int> sum(0);
+		for(unsigned i=1; i<20; ++i) EXPECT_TRUE( scheduler.spawn(*nodes[i], relay(*nodes[i], scheduler, 1, sum)) );
+		scheduler.run(); //every relay suspends on its empty input
+		EXPECT_EQ(19, scheduler.live());
+		EXPECT_EQ(0, sum.load());
+
+		EXPECT_TRUE( scheduler.push(nodes[0]->outputs.begin(), 0) );
+		scheduler.run();
+		EXPECT_EQ(0, scheduler.live());
+		EXPECT_EQ(171, sum.load()); //0 + 1 + ... + 18
+	}
+
+	TEST(Coroutines, AnyInput) {
+		using namespace ben;
+		auto graph_ptr = std::make_shared<Graph<node_type>>();
+		node_type node1(graph_ptr, 1), node2(graph_ptr, 2), node3(graph_ptr, 3);
+		node3.add_input(1);
+		node3.add_input(2);
+
+		ThreadPool pool(2);
+		scheduler_type scheduler(pool, *graph_ptr);
+		std::vector<int> sources;
+		scheduler.spawn(node3, gather(node3, 2, sources));
+		scheduler.run();
+		EXPECT_TRUE(sources.empty());
+
+		scheduler.push(node2.outputs.begin(), 5);
+		scheduler.run();
+		ASSERT_EQ(1, sources.size());
+		EXPECT_EQ(2, sources[0]);
+
+		scheduler.push(node1.outputs.begin(), 7);
+		scheduler.run();
+		ASSERT_EQ(2, sources.size());
+		EXPECT_EQ(1, sources[1]);
+		EXPECT_EQ(0, scheduler.live());
+	}
+
+} //anonymous namespace
+
+int main(int argc, char **argv) {
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
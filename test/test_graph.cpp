@@ -25,12 +25,24 @@
 #include <iostream>
 #include <vector>
 #include <random>
+#include <cstdio>
+#include <stdexcept>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <atomic>
 #include "gtest/gtest.h"
 #include "Buffer.h"
 #include "Port.h"
 #include "Graph.h"
 #include "DirectedNode.h"
 #include "UndirectedNode.h"
+#include "CSR.h"
+#include "Partition.h"
+#include "Snapshot.h"
+#include "Batch.h"
+#include "Connectivity.h"
 
 namespace {
 
@@ -220,6 +232,64 @@ namespace {
 		path4.set_value(value1);
 	}
 
+	TEST(Commons, Locking) {
+		using namespace ben;
+		for(bool writers_first : {true, false}) {
+			Commons commons(writers_first);
+			//tries a lock from a second thread, since a thread mustn't retake a lock it holds
+			auto can_read = [&]() {
+				bool locked = false;
+				std::thread([&]() { if( (locked = commons.try_read_lock()) ) commons.read_unlock(); }).join();
+				return locked;
+			};
+			auto can_write = [&]() {
+				bool locked = false;
+				std::thread([&]() { if( (locked = commons.try_write_lock()) ) commons.write_unlock(); }).join();
+				return locked;
+			};
+			EXPECT_EQ(writers_first, commons.writer_preference());
+			EXPECT_TRUE(commons.try_read_lock());
+			EXPECT_TRUE(can_read());
+			EXPECT_FALSE(can_write());
+			commons.read_unlock();
+			EXPECT_TRUE(commons.try_write_lock());
+			EXPECT_FALSE(can_read());
+			EXPECT_FALSE(can_write());
+			commons.write_unlock();
+			{
+				ScopedReadLock lock(commons);
+				EXPECT_TRUE(lock);
+				EXPECT_FALSE(can_write());
+			}
+			EXPECT_TRUE(commons.try_write_lock());
+			commons.write_unlock();
+
+			//readers check that writers never leave a half-finished state showing
+			long first = 0, second = 0;
+			std::atomic<long> torn(0);
+			std::vector<std::thread> threads;
+			for(unsigned t=0; t<4; ++t) {
+				threads.emplace_back([&]() {
+					for(unsigned i=0; i<2000; ++i) {
+						if(i % 50 == 0) {
+							ScopedWriteLock lock(commons);
+							++first;
+							std::this_thread::yield();
+							++second;
+						} else {
+							ScopedReadLock lock(commons);
+							if(first != second) ++torn;
+						}
+					}
+				});
+			}
+			for(auto& x : threads) x.join();
+			EXPECT_EQ(0, torn.load());
+			EXPECT_EQ(4*40, first);
+			EXPECT_EQ(first, second);
+		}
+	}
+
 
 	class DirectedNodes : public ::testing::Test {
 	protected:
@@ -698,6 +768,44 @@ namespace {
 
 			delete node1_ptr, node2_ptr, node3_ptr;
 		}
+		template<typename N>
+		void test_levels() {
+			using namespace ben;
+			typedef N node_type;
+			typedef Graph<node_type> graph_type;
+			auto graph1_ptr = std::make_shared<graph_type>();
+
+			node_type node1(graph1_ptr, 3), node2(graph1_ptr, 5), node3(graph1_ptr, 7), node4(graph1_ptr, 11);
+			EXPECT_EQ(4, graph1_ptr->levels()[0].size());
+			auto version = graph1_ptr->get_link_version();
+
+			node1.add_output(5);
+			node1.add_output(7);
+			node2.add_output(11);
+			node3.add_output(11);
+			node2.add_output(7);
+			EXPECT_LT(version, graph1_ptr->get_link_version());
+
+			auto& levels = graph1_ptr->levels();
+			EXPECT_TRUE(graph1_ptr->acyclic());
+			ASSERT_EQ(4, levels.size());
+			EXPECT_EQ(&node1, levels[0][0]);
+			EXPECT_EQ(&node2, levels[1][0]);
+			EXPECT_EQ(&node3, levels[2][0]);
+			EXPECT_EQ(&node4, levels[3][0]);
+			EXPECT_EQ(2, graph1_ptr->position(7));
+			EXPECT_EQ(4, graph1_ptr->position(8));
+
+			node2.remove_output(7); //cached levels are recomputed after links change
+			EXPECT_EQ(3, graph1_ptr->levels().size());
+			EXPECT_EQ(2, graph1_ptr->levels()[1].size());
+
+			node4.add_output(3);
+			EXPECT_FALSE(graph1_ptr->acyclic());
+			EXPECT_EQ(0, graph1_ptr->levels().size());
+			node4.clear();
+			EXPECT_TRUE(graph1_ptr->acyclic());
+		}
 	};
 
 	TEST_F(Graphs, DirectedNode_Add_Remove) {
@@ -715,6 +823,276 @@ namespace {
 		typedef stdMessageNode<double, 1> node_type;
 		test_content<node_type>();
 	}
+	TEST_F(Graphs, DirectedNode_Levels) {
+		using namespace ben;
+		typedef stdMessageNode<double, 1> node_type;
+		test_levels<node_type>();
+	}
+	TEST_F(Graphs, DirectedNode_CSR) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph1_ptr = std::make_shared< Graph<node_type> >();
+		node_type node1(graph1_ptr, 3), node2(graph1_ptr, 5), node3(graph1_ptr, 7);
+		node1.add_output(5, 0.5);
+		node1.add_output(7, 0.25);
+		node2.add_output(7, 2.0);
+
+		CSR<double> outgoing(*graph1_ptr);
+		EXPECT_EQ(3, outgoing.size());
+		EXPECT_EQ(3, outgoing.edges());
+		EXPECT_EQ(graph1_ptr->get_link_version(), outgoing.version());
+		EXPECT_EQ(1, outgoing.position(5));
+		EXPECT_EQ(3, outgoing.position(6));
+		EXPECT_EQ(7, outgoing.id(2));
+		ASSERT_EQ(2, outgoing.degree(0));
+		EXPECT_EQ(1, outgoing.begin(0)[0]);
+		EXPECT_EQ(2, outgoing.begin(0)[1]);
+		EXPECT_EQ(0.25, outgoing.weights_of(0)[1]);
+		EXPECT_EQ(0, outgoing.degree(2));
+
+		CSR<double> incoming(*graph1_ptr, Direction::incoming);
+		ASSERT_EQ(2, incoming.degree(2));
+		EXPECT_EQ(2.0, incoming.weights_of(2)[1]);
+		CSR<double> both(*graph1_ptr, Direction::both);
+		EXPECT_EQ(6, both.edges());
+	}
+	TEST_F(Graphs, DirectedNode_Partition) {
+		using namespace ben;
+		typedef stdMessageNode<double, 1> node_type;
+		auto graph1_ptr = std::make_shared< Graph<node_type> >();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<40; ++i) nodes.emplace_back( new node_type(graph1_ptr, i) );
+		//two interleaved cliques, even and odd IDs, joined by one link
+		for(unsigned i=0; i<40; ++i) for(unsigned j=i+2; j<40; j+=2) nodes[i]->add_output(j);
+		nodes[0]->add_output(1);
+
+		Partition<node_type> partition(*graph1_ptr, 2, 20);
+		EXPECT_EQ(2, partition.parts());
+		EXPECT_EQ(2, partition.edge_cut()); //the bridge, listed at both ends
+		EXPECT_EQ(20, partition.size(0));
+		for(unsigned i=2; i<40; ++i) EXPECT_EQ(partition.part_of(i % 2), partition.part_of(i));
+		EXPECT_EQ(2, partition.part_of(1000));
+		for(auto iter=partition.begin(1); iter!=partition.end(1); ++iter)
+			EXPECT_EQ(1, partition.part_of((*iter)->ID()));
+	}
+	TEST_F(Graphs, DirectedNode_Snapshot) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		typedef Graph<node_type> graph_type;
+		auto graph1_ptr = std::make_shared<graph_type>();
+		node_type node1(graph1_ptr, 3), node2(graph1_ptr, 5), node3(graph1_ptr, 7);
+		node1.add_output(5, 0.5);
+		node1.add_output(7, 0.25);
+		node2.add_output(7, 2.0);
+		const std::string filename = "test_graph.snapshot";
+		ASSERT_TRUE(write_snapshot(*graph1_ptr, filename));
+
+		SnapshotView view(filename);
+		ASSERT_TRUE(view.is_open());
+		EXPECT_TRUE(view.directed());
+		EXPECT_EQ(3, view.size());
+		EXPECT_EQ(3, view.links());
+		EXPECT_EQ(2, view.position(7));
+		EXPECT_EQ(3, view.position(6));
+		ASSERT_EQ(2, view.degree(0));
+		EXPECT_EQ(2, view.begin(0)[1]);
+		EXPECT_EQ(0.25, view.value<double>(0, 1));
+
+		auto graph2_ptr = std::make_shared<graph_type>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		EXPECT_TRUE(view.materialize(graph2_ptr, [&](std::shared_ptr<graph_type> graph, unsigned id) -> node_type& {
+			nodes.emplace_back( new node_type(graph, id) );
+			return *nodes.back();
+		}));
+		EXPECT_EQ(3, graph2_ptr->size());
+		EXPECT_TRUE(graph2_ptr->elem(3).outputs.contains(7));
+		EXPECT_EQ(2.0, graph2_ptr->elem(7).inputs.find(5)->get_value());
+		EXPECT_EQ(0, graph2_ptr->elem(7).outputs.size());
+
+		auto graph3_ptr = std::make_shared< Graph<stdUndirectedNode<double>> >();
+		EXPECT_FALSE(view.materialize(graph3_ptr, [](std::shared_ptr< Graph<stdUndirectedNode<double>> >, unsigned) 
+			-> stdUndirectedNode<double>& { throw std::logic_error("directedness is checked first"); }));
+
+		//hand-edited copies, each inconsistent in one way
+		std::string bytes;
+		{
+			std::ifstream in(filename, std::ios::binary);
+			bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+		SnapshotHeader header;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		const std::string corrupt = "test_graph_corrupt.snapshot";
+		auto edit = [&](const size_t position, const uint64_t x, const size_t size) {
+			std::string copy(bytes);
+			std::memcpy(&copy[position], &x, size);
+			std::ofstream(corrupt, std::ios::binary).write(copy.data(), copy.size());
+			return SnapshotView(corrupt);
+		};
+		auto opens = [&](const size_t position, const uint64_t x, const size_t size) {
+			return edit(position, x, size).is_open();
+		};
+		auto validates = [&](const size_t position, const uint64_t x, const size_t size) {
+			SnapshotView copy = edit(position, x, size);
+			EXPECT_TRUE(copy.is_open()); //opening reads only the header
+			return copy.validate();
+		};
+		EXPECT_TRUE(opens(0, bytes[0], 1)); //unchanged
+		EXPECT_TRUE(validates(0, bytes[0], 1));
+		EXPECT_FALSE(opens(offsetof(SnapshotHeader, id_offset), bytes.size(), 8)); //past the end
+		EXPECT_FALSE(opens(offsetof(SnapshotHeader, offset_offset), header.offset_offset + 4, 8)); //misaligned
+		EXPECT_FALSE(opens(offsetof(SnapshotHeader, nodes), ~uint64_t(0) / 2, 8)); //overflows
+		EXPECT_FALSE(validates(header.offset_offset, 1, 8)); //offsets[0] isn't 0
+		EXPECT_FALSE(validates(header.offset_offset + 8*3, 2, 8)); //doesn't end at links
+		EXPECT_FALSE(validates(header.offset_offset + 8*2, 1, 8)); //not monotone
+		EXPECT_FALSE(validates(header.target_offset, 3, 4)); //no such node
+		{
+			SnapshotView copy = edit(header.target_offset, 3, 4);
+			EXPECT_FALSE(copy.materialize(graph2_ptr, [](std::shared_ptr<graph_type>, unsigned) -> node_type& {
+				throw std::logic_error("validated first");
+			}));
+		}
+		std::remove(corrupt.c_str());
+		std::remove(filename.c_str());
+		EXPECT_FALSE(SnapshotView(filename).is_open());
+	}
+	TEST_F(Graphs, UndirectedNode_Snapshot) {
+		using namespace ben;
+		typedef stdUndirectedNode<double> node_type;
+		typedef Graph<node_type> graph_type;
+		auto graph1_ptr = std::make_shared<graph_type>();
+		node_type node1(graph1_ptr, 1), node2(graph1_ptr, 2), node3(graph1_ptr, 3);
+		ASSERT_TRUE(node1.add(1, 0.5)); //a link to self
+		node1.add(2, 0.25);
+		node2.add(3, 2.0);
+		const std::string filename = "test_graph_undirected.snapshot";
+		ASSERT_TRUE(write_snapshot(*graph1_ptr, filename));
+
+		SnapshotView view(filename);
+		ASSERT_TRUE(view.is_open());
+		EXPECT_TRUE(view.validate());
+		EXPECT_FALSE(view.directed());
+		EXPECT_EQ(3, view.size());
+		EXPECT_EQ(6, view.links()); //each link under both ends, the link to self twice under node 1
+
+		auto graph2_ptr = std::make_shared<graph_type>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		EXPECT_TRUE(view.materialize(graph2_ptr, [&](std::shared_ptr<graph_type> graph, unsigned id) -> node_type& {
+			nodes.emplace_back( new node_type(graph, id) );
+			return *nodes.back();
+		}));
+		for(unsigned id : {1, 2, 3}) EXPECT_EQ(graph1_ptr->elem(id).size(), graph2_ptr->elem(id).size());
+		EXPECT_EQ(0.5, graph2_ptr->elem(1).find(1)->get_value());
+		EXPECT_EQ(0.25, graph2_ptr->elem(2).find(1)->get_value());
+		EXPECT_EQ(2.0, graph2_ptr->elem(3).find(2)->get_value());
+		std::remove(filename.c_str());
+	}
+	TEST_F(Graphs, DirectedNode_Batch) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph1_ptr = std::make_shared< Graph<node_type> >();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<10; ++i) nodes.emplace_back( new node_type(graph1_ptr, i) );
+		for(unsigned i=1; i<10; ++i) nodes[0]->add_output(i, 1.0);
+
+		auto batch = graph1_ptr->batch();
+		for(unsigned i=1; i<10; i+=2) batch.remove(0, i);
+		batch.add(3, 4, 2.5);
+		batch.add(0, 2, 0.5); //removals come first, so this replaces the link...
+		batch.remove(0, 2);
+		batch.add(0, 2, 0.5); //...and this is a duplicate
+		batch.add(42, 1); //no such node
+		EXPECT_EQ(10, batch.size());
+		auto version = graph1_ptr->get_link_version();
+		EXPECT_EQ(8, batch.apply());
+		EXPECT_TRUE(batch.empty());
+		EXPECT_LT(version, graph1_ptr->get_link_version());
+
+		EXPECT_EQ(4, nodes[0]->outputs.size());
+		EXPECT_FALSE(nodes[0]->outputs.contains(5));
+		EXPECT_FALSE(nodes[5]->inputs.contains(0));
+		EXPECT_EQ(0.5, nodes[0]->outputs.find(2)->get_value());
+		EXPECT_EQ(0.5, nodes[2]->inputs.find(0)->get_value());
+		EXPECT_EQ(2.5, nodes[4]->inputs.find(3)->get_value());
+
+		EXPECT_EQ(2, nodes[0]->remove_outputs({2, 4, 11}));
+		EXPECT_FALSE(nodes[4]->inputs.contains(0));
+		EXPECT_EQ(1, nodes[4]->remove_inputs({3}));
+		EXPECT_EQ(0, nodes[3]->outputs.size());
+
+		typedef stdUndirectedNode<double> undirected_type;
+		auto graph2_ptr = std::make_shared< Graph<undirected_type> >();
+		undirected_type node1(graph2_ptr, 1), node2(graph2_ptr, 2), node3(graph2_ptr, 3);
+		node1.add(2, 1.0);
+		auto batch2 = graph2_ptr->batch();
+		batch2.add(3, 1, 4.0);
+		batch2.remove(2, 1); //filed under node 1, like the link it removes
+		EXPECT_EQ(2, batch2.apply());
+		EXPECT_FALSE(node2.contains(1));
+		EXPECT_EQ(4.0, node1.find(3)->get_value());
+		EXPECT_EQ(4.0, node3.find(1)->get_value());
+	}
+	TEST_F(Graphs, DirectedNode_ChangeLog) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph1_ptr = std::make_shared< Graph<node_type> >();
+		EXPECT_FALSE(graph1_ptr->get_log());
+		node_type node1(graph1_ptr, 3);
+		graph1_ptr->enable_log(8);
+		auto log = graph1_ptr->get_log();
+		ASSERT_TRUE(log);
+		EXPECT_EQ(8, log->capacity());
+
+		unsigned long cursor = log->head();
+		{
+			node_type node2(graph1_ptr, 5);
+			node1.add_output(5, 1.0);
+			EXPECT_TRUE(node1.set_value(5, 2.0));
+			EXPECT_FALSE(node1.set_value(7, 2.0)); //no such output, not recorded
+			EXPECT_EQ(2.0, node2.inputs.find(3)->get_value());
+			node1.remove_output(5);
+			node1.remove_output(5); //not there, not recorded
+		}
+		std::vector<ChangeEvent> events;
+		EXPECT_TRUE(log->read(cursor, [&](const ChangeEvent& x) { events.push_back(x); }));
+		EXPECT_EQ(log->head(), cursor);
+		ASSERT_EQ(5, events.size());
+		EXPECT_TRUE(ChangeKind::joined == events[0].kind);
+		EXPECT_EQ(5, events[0].source);
+		EXPECT_TRUE(ChangeKind::link_added == events[1].kind);
+		EXPECT_EQ(3, events[1].source);
+		EXPECT_EQ(5, events[1].target);
+		EXPECT_TRUE(ChangeKind::value_changed == events[2].kind);
+		EXPECT_EQ(3, events[2].source);
+		EXPECT_EQ(5, events[2].target);
+		EXPECT_TRUE(ChangeKind::link_removed == events[3].kind);
+		EXPECT_TRUE(ChangeKind::left == events[4].kind);
+		EXPECT_EQ(events[3].sequence + 1, events[4].sequence);
+
+		//a consumer that falls behind is told so
+		for(unsigned i=0; i<20; ++i) graph1_ptr->value_changed(3, i);
+		events.clear();
+		EXPECT_FALSE(log->read(cursor, [&](const ChangeEvent& x) { events.push_back(x); }));
+		ASSERT_EQ(8, events.size());
+		EXPECT_EQ(19, events.back().target);
+		graph1_ptr->disable_log();
+		EXPECT_FALSE(graph1_ptr->get_log());
+
+		//undirected nodes log values set through either end
+		typedef stdUndirectedNode<double> undirected_type;
+		auto graph2_ptr = std::make_shared< Graph<undirected_type> >();
+		undirected_type node3(graph2_ptr, 1), node4(graph2_ptr, 2);
+		node3.add(2, 1.0);
+		graph2_ptr->enable_log(8);
+		cursor = graph2_ptr->get_log()->head();
+		EXPECT_TRUE(node4.set_value(1, 3.0));
+		EXPECT_EQ(3.0, node3.find(2)->get_value());
+		events.clear();
+		EXPECT_TRUE(graph2_ptr->get_log()->read(cursor, [&](const ChangeEvent& x) { events.push_back(x); }));
+		ASSERT_EQ(1, events.size());
+		EXPECT_TRUE(ChangeKind::value_changed == events[0].kind);
+		EXPECT_EQ(2, events[0].source);
+		EXPECT_EQ(1, events[0].target);
+	}
 	TEST_F(Graphs, UndirectedNode_Add_Remove) {
 		using namespace ben;
 		typedef stdUndirectedNode<double> node_type;
@@ -730,6 +1108,41 @@ namespace {
 		typedef stdUndirectedNode<double> node_type;
 		test_content<node_type>();
 	}
+	TEST_F(Graphs, UndirectedNode_Connectivity) {
+		using namespace ben;
+		typedef stdUndirectedNode<double> node_type;
+		auto graph1_ptr = std::make_shared< Graph<node_type> >();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<6; ++i) nodes.emplace_back( new node_type(graph1_ptr, i) );
+		nodes[0]->add(1, 1.0);
+
+		Connectivity<node_type> connectivity(graph1_ptr);
+		EXPECT_TRUE(graph1_ptr->get_log());
+		EXPECT_EQ(5, connectivity.components());
+		EXPECT_TRUE(connectivity.connected(1, 0));
+		EXPECT_FALSE(connectivity.connected(1, 2));
+		EXPECT_FALSE(connectivity.connected(1, 42));
+
+		nodes[1]->add(2, 1.0);
+		nodes[3]->add(4, 1.0);
+		nodes.emplace_back( new node_type(graph1_ptr, 6) );
+		nodes[6]->add(5, 1.0);
+		EXPECT_TRUE(connectivity.connected(0, 2));
+		EXPECT_TRUE(connectivity.connected(5, 6));
+		EXPECT_EQ(3, connectivity.components());
+		EXPECT_EQ(3, connectivity.component_size(2));
+		EXPECT_EQ(1, connectivity.get_rebuilds()); //additions never rebuild
+
+		nodes[1]->remove(2);
+		EXPECT_FALSE(connectivity.connected(0, 2));
+		EXPECT_EQ(2, connectivity.get_rebuilds());
+		nodes[3]->clear();
+		nodes[5]->leave_index();
+		EXPECT_FALSE(connectivity.connected(3, 4));
+		EXPECT_FALSE(connectivity.connected(5, 6));
+		EXPECT_EQ(5, connectivity.components());
+		EXPECT_EQ(3, connectivity.get_rebuilds()); //one rebuild for both changes
+	}
 
 } //anonymous namespace 
 
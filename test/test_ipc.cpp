@@ -0,0 +1,240 @@
+/*
+	Benoit: a flexible framework for distributed graphs and spaces
+	Copyright (C) 2013  John Wendell Hall
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	The author may be reached at jackhall@utexas.edu.
+*/
+
+//to compile and run:
+//	g++ -std=c++11 -g -I../src test_ipc.cpp -o test_ipc -lgtest -lpthread -latomic -lrt
+//	./test_ipc
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "Graph.h"
+#include "DirectedNode.h"
+#include "SharedBuffer.h"
+#include "SocketBuffer.h"
+
+namespace {
+
+	struct Sample {
+		unsigned int count;
+		double value;
+	};
+
+	int wait_for(const pid_t child) {
+		//the child's exit status, or -1
+		int status = 0;
+		if( waitpid(child, &status, 0) != child or !WIFEXITED(status) ) return -1;
+		return WEXITSTATUS(status);
+	}
+
+	template<typename P>
+	int receive_until(P& input, const unsigned first, const unsigned last) {
+		//for a child process: 0 if counts up to last arrive in order within 20 s, starting at or after first
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+		Sample sample{0, 0.0};
+		unsigned previous = 0, received = 0;
+		while(received == 0 or previous < last) {
+			if( input.pull(sample) ) {
+				if( sample.count < first or (received > 0 and sample.count <= previous) ) return 1;
+				if( sample.value != 2.0*sample.count ) return 1;
+				previous = sample.count;
+				++received;
+			} else if(std::chrono::steady_clock::now() > deadline) return 2;
+			else std::this_thread::yield();
+		}
+		return 0;
+	}
+
+	TEST(SharedBuffers, Local) {
+		using namespace ben;
+		SharedBuffer<double, 1> link1;
+		ASSERT_TRUE(link1.is_open());
+		double signal = 0.0;
+		EXPECT_FALSE(link1.pull(signal));
+		EXPECT_TRUE(link1.push(1.0));
+		EXPECT_FALSE(link1.push(2.0)); //overwrites 1.0, like Buffer<S,1>
+		EXPECT_TRUE(link1.pull(signal));
+		EXPECT_EQ(2.0, signal);
+		EXPECT_FALSE(link1.pull(signal));
+
+		SharedBuffer<Sample, 4> link4;
+		Sample sample{0, 0.0};
+		for(unsigned i=0; i<4; ++i) EXPECT_TRUE(link4.push(Sample{i, 0.5*i}));
+		EXPECT_FALSE(link4.push(Sample{4, 2.0}));
+		for(unsigned i=1; i<5; ++i) { //the oldest was lost
+			EXPECT_TRUE(link4.pull(sample));
+			EXPECT_EQ(i, sample.count);
+			EXPECT_EQ(0.5*i, sample.value);
+		}
+		EXPECT_FALSE(link4.pull(sample));
+
+		const std::string name = "/benoit_test_local";
+		SharedBuffer<double, 4>::unlink(name);
+		{
+			SharedBuffer<double, 4> writer(name), reader("benoit_test_local"); //the slash is optional
+			ASSERT_TRUE(writer.is_open());
+			ASSERT_TRUE(reader.is_open());
+			EXPECT_EQ(name, reader.channel());
+			SharedBuffer<double, 8> mismatched(name);
+			EXPECT_FALSE(mismatched.is_open());
+			EXPECT_FALSE(mismatched.push(1.0));
+			writer.push(3.0);
+			EXPECT_TRUE(reader.pull(signal));
+			EXPECT_EQ(3.0, signal);
+		}
+		EXPECT_TRUE( (SharedBuffer<double, 4>::unlink(name)) );
+		EXPECT_FALSE( (SharedBuffer<double, 4>::unlink(name)) );
+	}
+
+	TEST(SharedBuffers, Processes) {
+		using namespace ben;
+		typedef SharedBuffer<Sample, 64> buffer_type;
+		typedef DirectedNode< InPort<buffer_type>, OutPort<buffer_type> > node_type;
+		const std::string name = "/benoit_test_processes";
+		const unsigned n = 100000;
+		buffer_type::unlink(name);
+
+		pid_t child = fork();
+		ASSERT_LE(0, child);
+		if(child == 0) {
+			//a standalone InPort, with no Graph in this process
+			InPort<buffer_type> input(1, name);
+			_exit( receive_until(input, 0, n-1) );
+		}
+
+		auto graph_ptr = std::make_shared< Graph<node_type> >();
+		node_type node1(graph_ptr, 1), node2(graph_ptr, 2);
+		ASSERT_TRUE(node1.add_output(2, name));
+		auto output = node1.outputs.find(2);
+		unsigned lost = 0;
+		for(unsigned i=0; i<n; ++i) {
+			if( !output->push(Sample{i, 2.0*i}) ) ++lost;
+			if(i % 32 == 0) std::this_thread::yield();
+		}
+		EXPECT_EQ(0, wait_for(child));
+		EXPECT_GT(n, lost);
+		EXPECT_TRUE(buffer_type::unlink(name));
+
+		//anonymous segments are shared with children forked afterward
+		buffer_type anonymous;
+		child = fork();
+		ASSERT_LE(0, child);
+		if(child == 0) _exit(anonymous.push(Sample{7, 14.0}) ? 0 : 1);
+		EXPECT_EQ(0, wait_for(child));
+		Sample sample{0, 0.0};
+		EXPECT_TRUE(anonymous.pull(sample));
+		EXPECT_EQ(7, sample.count);
+	}
+
+	TEST(SocketBuffers, Local) {
+		using namespace ben;
+		SocketBuffer<double, 4> unaddressed;
+		EXPECT_FALSE(unaddressed.is_open());
+		EXPECT_FALSE(unaddressed.push(1.0));
+
+		for(std::string address : {"/tmp/benoit_test_local.sock", "tcp://127.0.0.1:47613"}) {
+			SCOPED_TRACE(address);
+			SocketBuffer<double, 1> link(address); //the same Buffer at both ends
+			ASSERT_TRUE(link.is_open());
+			double signal = 0.0;
+			EXPECT_FALSE(link.pull(signal)); //starts listening
+			EXPECT_TRUE(link.push(1.5)); //starts connecting, and sends if that finishes at once
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while( !link.pull(signal) and std::chrono::steady_clock::now() < deadline ) {
+				link.flush(); //finishes the connection and sends
+				std::this_thread::yield();
+			}
+			EXPECT_TRUE(link.is_connected());
+			EXPECT_EQ(1.5, signal);
+		}
+	}
+
+	TEST(SocketBuffers, Backlog) {
+		//more than B signals wait in the socket before the first pull; each comes out once, in order
+		using namespace ben;
+		SocketBuffer<double, 4> link("/tmp/benoit_test_backlog.sock");
+		ASSERT_TRUE(link.is_open());
+		double signal = -1.0;
+		EXPECT_FALSE(link.pull(signal)); //starts listening
+		for(int i=0; i<10; ++i) {
+			link.push(i);
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while( !link.flush() and std::chrono::steady_clock::now() < deadline ) std::this_thread::yield();
+		}
+		std::vector<double> pulled;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while( pulled.size() < 10 and std::chrono::steady_clock::now() < deadline ) {
+			if( link.pull(signal) ) pulled.push_back(signal);
+			else std::this_thread::yield();
+		}
+		ASSERT_EQ(10, pulled.size());
+		for(int i=0; i<10; ++i) EXPECT_EQ(double(i), pulled[i]);
+	}
+
+	TEST(SocketBuffers, Processes) {
+		using namespace ben;
+		typedef SocketBuffer<Sample, 64> buffer_type;
+		typedef DirectedNode< InPort<buffer_type>, OutPort<buffer_type> > node_type;
+		const std::string address = "/tmp/benoit_test_" + std::to_string(getpid()) + ".sock";
+		const unsigned n = 100000;
+		auto flush = [](OutPort<buffer_type>& output) {
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+			while( !output.flush() and std::chrono::steady_clock::now() < deadline ) std::this_thread::yield();
+		};
+
+		pid_t child = fork();
+		ASSERT_LE(0, child);
+		if(child == 0) {
+			InPort<buffer_type> input(1, address);
+			_exit( receive_until(input, 0, n-1) );
+		}
+		auto graph_ptr = std::make_shared< Graph<node_type> >();
+		node_type node1(graph_ptr, 1), node2(graph_ptr, 2);
+		ASSERT_TRUE(node1.add_output(2, address));
+		auto output = node1.outputs.find(2);
+		for(unsigned i=0; i<n; ++i) output->push(Sample{i, 2.0*i});
+		flush(*output);
+		EXPECT_EQ(0, wait_for(child));
+
+		//the first receiver is gone; the OutPort reconnects to its replacement
+		child = fork();
+		ASSERT_LE(0, child);
+		if(child == 0) {
+			InPort<buffer_type> input(1, address);
+			_exit( receive_until(input, n, 2*n-1) );
+		}
+		for(unsigned i=n; i<2*n; ++i) output->push(Sample{i, 2.0*i});
+		flush(*output);
+		EXPECT_EQ(0, wait_for(child));
+		unlink(address.c_str());
+	}
+
+} //anonymous namespace
+
+int main(int argc, char **argv) {
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
+
@@ -0,0 +1,412 @@
+/*
+	Benoit: a flexible framework for distributed graphs and spaces
+	Copyright (C) 2013  John Wendell Hall
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	The author may be reached at jackhall@utexas.edu.
+*/
+
+//to compile and run:
+//	g++ -std=c++11 -g -I../src test_parallel.cpp -o test_parallel -lgtest -lpthread -latomic
+//	./test_parallel
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <atomic>
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "ThreadPool.h"
+#include "Graph.h"
+#include "DirectedNode.h"
+#include "Executor.h"
+#include "Dataflow.h"
+#include "Partition.h"
+#include "EdgeList.h"
+#include "Propagation.h"
+#include "UndirectedNode.h"
+#include "Clone.h"
+
+namespace {
+
+	TEST(ThreadPools, Parallel) {
+		using namespace ben;
+		ThreadPool pool(4);
+		EXPECT_EQ(4, pool.size());
+
+		std::vector<int> visits(pool.size(), 0);
+		for(int i=0; i<3; ++i) pool.parallel([&](const unsigned worker) { ++visits[worker]; });
+		for(int x : visits) EXPECT_EQ(3, x);
+
+		//an exception on the calling thread waits for the other workers before it leaves
+		std::atomic<int> finished(0);
+		EXPECT_THROW(pool.parallel([&](const unsigned worker) {
+			if(worker == 0) throw std::runtime_error("worker 0");
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			++finished;
+		}), std::runtime_error);
+		EXPECT_EQ(3, finished.load());
+		pool.parallel([&](const unsigned worker) { ++visits[worker]; });
+		for(int x : visits) EXPECT_EQ(4, x);
+
+		//so does one on any other worker, and the pool is still usable afterwards
+		finished.store(0);
+		EXPECT_THROW(pool.parallel([&](const unsigned worker) {
+			if(worker == 2) throw std::runtime_error("worker 2");
+			++finished;
+		}), std::runtime_error);
+		EXPECT_EQ(3, finished.load());
+		EXPECT_THROW(pool.parallel_for(100, 1, [&](const size_t first, const size_t) {
+			if(first == 99) throw std::runtime_error("last chunk");
+		}), std::runtime_error);
+		pool.parallel([&](const unsigned worker) { ++visits[worker]; });
+		for(int x : visits) EXPECT_EQ(5, x);
+	}
+
+	TEST(ThreadPools, ParallelFor) {
+		using namespace ben;
+		ThreadPool pool(3);
+		std::vector<std::atomic<int>> hits(1000);
+		for(auto& x : hits) x.store(0);
+
+		pool.parallel_for(hits.size(), 7, [&](const size_t first, const size_t last) {
+			for(size_t i=first; i<last; ++i) ++hits[i];
+		});
+		for(auto& x : hits) EXPECT_EQ(1, x.load());
+
+		//skewed work still covers every item exactly once
+		pool.parallel_for(hits.size(), 1, [&](const size_t first, const size_t last) {
+			if(first < 10) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			for(size_t i=first; i<last; ++i) ++hits[i];
+		});
+		for(auto& x : hits) EXPECT_EQ(2, x.load());
+
+		pool.parallel_for(0, 4, [&](const size_t, const size_t) { ADD_FAILURE(); });
+	}
+
+	TEST(Executors, Sweep) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph_ptr = std::make_shared<Graph<node_type>>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<100; ++i) nodes.emplace_back( new node_type(graph_ptr, 100-i) );
+		for(unsigned i=1; i<100; ++i) nodes[i]->add_input(nodes[i-1]->ID(), 1.0);
+
+		auto& order = graph_ptr->ordering();
+		ASSERT_EQ(100, order.size());
+		for(unsigned i=1; i<order.size(); ++i) EXPECT_LT(order[i-1]->ID(), order[i]->ID());
+
+		ThreadPool pool(4);
+		Executor<node_type> executor(pool, 8);
+		std::atomic<int> count(0);
+		executor.run(graph_ptr, [&](node_type& node) {
+			for(auto& x : node.outputs) x.set_value(x.get_value() + 1.0);
+			++count;
+		});
+		EXPECT_EQ(100, count.load());
+		for(unsigned i=1; i<100; ++i) EXPECT_EQ(2.0, nodes[i]->inputs.begin()->get_value());
+
+		nodes.pop_back(); //ordering is rebuilt after membership changes
+		EXPECT_EQ(99, graph_ptr->ordering().size());
+	}
+
+	TEST(Executors, Levels) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph_ptr = std::make_shared<Graph<node_type>>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<40; ++i) nodes.emplace_back( new node_type(graph_ptr, i) );
+		for(unsigned i=4; i<40; ++i) { //four nodes per layer, each fed by the whole previous layer
+			for(unsigned j=(i/4-1)*4; j<(i/4)*4; ++j) nodes[i]->add_input(j, 0.0);
+		}
+		ASSERT_EQ(10, graph_ptr->levels().size());
+
+		ThreadPool pool(3);
+		Executor<node_type> executor(pool, 2);
+		std::vector<double> value(40, 0.0);
+		auto forward = [&](node_type& node) {
+			double total = 1.0;
+			for(auto& x : node.inputs) total += value[x.get_address()];
+			value[node.ID()] = total;
+		};
+		executor.run_levels(*graph_ptr, forward);
+		EXPECT_EQ(1.0, value[0]);
+		EXPECT_EQ(5.0, value[4]);
+		EXPECT_EQ(21.0, value[8]);
+
+		//pipelined batches give the same answers as running each batch alone
+		const size_t batches = 5;
+		std::vector< std::vector<double> > piped(batches, std::vector<double>(40, 0.0));
+		executor.run_pipelined(*graph_ptr, batches, [&](node_type& node, const size_t batch) {
+			double total = double(batch);
+			for(auto& x : node.inputs) total += piped[batch][x.get_address()];
+			piped[batch][node.ID()] = total;
+		});
+		for(size_t b=0; b<batches; ++b) {
+			std::vector<double> expected(40, 0.0);
+			for(auto& level : graph_ptr->levels()) for(auto node : level) {
+				double total = double(b);
+				for(auto& x : node->inputs) total += expected[x.get_address()];
+				expected[node->ID()] = total;
+			}
+			EXPECT_EQ(expected, piped[b]);
+		}
+	}
+
+	TEST(Executors, Partitions) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph_ptr = std::make_shared<Graph<node_type>>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<60; ++i) nodes.emplace_back( new node_type(graph_ptr, i) );
+		for(unsigned i=0; i<60; ++i) nodes[i]->add_output((i+1) % 60, 0.0);
+		Partition<node_type> partition(*graph_ptr, 6);
+
+		ThreadPool pool(3);
+		//pinning binds this thread too, as worker 0, so put it back afterwards for the other tests
+#ifdef __linux__
+		cpu_set_t original;
+		bool saved = pthread_getaffinity_np(pthread_self(), sizeof(original), &original) == 0;
+#endif
+		pool.pin_workers(); //may fail in a restricted environment; only placement changes
+		Executor<node_type> executor(pool);
+		std::vector<int> owner(60, -1);
+		executor.run_partitions(partition, [&](node_type& node) { owner[node.ID()] = partition.part_of(node.ID()); });
+		for(unsigned i=0; i<60; ++i) EXPECT_EQ(partition.part_of(i), owner[i]);
+#ifdef __linux__
+		if(saved) {
+			EXPECT_EQ(0, pthread_setaffinity_np(pthread_self(), sizeof(original), &original));
+		}
+#endif
+	}
+
+	TEST(Dataflow, Chain) {
+		using namespace ben;
+		typedef stdMessageNode<double, 1> node_type;
+		auto graph_ptr = std::make_shared<Graph<node_type>>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<50; ++i) nodes.emplace_back( new node_type(graph_ptr, i+1) );
+		for(unsigned i=1; i<50; ++i) nodes[i]->add_input(nodes[i-1]->ID());
+
+		ThreadPool pool(2);
+		DataflowScheduler<node_type> scheduler(pool, *graph_ptr);
+		EXPECT_EQ(50, scheduler.size());
+		EXPECT_TRUE(scheduler.idle());
+		EXPECT_FALSE(scheduler.activate(1000));
+		EXPECT_TRUE(scheduler.activate(1));
+		EXPECT_TRUE(scheduler.is_ready(1));
+		EXPECT_FALSE(scheduler.is_ready(2));
+
+		std::vector<std::atomic<int>> steps(51);
+		for(auto& x : steps) x.store(0);
+		auto relay = [&](node_type& node, DataflowScheduler<node_type>& sched) {
+			++steps[node.ID()];
+			double signal = 1.0, total = 0.0;
+			for(auto& x : node.inputs) if( x.pull(signal) ) total += signal;
+			if(node.ID() == 1) total = 1.0;
+			for(auto iter=node.outputs.begin(); iter!=node.outputs.end(); ++iter) 
+				sched.push(iter, total + 1.0);
+		};
+
+		EXPECT_EQ(1, scheduler.run_tick(relay));
+		EXPECT_TRUE(scheduler.is_ready(2));
+		EXPECT_EQ(49, scheduler.run(relay));
+		EXPECT_TRUE(scheduler.idle());
+		for(unsigned i=1; i<=50; ++i) EXPECT_EQ(1, steps[i].load()); //each node ran exactly once
+
+		//a node with unread input is not rescheduled by a push that overwrites it
+		auto out = nodes[0]->outputs.begin();
+		EXPECT_TRUE(scheduler.push(out, 1.0));
+		EXPECT_FALSE(scheduler.push(out, 2.0));
+		EXPECT_EQ(1, scheduler.run_tick(relay));
+		EXPECT_EQ(2, steps[2].load());
+	}
+
+	TEST(EdgeLists, Load) {
+		using namespace ben;
+		const std::string filename = "test_parallel.edges";
+		{
+			std::ofstream out(filename.c_str());
+			out << "# a SNAP-style comment\n";
+			for(unsigned i=0; i<200; ++i) out << i << "\t" << (i+1) % 200 << "\n";
+			out << "3 oops\n";
+			out << "0 1\n"; //duplicate
+			out << "5 7"; //no final newline
+		}
+		typedef stdMessageNode<double, 1> message_type;
+		auto graph1_ptr = std::make_shared< Graph<message_type> >();
+		std::vector<std::unique_ptr<message_type>> nodes1;
+		auto make_message = [&](std::shared_ptr< Graph<message_type> > graph, unsigned id) -> message_type& {
+			nodes1.emplace_back( new message_type(graph, id) );
+			return *nodes1.back();
+		};
+
+		ThreadPool pool(3);
+		EdgeListLoader<message_type> loader(pool, 64); //small chunks split lines across reads
+		EXPECT_TRUE(loader.load(filename, graph1_ptr, make_message));
+		EXPECT_EQ(200, loader.nodes());
+		EXPECT_EQ(201, loader.links());
+		EXPECT_EQ(1, loader.malformed());
+		EXPECT_EQ(1, loader.duplicates());
+		EXPECT_EQ(200, graph1_ptr->size());
+		EXPECT_TRUE(graph1_ptr->elem(199).outputs.contains(0));
+		EXPECT_TRUE(graph1_ptr->elem(7).inputs.contains(5));
+		EXPECT_FALSE(loader.load("no_such_file.edges", graph1_ptr, make_message));
+
+		{
+			std::ofstream out(filename.c_str());
+			out << "%%MatrixMarket matrix coordinate real symmetric\n% comment\n3 3 2\n1 2 0.5\n2 3 2.5\n";
+		}
+		typedef stdDirectedNode<double> value_type;
+		auto graph2_ptr = std::make_shared< Graph<value_type> >();
+		std::vector<std::unique_ptr<value_type>> nodes2;
+		EdgeListLoader<value_type> matrix_loader(pool, 16);
+		EXPECT_TRUE(matrix_loader.load(filename, graph2_ptr, [&](std::shared_ptr< Graph<value_type> > graph, unsigned id) 
+			-> value_type& {
+			nodes2.emplace_back( new value_type(graph, id) );
+			return *nodes2.back();
+		}, EdgeFormat::matrix_market));
+		EXPECT_EQ(3, graph2_ptr->size());
+		EXPECT_EQ(4, matrix_loader.links());
+		EXPECT_EQ(0.5, graph2_ptr->elem(1).outputs.find(2)->get_value());
+		EXPECT_EQ(2.5, graph2_ptr->elem(3).outputs.find(2)->get_value());
+		std::remove(filename.c_str());
+	}
+
+	TEST(Propagation, PageRank) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph_ptr = std::make_shared<Graph<node_type>>();
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned i=0; i<60; ++i) nodes.emplace_back( new node_type(graph_ptr, i) );
+		std::default_random_engine gen;
+		std::uniform_int_distribution<unsigned> random_node(0, 59);
+		std::uniform_real_distribution<double> random_weight(0.5, 2.0);
+		for(unsigned i=0; i<300; ++i) {
+			unsigned source = random_node(gen);
+			if(source % 10 != 0) nodes[source]->add_output(random_node(gen), random_weight(gen)); //some dangling nodes
+		}
+
+		//naive sequential baseline, walking the nodes
+		const double d = 0.85;
+		std::vector<double> expected(60, 1.0/60), next(60);
+		for(int iteration=0; iteration<200; ++iteration) {
+			double dangling = 0.0;
+			for(unsigned i=0; i<60; ++i) if(nodes[i]->outputs.size() == 0) dangling += expected[i];
+			for(auto& x : next) x = (1.0 - d + d*dangling) / 60;
+			for(unsigned i=0; i<60; ++i) {
+				double total = 0.0;
+				for(auto& x : nodes[i]->outputs) total += x.get_value();
+				for(auto iter=nodes[i]->outputs.begin(); iter!=nodes[i]->outputs.end(); ++iter)
+					next[nodes[i]->walk(iter).ID()] += d * expected[i] * iter->get_value() / total;
+			}
+			expected.swap(next);
+		}
+
+		ThreadPool pool(3);
+		PageRank<double> pull(pool, d, 1e-12, 500);
+		pull.set_chunk_size(7);
+		EXPECT_LT(pull.run(*graph_ptr), 500);
+		EXPECT_GT(1e-12, pull.residual());
+		PageRank<double> push(pool, d, 1e-12, 500, Flow::push);
+		push.set_chunk_size(7);
+		push.run( CSR<double>(*graph_ptr) );
+		double sum = 0.0;
+		for(unsigned i=0; i<60; ++i) {
+			EXPECT_NEAR(expected[i], pull.score(i), 1e-9);
+			EXPECT_NEAR(expected[i], push.score(i), 1e-9);
+			sum += pull.scores()[i];
+		}
+		EXPECT_NEAR(1.0, sum, 1e-9);
+		EXPECT_EQ(0.0, pull.score(1000));
+
+		//the general kernel: x = x/2 + 1 around a cycle converges to 2 everywhere
+		for(unsigned i=0; i<60; ++i) nodes[i]->clear_outputs();
+		for(unsigned i=0; i<60; ++i) nodes[i]->add_output((i+1) % 60, 1.0);
+		std::vector<double> scores(60, 0.0);
+		propagate(pool, CSR<double>(*graph_ptr, Direction::incoming), scores, 
+			  [](size_t, double sum) { return 0.5*sum + 1.0; }, 1e-10, 200);
+		for(double x : scores) EXPECT_NEAR(2.0, x, 1e-9);
+	}
+	TEST(Graphs, Clone) {
+		using namespace ben;
+		typedef stdDirectedNode<double> node_type;
+		auto graph1_ptr = std::make_shared< Graph<node_type> >();
+		auto graph2_ptr = std::make_shared< Graph<node_type> >();
+		std::vector<std::unique_ptr<node_type>> nodes1, nodes2;
+		for(unsigned i=0; i<50; ++i) nodes1.emplace_back( new node_type(graph1_ptr, i) );
+		for(unsigned i=0; i<50; ++i) {
+			nodes1[i]->add_output((i+1) % 50, i);
+			nodes1[i]->add_output((i+7) % 50, 2.0*i);
+		}
+		nodes1[3]->add_output(3, 0.5);
+		std::vector<node_type*> originals;
+		for(unsigned i=0; i<40; ++i) originals.push_back(nodes1[i].get()); //leave out 40-49
+		auto make_node = [&](std::shared_ptr< Graph<node_type> > graph, unsigned id) -> node_type& {
+			nodes2.emplace_back( new node_type(graph, id) );
+			return *nodes2.back();
+		};
+
+		ThreadPool pool(3);
+		EXPECT_TRUE(clone_nodes(pool, originals, graph2_ptr, [](unsigned id) { return id + 100; }, make_node, 4));
+		EXPECT_EQ(40, graph2_ptr->size());
+		for(unsigned i=0; i<40; ++i) {
+			node_type& copy = graph2_ptr->elem(i + 100);
+			EXPECT_EQ(nodes1[i]->inputs.size() - (i < 7 ? 1 : 0) - (i == 0 ? 1 : 0), copy.inputs.size());
+			EXPECT_EQ((i < 33 ? 2 : (i < 39 ? 1 : 0)) + (i == 3 ? 1 : 0), copy.outputs.size());
+			if(i < 39) {
+				EXPECT_EQ(double(i), copy.outputs.find(i + 101)->get_value());
+			}
+		}
+		EXPECT_EQ(0.5, graph2_ptr->elem(103).inputs.find(103)->get_value());
+		EXPECT_EQ(20.0, graph2_ptr->elem(117).inputs.find(110)->get_value());
+		graph2_ptr->elem(110).outputs.find(117)->set_value(-1.0); //copies don't share values
+		EXPECT_EQ(-1.0, graph2_ptr->elem(117).inputs.find(110)->get_value());
+		EXPECT_EQ(20.0, nodes1[17]->inputs.find(10)->get_value());
+		EXPECT_FALSE(clone_nodes(pool, originals, graph2_ptr, [](unsigned id) { return id + 200; },
+					 [&](std::shared_ptr< Graph<node_type> > graph, unsigned id) -> node_type& { 
+						return make_node(graph, id + 1); }));
+
+		typedef stdUndirectedNode<double> undirected_type;
+		auto graph3_ptr = std::make_shared< Graph<undirected_type> >();
+		auto graph4_ptr = std::make_shared< Graph<undirected_type> >();
+		undirected_type node1(graph3_ptr, 1), node2(graph3_ptr, 2), node3(graph3_ptr, 3);
+		node1.add(2, 1.0);
+		node3.add(2, 2.0);
+		node2.add(2, 3.0);
+		std::vector<std::unique_ptr<undirected_type>> nodes4;
+		EXPECT_TRUE(clone_nodes(pool, std::vector<undirected_type*>{&node3, &node2, &node1}, graph4_ptr, 
+					[](unsigned id) { return id + 10; }, 
+					[&](std::shared_ptr< Graph<undirected_type> > graph, unsigned id) -> undirected_type& {
+						nodes4.emplace_back( new undirected_type(graph, id) );
+						return *nodes4.back(); }));
+		undirected_type& copy2 = graph4_ptr->elem(12);
+		EXPECT_EQ(node2.size(), copy2.size()); //links-to-self keep their pattern
+		EXPECT_EQ(3.0, copy2.find(12)->get_value());
+		EXPECT_EQ(2.0, graph4_ptr->elem(13).find(12)->get_value());
+		copy2.find(11)->set_value(5.0);
+		EXPECT_EQ(5.0, graph4_ptr->elem(11).find(12)->get_value());
+		EXPECT_EQ(1.0, node1.find(2)->get_value());
+	}
+
+} //anonymous namespace
+
+int main(int argc, char **argv) {
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
+
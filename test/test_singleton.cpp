@@ -23,8 +23,13 @@
 //	./test_singleton
 
 #include <iostream>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
 #include "Index.h"
 #include "Singleton.h"
+#include "Epoch.h"
 #include "gtest/gtest.h"
 
 namespace {
@@ -260,6 +265,56 @@ namespace {
 		EXPECT_TRUE( index1_ptr->manages(it->ID()) ); 
 		++it;
 		EXPECT_TRUE( index1_ptr->manages(it->ID()) ); 
+
+		//iterators into different Indexes never compare equal, not even at the end
+		auto index2_ptr = std::make_shared<index_type>();
+		EXPECT_TRUE( index1_ptr->end() == index1_ptr->end() );
+		EXPECT_FALSE( index1_ptr->end() == index2_ptr->end() );
+	}
+
+	TEST(IndexSingleton, ConcurrentLookups) {
+		using namespace ben;
+		typedef DerivedSingleton singleton_type;
+		typedef DerivedIndex<singleton_type> index_type;
+
+		auto index1_ptr = std::make_shared<index_type>();
+		std::vector<std::unique_ptr<singleton_type>> stable, churn;
+		for(unsigned i=0; i<100; ++i) stable.emplace_back( new singleton_type(index1_ptr, 100000 + i) );
+		auto iter = index1_ptr->find(100050); //placed in the map on the first increment
+		EXPECT_EQ(100050, iter->ID());
+		EXPECT_NE(index1_ptr->end(), ++iter);
+		EXPECT_EQ(index1_ptr->end(), index1_ptr->find(42));
+
+		//readers look up while a writer adds and removes enough to grow the table several times
+		std::atomic<bool> done(false);
+		std::atomic<long> wrong(0);
+		std::vector<std::thread> readers;
+		for(unsigned t=0; t<3; ++t) {
+			readers.emplace_back([&]() {
+				EpochReader reader;
+				do {
+					for(unsigned i=0; i<100; ++i) {
+						auto found = index1_ptr->find(100000 + i);
+						if(found == index1_ptr->end() or found->ID() != 100000 + i) ++wrong;
+						if(index1_ptr->elem(100000 + i).ID() != 100000 + i) ++wrong;
+						index1_ptr->manages(200000 + 37*i); //may be freed by the writer, so don't look closer
+					}
+					reader.quiescent();
+				} while(!done.load());
+			});
+		}
+		for(unsigned round=0; round<5; ++round) {
+			for(unsigned i=0; i<4000; ++i) churn.emplace_back( new singleton_type(index1_ptr, 200000 + round*4000 + i) );
+			churn.erase(churn.begin(), churn.begin() + churn.size()/2);
+			std::this_thread::yield();
+		}
+		done.store(true);
+		for(auto& x : readers) x.join();
+		EXPECT_EQ(0, wrong.load());
+		EXPECT_EQ(100 + churn.size(), index1_ptr->size());
+		for(auto& x : churn) EXPECT_TRUE( index1_ptr->check(x->ID(), x.get()) );
+		EpochDomain::global().synchronize();
+		EXPECT_EQ(0, EpochDomain::global().pending());
 	}
 	
 	TEST(IndexSingleton, GlobalMethods) {
@@ -0,0 +1,554 @@
+/*
+	Benoit: a flexible framework for distributed graphs and spaces
+	Copyright (C) 2013  John Wendell Hall
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	The author may be reached at jackhall@utexas.edu.
+*/
+
+//to compile and run:
+//	g++ -std=c++11 -g -I../src test_spatial.cpp -o test_spatial -lgtest -lpthread
+//	./test_spatial
+
+#include <vector>
+#include <map>
+#include <set>
+#include <random>
+#include <algorithm>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "Distance.h"
+#include "SpatialIndex.h"
+#include "KDTree.h"
+#include "CellList.h"
+#include "CoordinateArray.h"
+#include "RTree.h"
+#include "Morton.h"
+#include "Point.h"
+#include "Space.h"
+#include "Graph.h"
+#include "UndirectedNode.h"
+#include "Proximity.h"
+#include "Partition.h"
+
+namespace {
+
+	class SpatialIndexes : public ::testing::Test {
+	protected:
+		typedef std::array<double,3> point_type;
+		std::map<unsigned int, point_type> points; //what the index should hold
+		std::default_random_engine gen;
+
+		point_type random_point() {
+			std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+			return point_type{{coordinate(gen), coordinate(gen), coordinate(gen)}};
+		}
+		std::vector< std::pair<unsigned int, point_type> > fill(const unsigned int n) {
+			points.clear();
+			for(unsigned int i=0; i<n; ++i) points[i] = random_point();
+			return std::vector< std::pair<unsigned int, point_type> >(points.begin(), points.end());
+		}
+		void change(ben::SpatialIndex<double,3>& index, const unsigned int n) {
+			//n inserts, n/2 removals and n/2 moves, mirrored in points
+			std::uniform_int_distribution<unsigned int> pick(0, 2*points.size());
+			unsigned int next = points.empty() ? 0 : points.rbegin()->first + 1;
+			for(unsigned int i=0; i<n; ++i) {
+				point_type x = random_point();
+				EXPECT_TRUE(index.insert(next, x));
+				EXPECT_FALSE(index.insert(next, x));
+				points[next++] = x;
+			}
+			for(unsigned int i=0; i<n/2; ++i) {
+				unsigned int address = pick(gen);
+				EXPECT_EQ(points.erase(address) == 1, index.remove(address));
+			}
+			for(unsigned int i=0; i<n/2; ++i) {
+				unsigned int address = pick(gen);
+				point_type x = random_point();
+				bool present = points.count(address) == 1;
+				if(present) points[address] = x;
+				EXPECT_EQ(present, index.move(address, x));
+			}
+		}
+		void check(const ben::SpatialIndex<double,3>& index, const unsigned int queries) {
+			//compares every kind of query with a linear scan over points
+			using namespace ben;
+			ASSERT_EQ(points.size(), index.size());
+			std::uniform_real_distribution<double> size(0.5, 6.0);
+			std::vector<unsigned int> found, expected;
+			Neighbor neighbors[8];
+			for(unsigned int q=0; q<queries; ++q) {
+				point_type center = random_point();
+				double radius = size(gen);
+				Box<double,3> box = Box<double,3>::around(center, radius);
+				box.upper[1] += radius; //not a cube
+
+				found.clear();
+				expected.clear();
+				index.in_region(box, found);
+				for(auto& x : points) if( box.contains(x.second) ) expected.push_back(x.first);
+				std::sort(found.begin(), found.end());
+				EXPECT_EQ(expected, found);
+
+				found.clear();
+				expected.clear();
+				index.within(center, radius, found);
+				for(auto& x : points) if(squared_distance(center, x.second) <= radius*radius) expected.push_back(x.first);
+				std::sort(found.begin(), found.end());
+				EXPECT_EQ(expected, found);
+
+				std::vector<double> distances;
+				for(auto& x : points) distances.push_back( std::sqrt(squared_distance(center, x.second)) );
+				std::sort(distances.begin(), distances.end());
+				size_t count = index.nearest(center, 8, neighbors);
+				ASSERT_EQ(std::min(size_t(8), points.size()), count);
+				for(size_t i=0; i<count; ++i) {
+					EXPECT_DOUBLE_EQ(distances[i], neighbors[i].distance);
+					EXPECT_DOUBLE_EQ(neighbors[i].distance, std::sqrt(squared_distance(center, points[neighbors[i].id])));
+				}
+				unsigned int closest = 0;
+				EXPECT_EQ(!points.empty(), index.closest_to(center, closest));
+				if(!points.empty()) {
+					EXPECT_EQ(neighbors[0].id, closest);
+				}
+			}
+		}
+	};
+
+	TEST(Distances, Kernels) {
+		using namespace ben;
+		std::default_random_engine gen;
+		std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+		std::vector< std::array<double,5> > points(23); //not a multiple of 4
+		for(auto& x : points) for(auto& y : x) y = coordinate(gen);
+		std::array<double,5> query = points[7];
+		query[2] += 1.0;
+
+		double squares[23], sums[23], maxima[23];
+		distances<SquaredEuclidean>(query, points.data(), points.size(), squares);
+		distances<Manhattan>(query, points.data(), points.size(), sums);
+		distances<Chebyshev>(query, points.data(), points.size(), maxima);
+		for(size_t i=0; i<points.size(); ++i) {
+			double square = 0.0, sum = 0.0, most = 0.0;
+			for(size_t j=0; j<5; ++j) {
+				double difference = query[j] - points[i][j];
+				square += difference*difference;
+				sum += std::fabs(difference);
+				most = std::max(most, std::fabs(difference));
+			}
+			EXPECT_DOUBLE_EQ(square, squares[i]);
+			EXPECT_DOUBLE_EQ(square, squared_distance(query, points[i]));
+			EXPECT_DOUBLE_EQ(sum, sums[i]);
+			EXPECT_DOUBLE_EQ(sum, manhattan_distance(query, points[i]));
+			EXPECT_DOUBLE_EQ(most, maxima[i]);
+			EXPECT_DOUBLE_EQ(most, chebyshev_distance(query, points[i]));
+		}
+		EXPECT_DOUBLE_EQ(1.0, squares[7]);
+
+		std::array<int,2> a{{1, -2}}, b{{-2, 2}}; //the scalar path
+		double result;
+		distances<SquaredEuclidean>(a, &b, 1, &result);
+		EXPECT_EQ(25.0, result);
+		EXPECT_EQ(7.0, manhattan_distance(a, b));
+		EXPECT_EQ(4.0, chebyshev_distance(a, b));
+		CartesianPoint<int,2> c(1, -2), d(-2, 2);
+		EXPECT_EQ(25, squared_distance(c, d));
+		EXPECT_EQ(7, manhattan_distance(c, d));
+		auto e = for_both(c, d, [](int x, int y) { return x*y; });
+		EXPECT_EQ(-2, e[0]);
+		EXPECT_EQ(-4, e[1]);
+	}
+
+	TEST_F(SpatialIndexes, KDTree) {
+		using namespace ben;
+		KDTree<double,3> tree(8);
+		check(tree, 5);
+		tree.build( fill(2000) );
+		check(tree, 50);
+		change(tree, 1000);
+		check(tree, 50);
+		tree.clear();
+		points.clear();
+		change(tree, 300); //from empty, by inserts alone
+		check(tree, 20);
+
+		KDTree<double,3> sorted;
+		for(unsigned int i=0; i<20000; ++i) sorted.insert(i, point_type{{double(i), 0.0, 0.0}});
+		EXPECT_GT(40, sorted.depth());
+		std::vector<unsigned int> found;
+		sorted.within(point_type{{100.0, 0.0, 0.0}}, 1.5, found);
+		EXPECT_EQ(3, found.size());
+	}
+
+	TEST_F(SpatialIndexes, CellList) {
+		using namespace ben;
+		CellList<double,3> cells(1.5);
+		check(cells, 5);
+		cells.build( fill(2000) );
+		check(cells, 50);
+		change(cells, 1000);
+		check(cells, 50);
+		cells.clear();
+		points.clear();
+		change(cells, 300);
+		check(cells, 20);
+
+		CellList<double,3> sparse(0.01); //far more cells than points around any query
+		sparse.build( fill(200) );
+		check(sparse, 20);
+		EXPECT_EQ(200, sparse.occupied());
+		sparse.move(0, point_type{{-0.001, 0.0, 0.0}});
+		sparse.move(1, point_type{{0.001, 0.0, 0.0}}); //neighboring cells
+		std::vector<unsigned int> found;
+		sparse.within(point_type{{0.0, 0.0, 0.0}}, 0.002, found);
+		std::sort(found.begin(), found.end());
+		EXPECT_EQ(std::vector<unsigned int>({0, 1}), found);
+	}
+
+	TEST_F(SpatialIndexes, RTree) {
+		using namespace ben;
+		RTree<double,3> tree(8);
+		check(tree, 5);
+		tree.build( fill(2000) );
+		check(tree, 50);
+		EXPECT_GT(6, tree.depth());
+		change(tree, 1000);
+		check(tree, 50);
+		for(unsigned int i=0; i<1900; ++i) { //down to a handful, dissolving most of the nodes
+			unsigned int address = points.begin()->first;
+			EXPECT_TRUE(tree.remove(address));
+			points.erase(address);
+		}
+		check(tree, 20);
+		tree.clear();
+		points.clear();
+		change(tree, 300);
+		check(tree, 20);
+
+		std::normal_distribution<double> spread(0.0, 0.05); //dense clusters in empty space
+		std::vector< std::pair<unsigned int, point_type> > clustered;
+		points.clear();
+		for(unsigned int i=0; i<3000; ++i) {
+			point_type x = {{double(i % 5), 0.0, 3.0*double(i % 3)}};
+			for(auto& y : x) y += spread(gen);
+			points[i] = x;
+			clustered.push_back( std::make_pair(i, x) );
+		}
+		RTree<double,3> packed;
+		packed.build(clustered);
+		check(packed, 30);
+		std::vector<unsigned int> found;
+		packed.in_region( Box<double,3>{{{-1.0, -1.0, -1.0}}, {{0.5, 1.0, 1.0}}}, found );
+		EXPECT_EQ(200, found.size());
+	}
+
+	TEST_F(SpatialIndexes, CoordinateArray) {
+		using namespace ben;
+		CoordinateArray<double,3> columns;
+		check(columns, 5);
+		columns.build( fill(1000) );
+		check(columns, 20);
+		change(columns, 500);
+		check(columns, 20);
+		for(size_t i=0; i<columns.size(); ++i) { //still dense, and in step with the IDs
+			unsigned int address = columns.ids()[i];
+			for(unsigned short j=0; j<3; ++j) EXPECT_EQ(points[address][j], columns.column(j)[i]);
+		}
+	}
+
+	TEST_F(SpatialIndexes, Morton) {
+		using namespace ben;
+		EXPECT_EQ(0x5555555555555555ull, Morton<2>::encode(std::array<uint32_t,2>{{0xffffffff, 0}}));
+		EXPECT_EQ(15, Morton<2>::encode(std::array<uint32_t,2>{{3, 3}}));
+		EXPECT_EQ(0x2b, Morton<3>::encode(std::array<uint32_t,3>{{3, 1, 2}}));
+		EXPECT_EQ(0x3, Morton<5>::encode(std::array<uint32_t,5>{{1, 1, 0, 0, 0}}));
+		EXPECT_EQ(0x20, Morton<5>::encode(std::array<uint32_t,5>{{2, 0, 0, 0, 0}}));
+		std::uniform_int_distribution<uint32_t> small(0, 15);
+		for(unsigned int q=0; q<200; ++q) { //bigmin against a search over a 16x16 grid
+			std::array<uint32_t,2> low{{small(gen), small(gen)}}, high{{small(gen), small(gen)}};
+			for(unsigned short i=0; i<2; ++i) if(high[i] < low[i]) std::swap(low[i], high[i]);
+			uint64_t code = Morton<2>::encode(std::array<uint32_t,2>{{small(gen), small(gen)}});
+			uint64_t expected = Morton<2>::encode(high);
+			for(uint32_t x=low[0]; x<=high[0]; ++x) {
+				for(uint32_t y=low[1]; y<=high[1]; ++y) {
+					uint64_t inside = Morton<2>::encode(std::array<uint32_t,2>{{x, y}});
+					if(inside > code and inside < expected) expected = inside;
+				}
+			}
+			if(code < Morton<2>::encode(high)) {
+				EXPECT_EQ(expected, Morton<2>::bigmin(code, Morton<2>::encode(low), Morton<2>::encode(high)));
+			}
+		}
+
+		MortonIndex<double,3> sorted;
+		check(sorted, 5);
+		sorted.build( fill(2000) );
+		check(sorted, 50);
+		change(sorted, 1000); //merges the overflow more than once
+		check(sorted, 50);
+		auto iter = points.begin();
+		for(unsigned int i=0; i<50; ++i, ++iter) { //far outside the bounds, so everything is sorted again
+			point_type x = random_point();
+			x[0] += 100.0;
+			EXPECT_TRUE(sorted.move(iter->first, x));
+			iter->second = x;
+		}
+		check(sorted, 20);
+		sorted.clear();
+		points.clear();
+		change(sorted, 300);
+		check(sorted, 20);
+
+		auto order = sorted.ordering();
+		ASSERT_EQ(points.size(), order.size());
+		for(size_t i=1; i<order.size(); ++i) EXPECT_LE(sorted.code(points[order[i-1]]), sorted.code(points[order[i]]));
+		std::sort(order.begin(), order.end());
+		for(auto& x : points) EXPECT_TRUE( std::binary_search(order.begin(), order.end(), x.first) );
+	}
+
+	TEST(Spaces, Queries) {
+		using namespace ben;
+		typedef Space<double,2> space_type;
+		typedef Point<double,2> point_type;
+		auto space_ptr = std::make_shared<space_type>();
+		std::vector<std::unique_ptr<point_type>> grid;
+		for(unsigned int i=0; i<10; ++i)
+			for(unsigned int j=0; j<10; ++j)
+				grid.emplace_back( new point_type(space_ptr, 10*i + j, CartesianPoint<double,2>(double(i), double(j))) );
+		EXPECT_EQ(100, space_ptr->size());
+
+		auto found = space_ptr->within(space_type::raw_point_type{{4.0, 4.0}}, 1.0);
+		std::sort(found.begin(), found.end());
+		EXPECT_EQ(std::vector<unsigned int>({34, 43, 44, 45, 54}), found);
+		found = space_ptr->in_region( Box<double,2>{{{0.5, 7.5}}, {{2.0, 9.0}}} );
+		std::sort(found.begin(), found.end());
+		EXPECT_EQ(std::vector<unsigned int>({18, 19, 28, 29}), found);
+		unsigned int closest = 0;
+		EXPECT_TRUE(space_ptr->closest_to(space_type::raw_point_type{{7.2, 2.9}}, closest));
+		EXPECT_EQ(73, closest);
+		auto neighbors = space_ptr->nearest(space_type::raw_point_type{{0.0, 0.0}}, 3);
+		ASSERT_EQ(3, neighbors.size());
+		EXPECT_EQ(0, neighbors[0].id);
+		EXPECT_DOUBLE_EQ(1.0, neighbors[2].distance);
+
+		grid[73].reset(); //leaving the Space takes the Point out of the index
+		EXPECT_TRUE(space_ptr->closest_to(space_type::raw_point_type{{7.2, 2.9}}, closest));
+		EXPECT_NE(73, closest);
+		(*grid[0])[0] = 20.0; //moved directly, so the Space has to be told
+		space_ptr->update_data();
+		EXPECT_TRUE(space_ptr->closest_to(space_type::raw_point_type{{19.0, 0.0}}, closest));
+		EXPECT_EQ(0, closest);
+
+		auto& mirror = space_ptr->coordinates();
+		EXPECT_EQ(99, mirror.size());
+		EXPECT_FALSE(mirror.contains(73));
+		space_type::raw_point_type moved;
+		EXPECT_TRUE(mirror.find(0, moved));
+		EXPECT_EQ(20.0, moved[0]);
+		EXPECT_TRUE(mirror.closest_to(space_type::raw_point_type{{7.2, 2.9}}, closest));
+		EXPECT_EQ(space_ptr->nearest(space_type::raw_point_type{{7.2, 2.9}}, 1)[0].id, closest);
+
+		space_ptr->set_spatial_index( std::unique_ptr<SpatialIndex<double,2>>(new CellList<double,2>(1.0)) );
+		EXPECT_EQ(99, space_ptr->spatial_index().size());
+		found = space_ptr->within(space_type::raw_point_type{{4.0, 4.0}}, 1.0);
+		std::sort(found.begin(), found.end());
+		EXPECT_EQ(std::vector<unsigned int>({34, 43, 44, 45, 54}), found);
+
+		auto cell_space_ptr = std::make_shared<space_type>( std::unique_ptr<SpatialIndex<double,2>>(new CellList<double,2>(0.5)) );
+		point_type a(cell_space_ptr, CartesianPoint<double,2>(1.0, 1.0)), b(cell_space_ptr, CartesianPoint<double,2>(1.4, 1.0));
+		found = cell_space_ptr->within(space_type::raw_point_type{{1.2, 1.0}}, 0.25);
+		EXPECT_EQ(2, found.size());
+		EXPECT_EQ(a.ID(), cell_space_ptr->nearest(space_type::raw_point_type{{0.0, 0.0}}, 1)[0].id);
+	}
+
+	TEST(Spaces, Moves) {
+		using namespace ben;
+		typedef Space<double,2> space_type;
+		typedef Point<double,2> point_type;
+		for(int backend=0; backend<2; ++backend) {
+			auto space_ptr = backend == 0 ? std::make_shared<space_type>()
+				: std::make_shared<space_type>( std::unique_ptr<SpatialIndex<double,2>>(new CellList<double,2>(2.0)) );
+			std::vector<std::unique_ptr<point_type>> line;
+			for(unsigned int i=0; i<100; ++i)
+				line.emplace_back( new point_type(space_ptr, i, CartesianPoint<double,2>(double(i), 0.0)) );
+			unsigned int closest = 0;
+			EXPECT_TRUE(space_ptr->closest_to(space_type::raw_point_type{{50.2, 0.0}}, closest));
+			EXPECT_EQ(50, closest);
+
+			line[50]->move_to(CartesianPoint<double,2>(50.0, 30.0)); //patched in place
+			line[7]->set(1, -30.0);
+			EXPECT_TRUE(space_ptr->closest_to(space_type::raw_point_type{{50.0, 29.0}}, closest));
+			EXPECT_EQ(50, closest);
+			EXPECT_TRUE(space_ptr->closest_to(space_type::raw_point_type{{7.0, -29.0}}, closest));
+			EXPECT_EQ(7, closest);
+			EXPECT_EQ(2, space_ptr->within(space_type::raw_point_type{{50.0, 0.0}}, 1.0).size());
+
+			(*line[60])[1] = 10.0; //written directly, so the Space has to be told
+			space_ptr->moved(60);
+			EXPECT_EQ(std::vector<unsigned int>({60}), space_ptr->within(space_type::raw_point_type{{60.0, 10.0}}, 0.5));
+
+			std::vector<unsigned int> batch; //most of the Points at once, which rebuilds
+			for(unsigned int i=0; i<80; ++i) {
+				(*line[i])[1] = 100.0;
+				batch.push_back(i);
+			}
+			space_ptr->moved(batch.begin(), batch.end());
+			EXPECT_EQ(80, space_ptr->in_region( Box<double,2>{{{-1.0, 99.0}}, {{200.0, 101.0}}} ).size());
+			EXPECT_EQ(100, space_ptr->coordinates().size());
+			space_type::raw_point_type x;
+			EXPECT_TRUE(space_ptr->coordinates().find(79, x));
+			EXPECT_EQ(100.0, x[1]);
+
+			for(unsigned int i=0; i<500; ++i) line[90]->set(0, 90.0 + 0.001*i); //one jittering Point, queued once
+			EXPECT_TRUE(space_ptr->closest_to(space_type::raw_point_type{{90.5, 0.0}}, closest));
+			EXPECT_EQ(90, closest);
+			EXPECT_TRUE(space_ptr->coordinates().find(90, x));
+			EXPECT_DOUBLE_EQ(90.499, x[0]);
+		}
+	}
+
+	TEST(Spaces, Knn) {
+		using namespace ben;
+		typedef Space<double,3> space_type;
+		typedef Point<double,3> point_type;
+		std::default_random_engine gen;
+		std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+		auto random_point = [&]() { return space_type::raw_point_type{{coordinate(gen), coordinate(gen), coordinate(gen)}}; };
+
+		auto space_ptr = std::make_shared<space_type>();
+		ThreadPool pool(4);
+		std::vector<space_type::raw_point_type> queries(1000);
+		for(auto& x : queries) x = random_point();
+		std::vector<Neighbor> output(queries.size()*6);
+		EXPECT_EQ(0, space_ptr->knn(pool, queries.data(), queries.size(), 6, output.data()));
+		EXPECT_EQ(std::numeric_limits<unsigned int>::max(), output[5].id);
+
+		std::vector<std::unique_ptr<point_type>> cloud;
+		for(unsigned int i=0; i<4; ++i) cloud.emplace_back( new point_type(space_ptr, random_point()) );
+		EXPECT_EQ(4, space_ptr->knn(pool, queries.data(), queries.size(), 6, output.data()));
+		EXPECT_TRUE(std::isinf(output[6*7 + 4].distance));
+		EXPECT_FALSE(std::isinf(output[6*7 + 3].distance));
+
+		for(unsigned int i=0; i<2000; ++i) cloud.emplace_back( new point_type(space_ptr, random_point()) );
+		EXPECT_EQ(6, space_ptr->knn(pool, queries.data(), queries.size(), 6, output.data(), 16));
+		for(size_t i=0; i<queries.size(); ++i) {
+			auto expected = space_ptr->nearest(queries[i], 6);
+			for(size_t j=0; j<6; ++j) {
+				EXPECT_EQ(expected[j].id, output[6*i + j].id);
+				EXPECT_EQ(expected[j].distance, output[6*i + j].distance);
+			}
+		}
+		auto copy = space_ptr->knn(pool, queries, 6);
+		ASSERT_EQ(output.size(), copy.size());
+		EXPECT_EQ(output.back().id, copy.back().id);
+	}
+
+	TEST(Spaces, ProximityGraphs) {
+		using namespace ben;
+		typedef Space<double,2> space_type;
+		typedef Point<double,2> point_type;
+		typedef stdUndirectedNode<double> node_type;
+		ThreadPool pool(3);
+
+		auto space_ptr = std::make_shared<space_type>();
+		auto grid_ptr = std::make_shared< Graph<node_type> >();
+		std::vector<std::unique_ptr<point_type>> points;
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned int i=0; i<10; ++i) {
+			for(unsigned int j=0; j<10; ++j) {
+				points.emplace_back( new point_type(space_ptr, 10*i + j, CartesianPoint<double,2>(double(i), 2.0*double(j))) );
+				nodes.emplace_back( new node_type(grid_ptr, 1000 + 10*i + j) );
+			}
+		}
+		nodes[0]->add(1000 + 10, 5.0); //already there, so left alone
+		auto remap = [](unsigned int id) { return id + 1000; };
+		EXPECT_TRUE(radius_graph(pool, *space_ptr, *grid_ptr, 1.0, remap, 7));
+		size_t links = 0;
+		for(auto& x : nodes) links += x->size();
+		EXPECT_EQ(2*90, links); //neighbors along the first coordinate only
+		EXPECT_EQ(5.0, nodes[0]->find(1010)->get_value());
+		EXPECT_EQ(1.0, nodes[55]->find(1045)->get_value());
+		nodes[45]->find(1055)->set_value(-1.0); //both ends share the value
+		EXPECT_EQ(-1.0, nodes[55]->find(1045)->get_value());
+		EXPECT_FALSE(radius_graph(pool, *space_ptr, *grid_ptr, 1.0)); //no nodes with the Points' IDs
+
+		std::default_random_engine gen;
+		std::uniform_real_distribution<double> coordinate(0.0, 10.0);
+		auto cloud_ptr = std::make_shared<space_type>();
+		auto graph_ptr = std::make_shared< Graph<node_type> >();
+		points.clear();
+		nodes.clear();
+		for(unsigned int i=0; i<500; ++i) {
+			points.emplace_back( new point_type(cloud_ptr, i, CartesianPoint<double,2>(coordinate(gen), coordinate(gen))) );
+			nodes.emplace_back( new node_type(graph_ptr, i) );
+		}
+		EXPECT_TRUE(knn_graph(pool, *cloud_ptr, *graph_ptr, 4));
+		std::set< std::pair<unsigned int, unsigned int> > expected, actual;
+		for(unsigned int i=0; i<500; ++i) {
+			auto neighbors = cloud_ptr->nearest(points[i]->coordinates(), 5);
+			for(auto& x : neighbors) if(x.id != i) expected.insert( std::make_pair(std::min(i, x.id), std::max(i, x.id)) );
+			for(auto& x : *nodes[i]) {
+				actual.insert( std::make_pair(std::min(i, x.get_address()), std::max(i, x.get_address())) );
+				EXPECT_DOUBLE_EQ(std::sqrt(squared_distance(*points[i], *points[x.get_address()])), x.get_value());
+			}
+			EXPECT_LE(4, nodes[i]->size());
+		}
+		EXPECT_EQ(expected, actual);
+	}
+
+	TEST(Spaces, MortonOrdering) {
+		using namespace ben;
+		typedef Space<double,2> space_type;
+		typedef Point<double,2> point_type;
+		typedef stdUndirectedNode<double> node_type;
+		ThreadPool pool(2);
+		std::default_random_engine gen;
+		std::uniform_real_distribution<double> coordinate(0.0, 10.0);
+
+		auto cloud_ptr = std::make_shared<space_type>();
+		auto sorted_ptr = std::make_shared<space_type>( std::unique_ptr< SpatialIndex<double,2> >(new MortonIndex<double,2>()) );
+		auto graph_ptr = std::make_shared< Graph<node_type> >();
+		std::vector<std::unique_ptr<point_type>> points, copies;
+		std::vector<std::unique_ptr<node_type>> nodes;
+		for(unsigned int i=0; i<1000; ++i) {
+			CartesianPoint<double,2> x(coordinate(gen), coordinate(gen));
+			points.emplace_back( new point_type(cloud_ptr, i, x) );
+			copies.emplace_back( new point_type(sorted_ptr, i, x) );
+			nodes.emplace_back( new node_type(graph_ptr, i) );
+		}
+		auto order = cloud_ptr->morton_ordering();
+		EXPECT_EQ(order, sorted_ptr->morton_ordering()); //from the mirror, or from the index itself
+		copies[0]->move_to( space_type::raw_point_type{{20.0, 20.0}} );
+		unsigned int closest = 0;
+		EXPECT_TRUE(sorted_ptr->closest_to(space_type::raw_point_type{{19.0, 19.0}}, closest));
+		EXPECT_EQ(0, closest);
+		EXPECT_EQ(0, sorted_ptr->morton_ordering().back());
+
+		//as starting blocks for a Partition, the curve keeps neighbors together
+		EXPECT_TRUE(knn_graph(pool, *cloud_ptr, *graph_ptr, 4));
+		Partition<node_type> blocks(*graph_ptr, 8, 0), curve(*graph_ptr, 8, order, 0);
+		EXPECT_GT(blocks.edge_cut(), 4*curve.edge_cut());
+		Partition<node_type> refined(*graph_ptr, 8, order);
+		EXPECT_GE(curve.edge_cut(), refined.edge_cut());
+	}
+
+} //anonymous namespace
+
+int main(int argc, char **argv) {
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}